@@ -0,0 +1,836 @@
+/* Speed benchmarks for libfixmatrix.
+ * Build and run with 'make run_benchmarks'. The results are only
+ * comparable between runs on the same machine.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "fixarray.h"
+#include "fixquat.h"
+#include "fixtransform.h"
+#include "fixvector2d.h"
+#include "fixvectornd.h"
+#include "fixstring.h"
+#include "fixmatrix32.h"
+#include "fixshared.h"
+#include "fixnls.h"
+
+#define COUNT 1024
+#define ROUNDS 2000
+
+// Prevents the compiler from optimizing away the benchmarked code.
+static volatile fix16_t sink;
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Runs code ROUNDS * COUNT times, with i going through 0..COUNT-1,
+// and prints the average time per iteration.
+#define BENCHMARK(name, ...) \
+    { \
+        int round_, i; \
+        double start_ = now(); \
+        for (round_ = 0; round_ < ROUNDS; round_++) \
+            for (i = 0; i < COUNT; i++) \
+                { __VA_ARGS__; } \
+        double time_ = now() - start_; \
+        printf("%-40s %8.1f ns\n", name, time_ * 1e9 / ROUNDS / COUNT); \
+    }
+
+// Runs code that processes COUNT items ROUNDS times, and prints the
+// average time per item.
+#define BENCHMARK_BATCH(name, ...) \
+    { \
+        int round_; \
+        double start_ = now(); \
+        for (round_ = 0; round_ < ROUNDS; round_++) \
+            { __VA_ARGS__; } \
+        double time_ = now() - start_; \
+        printf("%-40s %8.1f ns\n", name, time_ * 1e9 / ROUNDS / COUNT); \
+    }
+
+// Deterministic pseudo-random numbers, so that all runs use the same data.
+static uint32_t random_state = 1;
+static fix16_t random_fix16(int_fast8_t bits)
+{
+    random_state = random_state * 1664525 + 1013904223;
+    return (fix16_t)random_state >> (32 - bits);
+}
+
+// The fa16_norm() implementation that scales the sum and uses
+// fix16_sqrt(), for comparison.
+static fix16_t norm_fix16_sqrt(const fix16_t *a, uint_fast8_t a_stride, uint_fast8_t n)
+{
+    int64_t sum = 0;
+    
+    while (n--)
+    {
+        sum += (int64_t)(*a) * (*a);
+        a += a_stride;
+    }
+    
+    int_fast8_t scale = 0;
+    uint32_t highpart = (uint32_t)(sum >> 32);
+    uint32_t lowpart = (uint32_t)sum;
+    if (highpart)
+        scale = 33 - (__builtin_clz(highpart));
+    else if (lowpart & 0x80000000)
+        scale = 1;
+    
+    if (scale & 1) scale++;
+    
+    fix16_t result = fix16_sqrt((uint32_t)(sum >> scale));
+    scale = scale / 2 - 8;
+    return (scale >= 0) ? result << scale : result >> -scale;
+}
+
+static fix16_t vectors[COUNT][4];
+static fix16_t scalars[COUNT];
+
+static void benchmark_norm()
+{
+    int i;
+    fix16_t max_diff = 0;
+    
+    for (i = 0; i < COUNT; i++)
+    {
+        fix16_t diff = fix16_abs(fa16_norm(vectors[i], 1, 4) - norm_fix16_sqrt(vectors[i], 1, 4));
+        if (diff > max_diff) max_diff = diff;
+    }
+    
+    printf("\nVector norm, fa16_norm vs. fix16_sqrt (max difference %d LSB)\n", (int)max_diff);
+    BENCHMARK("norm_fix16_sqrt, n = 3", sink = norm_fix16_sqrt(vectors[i], 1, 3));
+    BENCHMARK("fa16_norm, n = 3", sink = fa16_norm(vectors[i], 1, 3));
+    BENCHMARK("norm_fix16_sqrt, n = 4", sink = norm_fix16_sqrt(vectors[i], 1, 4));
+    BENCHMARK("fa16_norm, n = 4", sink = fa16_norm(vectors[i], 1, 4));
+    BENCHMARK("fa16_normalize_inplace, n = 4",
+              fix16_t v[4] = {vectors[i][0], vectors[i][1], vectors[i][2], vectors[i][3]};
+              sink = fa16_normalize_inplace(v, 1, 4) + v[0]);
+    
+    printf("\nReciprocal square root\n");
+    BENCHMARK("fix16_div(1, fix16_sqrt(x))", sink = fix16_div(fix16_one, fix16_sqrt(scalars[i])));
+    BENCHMARK("fa16_rsqrt(x)", sink = fa16_rsqrt(scalars[i]));
+}
+
+static void benchmark_vector()
+{
+    static fix16_t states[COUNT][6];
+    static fix16_t alphas[COUNT];
+    int i, j;
+    
+    for (i = 0; i < COUNT; i++)
+        for (j = 0; j < 6; j++)
+            states[i][j] = vectors[(i + j) % COUNT][j % 4] >> 8;
+    
+    for (i = 0; i < COUNT; i++)
+        alphas[i] = scalars[i] >> 12;
+    
+    printf("\nN-dimensional vectors\n");
+    BENCHMARK("vnd_axpy, n = 3", vnd_axpy(states[i], F16(0.001), vectors[i], 3));
+    BENCHMARK("vnd_axpy, n = 4", vnd_axpy(states[i], F16(0.001), vectors[i], 4));
+    BENCHMARK("vnd_axpy, n = 6", vnd_axpy(states[i], F16(0.001), states[COUNT - 1 - i], 6));
+    BENCHMARK_BATCH("vnd_axpy_batch, n = 6",
+                    vnd_axpy_batch(&states[0][0], alphas, &states[0][0], 6, COUNT));
+    BENCHMARK("vnd_dot, n = 6", sink = vnd_dot(states[i], states[COUNT - 1 - i], 6));
+    BENCHMARK("vnd_norm, n = 6", sink = vnd_norm(states[i], 6));
+}
+
+static void benchmark_trig()
+{
+    static fix16_t angles[COUNT];
+    v3d axis = {F16(0.48), F16(0.6), F16(0.64)};
+    v2d point = {F16(1.5), F16(-2)};
+    fix16_t max_diff = 0;
+    int i;
+    
+    // Angles up to +-2 pi, as used for rotations.
+    for (i = 0; i < COUNT; i++)
+    {
+        fix16_t s, c;
+        angles[i] = fix16_mul(random_fix16(18), fix16_pi);
+        fa16_sincos(angles[i], &s, &c);
+        max_diff = fix16_max(max_diff, fix16_abs(s - fix16_sin(angles[i])));
+        max_diff = fix16_max(max_diff, fix16_abs(c - fix16_cos(angles[i])));
+    }
+    
+    printf("\nSine and cosine, fa16_sincos vs. fix16_sin/cos (max difference %d LSB)\n",
+           (int)max_diff);
+    BENCHMARK("fix16_sin + fix16_cos", sink = fix16_sin(angles[i]) + fix16_cos(angles[i]));
+    BENCHMARK("fa16_sincos", fix16_t s; fix16_t c; fa16_sincos(angles[i], &s, &c); sink = s + c);
+    BENCHMARK("qf16_from_axis_angle", qf16 q; qf16_from_axis_angle(&q, &axis, angles[i]); sink = q.a);
+    BENCHMARK("v2d_rotate", v2d v; v2d_rotate(&v, &point, angles[i]); sink = v.x);
+}
+
+static void benchmark_integrate()
+{
+    static qf16 attitudes[COUNT];
+    static v3d rates[COUNT];
+    int i;
+    
+    for (i = 0; i < COUNT; i++)
+    {
+        qf16 q = {vectors[i][0], vectors[i][1], vectors[i][2], vectors[i][3]};
+        qf16_normalize(&attitudes[i], &q);
+        rates[i].x = random_fix16(20);
+        rates[i].y = random_fix16(20);
+        rates[i].z = random_fix16(20);
+    }
+    
+    printf("\nGyro integration, dt = 1 ms\n");
+    BENCHMARK("qf16_from_axis_angle + mul + normalize",
+              v3d axis; qf16 dq;
+              fix16_t angle = fix16_mul(v3d_norm(&rates[i]), F16(0.001));
+              v3d_normalize(&axis, &rates[i]);
+              qf16_from_axis_angle(&dq, &axis, angle);
+              qf16_mul(&attitudes[i], &attitudes[i], &dq);
+              qf16_normalize(&attitudes[i], &attitudes[i]));
+    BENCHMARK("qf16_integrate",
+              qf16_integrate(&attitudes[i], &attitudes[i], &rates[i], F16(0.001)));
+    
+    BENCHMARK_BATCH("qf16_integrate_batch",
+                    qf16_integrate_batch(attitudes, rates, F16(0.001), COUNT));
+}
+
+static void benchmark_slerp()
+{
+    static qf16 track[COUNT];
+    qf16 q1, q2;
+    qf16_slerp_state state;
+    v3d axis = {F16(0.48), F16(0.6), F16(0.64)};
+    
+    qf16_from_axis_angle(&q1, &axis, F16(0.3));
+    qf16_from_axis_angle(&q2, &axis, F16(2.1));
+    qf16_slerp_init(&state, &q1, &q2);
+    
+    printf("\nQuaternion interpolation\n");
+    BENCHMARK("q1 * qf16_pow(q1' * q2, t)",
+              qf16 delta; qf16_conj(&delta, &q1); qf16_mul(&delta, &delta, &q2);
+              qf16_pow(&delta, &delta, i * 64); qf16_mul(&track[i], &q1, &delta));
+    BENCHMARK("qf16_nlerp", qf16_nlerp(&track[i], &q1, &q2, i * 64));
+    BENCHMARK("qf16_slerp", qf16_slerp(&track[i], &q1, &q2, i * 64));
+    BENCHMARK("qf16_slerp_eval", qf16_slerp_eval(&track[i], &state, i * 64));
+    
+    BENCHMARK_BATCH("qf16_slerp_batch", qf16_slerp_batch(track, &state, 0, 64, COUNT));
+}
+
+static void benchmark_transform()
+{
+    static qf16 rotations[COUNT];
+    static v3d translations[COUNT], points[COUNT], results[COUNT];
+    static tf16 poses[COUNT];
+    static mf16 matrices[COUNT];
+    int i;
+    
+    for (i = 0; i < COUNT; i++)
+    {
+        qf16 q = {vectors[i][0], vectors[i][1], vectors[i][2], vectors[i][3]};
+        qf16_normalize(&rotations[i], &q);
+        translations[i].x = vectors[i][3] >> 8;
+        translations[i].y = vectors[i][2] >> 8;
+        translations[i].z = vectors[i][1] >> 8;
+        points[i].x = vectors[i][0] >> 8;
+        points[i].y = vectors[i][1] >> 8;
+        points[i].z = vectors[i][2] >> 8;
+        tf16_from_qf16(&poses[i], &rotations[i], &translations[i]);
+        tf16_to_mf16(&matrices[i], &poses[i]);
+    }
+    
+    printf("\nRigid body transforms\n");
+    BENCHMARK("mf16_mul, 4x4 homogeneous",
+              mf16 m; mf16_mul(&m, &matrices[i], &matrices[COUNT - 1 - i]);
+              sink = m.data[0][3]);
+    BENCHMARK("tf16_compose",
+              tf16 t; tf16_compose(&t, &poses[i], &poses[COUNT - 1 - i]);
+              sink = t.data[0][3]);
+    BENCHMARK("tf16_invert",
+              tf16 t; tf16_invert(&t, &poses[i]); sink = t.data[0][3]);
+    BENCHMARK("qf16_rotate + v3d_add",
+              qf16_rotate(&results[i], &rotations[i], &points[i]);
+              v3d_add(&results[i], &results[i], &translations[i]));
+    BENCHMARK("tf16_transform_point",
+              tf16_transform_point(&results[i], &poses[i], &points[i]));
+    BENCHMARK_BATCH("tf16_transform_points",
+                    tf16_transform_points(results, &poses[0], points, COUNT));
+}
+
+static void benchmark_orientation()
+{
+    static fix16_t qa[COUNT], qb[COUNT], qc[COUNT], qd[COUNT];
+    static fix16_t x[COUNT], y[COUNT], z[COUNT], angles[COUNT];
+    static fix16_t m[9][COUNT];
+    static qf16 rotations[COUNT];
+    static mf16 matrices[COUNT];
+    const fix16_t *columns[9];
+    qf16_soa soa = {qa, qb, qc, qd};
+    v3d_soa euler = {x, y, z};
+    int i, j;
+    
+    for (i = 0; i < COUNT; i++)
+    {
+        qf16 q = {vectors[i][0], vectors[i][1], vectors[i][2], vectors[i][3]};
+        qf16_normalize(&rotations[i], &q);
+        qf16_to_matrix(&matrices[i], &rotations[i]);
+        qa[i] = rotations[i].a;
+        qb[i] = rotations[i].b;
+        qc[i] = rotations[i].c;
+        qd[i] = rotations[i].d;
+        
+        for (j = 0; j < 9; j++)
+            m[j][i] = matrices[i].data[j / 3][j % 3];
+    }
+    
+    for (j = 0; j < 9; j++)
+        columns[j] = m[j];
+    
+    printf("\nOrientation conversions\n");
+    BENCHMARK("qf16_from_matrix", qf16 q; qf16_from_matrix(&q, &matrices[i]); sink = q.a);
+    BENCHMARK("qf16_to_euler", v3d e; qf16_to_euler(&e, &rotations[i]); sink = e.x);
+    BENCHMARK("qf16_from_euler",
+              qf16 q; v3d e = {qb[i], qc[i], qd[i]}; qf16_from_euler(&q, &e); sink = q.a);
+    BENCHMARK("qf16_to_axis_angle",
+              v3d axis; fix16_t angle; qf16_to_axis_angle(&axis, &angle, &rotations[i]);
+              sink = angle);
+    BENCHMARK_BATCH("qf16_from_matrix_batch", qf16_from_matrix_batch(&soa, columns, COUNT));
+    BENCHMARK_BATCH("qf16_to_euler_batch", qf16_to_euler_batch(&euler, &soa, COUNT));
+    BENCHMARK_BATCH("qf16_to_axis_angle_batch",
+                    qf16_to_axis_angle_batch(&euler, angles, &soa, COUNT));
+}
+
+static void benchmark_string()
+{
+    static char text[COUNT][FIXSTRING_ROW_MAXLEN];
+    static char numbers[COUNT][16];
+    mf16 m = {1, 4, 0, {{0}}};
+    int i;
+    
+    for (i = 0; i < COUNT; i++)
+        fix16_to_str(vectors[i][0], numbers[i], 4);
+    
+    printf("\nText conversion, one 4-element row\n");
+    BENCHMARK("fix16_to_str, width 9",
+              char *p = text[i]; int j;
+              for (j = 0; j < 4; j++) {
+                  char buf[13]; size_t len;
+                  fix16_to_str(vectors[i][j], buf, 4);
+                  len = strlen(buf);
+                  while (len < 9) { *p++ = ' '; len++; }
+                  strcpy(p, buf); p += strlen(buf); *p++ = ' ';
+              }
+              *p = '\0');
+    BENCHMARK("format_mf16_row",
+              memcpy(m.data[0], vectors[i], sizeof(vectors[i]));
+              sink = format_mf16_row(text[i], sizeof(text[i]), &m, 0));
+    BENCHMARK("parse_mf16", sink = parse_mf16(&m, text[i]) != NULL);
+    
+    printf("\nText conversion, single value\n");
+    BENCHMARK("fix16_from_str", sink = fix16_from_str(numbers[i]));
+    BENCHMARK("parse_fix16_t", fix16_t v; parse_fix16_t(numbers[i], &v); sink = v);
+}
+
+static void benchmark_transpose()
+{
+    mf16 square = {FIXMATRIX_MAX_SIZE, FIXMATRIX_MAX_SIZE, 0, {{0}}};
+    mf16 vector = {1, FIXMATRIX_MAX_SIZE, 0, {{0}}};
+    mf16 a = {4, 4, 0, {{0}}}, b = {4, 4, 0, {{0}}};
+    mf16 tmp, result;
+    
+    mf16_fill(&square, F16(1.5));
+    mf16_fill(&vector, F16(2.5));
+    mf16_fill(&a, F16(0.5));
+    mf16_fill(&b, F16(0.25));
+    
+    printf("\nTransposition\n");
+    BENCHMARK("mf16_transpose, 1xN in place", mf16_transpose(&vector, &vector); sink = vector.rows);
+    BENCHMARK("mf16_transpose, NxN in place", mf16_transpose(&square, &square); sink = square.rows);
+    BENCHMARK("mf16_transpose, NxN", mf16_transpose(&tmp, &square); sink = tmp.rows);
+    BENCHMARK("mf16_transpose + mf16_mul, 4x4",
+              mf16_transpose(&tmp, &a); mf16_transpose(&result, &b);
+              mf16_mul(&result, &tmp, &result); sink = result.data[0][0]);
+    BENCHMARK("mf16_mul_ex a' b', 4x4",
+              mf16_mul_ex(&result, &a, &b, FIXMATRIX_TRANSPOSE_A | FIXMATRIX_TRANSPOSE_B);
+              sink = result.data[0][0]);
+}
+
+static void benchmark_triangular()
+{
+    static mf16 spd[COUNT];
+    mf16 b = {4, 1, 0, {{0}}};
+    mf16 l, x;
+    mf16_tri tl;
+    int i, row, column;
+    
+    // Symmetric positive definite 4x4 matrices A A' + I
+    for (i = 0; i < COUNT; i++)
+    {
+        mf16 a = {4, 4, 0, {{0}}};
+        for (row = 0; row < 4; row++)
+            for (column = 0; column < 4; column++)
+                a.data[row][column] = vectors[(i + row) % COUNT][column] >> 8;
+        
+        mf16_mul_bt(&spd[i], &a, &a);
+        for (row = 0; row < 4; row++)
+            spd[i].data[row][row] += fix16_one;
+    }
+    
+    for (row = 0; row < 4; row++)
+        b.data[row][0] = vectors[0][row] >> 8;
+    
+    printf("\nPacked triangular matrices, 4x4 (%d vs %d bytes)\n",
+           (int)sizeof(mf16), (int)sizeof(mf16_tri));
+    BENCHMARK("mf16_cholesky", mf16_cholesky(&l, &spd[i]); sink = l.data[3][3]);
+    BENCHMARK("mf16_tri_cholesky", mf16_tri_cholesky(&tl, &spd[i]); sink = tl.data[9]);
+    
+    mf16_tri_cholesky(&tl, &spd[0]);
+    mf16_tri_to_mf16(&l, &tl);
+    BENCHMARK("mf16_mul, L b", mf16_mul(&x, &l, &b); sink = x.data[3][0]);
+    BENCHMARK("mf16_trmul, L b", mf16_trmul(&x, &tl, &b); sink = x.data[3][0]);
+    BENCHMARK("mf16_trsolve, L L' x = b",
+              tl.upper = false; mf16_trsolve(&x, &tl, &b);
+              tl.upper = true; mf16_trsolve(&x, &tl, &x); sink = x.data[3][0]);
+}
+
+static void benchmark_small()
+{
+    static mf16 a[COUNT], spd[COUNT];
+    mf16 result;
+    int i, row, column;
+    
+    for (i = 0; i < COUNT; i++)
+    {
+        a[i].rows = a[i].columns = 4;
+        a[i].errors = 0;
+        for (row = 0; row < 4; row++)
+            for (column = 0; column < 4; column++)
+                a[i].data[row][column] = vectors[(i + row) % COUNT][column] >> 8;
+        
+        mf16_mul_bt(&spd[i], &a[i], &a[i]);
+        for (row = 0; row < 4; row++)
+            spd[i].data[row][row] += fix16_one;
+    }
+    
+    printf("\nSmall matrices\n");
+    for (i = 0; i < COUNT; i++)
+        a[i].rows = a[i].columns = spd[i].rows = spd[i].columns = 2;
+    BENCHMARK("mf16_mul, 2x2",
+              mf16_mul(&result, &a[i], &a[COUNT - 1 - i]); sink = result.data[1][1]);
+    BENCHMARK("mf16_cholesky, 2x2", mf16_cholesky(&result, &spd[i]); sink = result.data[1][1]);
+    
+    for (i = 0; i < COUNT; i++)
+        a[i].rows = a[i].columns = spd[i].rows = spd[i].columns = 3;
+    BENCHMARK("mf16_mul, 3x3",
+              mf16_mul(&result, &a[i], &a[COUNT - 1 - i]); sink = result.data[2][2]);
+    BENCHMARK("mf16_mul_at, 3x3",
+              mf16_mul_at(&result, &a[i], &a[COUNT - 1 - i]); sink = result.data[2][2]);
+    BENCHMARK("mf16_mul_bt, 3x3",
+              mf16_mul_bt(&result, &a[i], &a[COUNT - 1 - i]); sink = result.data[2][2]);
+    BENCHMARK("mf16_mul, 3x3 in place",
+              result = a[i]; mf16_mul(&result, &result, &a[COUNT - 1 - i]);
+              sink = result.data[2][2]);
+    BENCHMARK("mf16_cholesky, 3x3", mf16_cholesky(&result, &spd[i]); sink = result.data[2][2]);
+    BENCHMARK("mf16_det, 3x3", sink = mf16_det(&spd[i]));
+    BENCHMARK("mf16_logdet_spd, 3x3", sink = mf16_logdet_spd(&spd[i]));
+    BENCHMARK("mf16_inverse, 3x3", mf16_inverse(&result, &spd[i]); sink = result.data[2][2]);
+    
+    for (i = 0; i < COUNT; i++)
+        a[i].rows = a[i].columns = spd[i].rows = spd[i].columns = 4;
+    BENCHMARK("mf16_mul, 4x4",
+              mf16_mul(&result, &a[i], &a[COUNT - 1 - i]); sink = result.data[3][3]);
+    BENCHMARK("mf16_mul_bt, 4x4",
+              mf16_mul_bt(&result, &a[i], &a[COUNT - 1 - i]); sink = result.data[3][3]);
+    BENCHMARK("mf16_cholesky, 4x4", mf16_cholesky(&result, &spd[i]); sink = result.data[3][3]);
+    BENCHMARK("mf16_det, 4x4", sink = mf16_det(&spd[i]));
+    BENCHMARK("mf16_inverse, 4x4", mf16_inverse(&result, &spd[i]); sink = result.data[3][3]);
+    
+    // Not square, so uses the generic code.
+    for (i = 0; i < COUNT; i++)
+        a[i].rows = 3;
+    BENCHMARK("mf16_mul, 3x4 * 4x4",
+              mf16_mul(&result, &a[i], &a[COUNT - 1 - i]); sink = result.data[2][3]);
+}
+
+static void benchmark_solve()
+{
+    mf16 a4 = {4, 4, 0, {{0}}}, a8 = {FIXMATRIX_MAX_SIZE, FIXMATRIX_MAX_SIZE, 0, {{0}}};
+    mf16 b4 = {4, 1, 0, {{0}}}, identity = {FIXMATRIX_MAX_SIZE, FIXMATRIX_MAX_SIZE, 0, {{0}}};
+    mf16 q4, r4, q8, r8, x;
+    int row, column;
+    
+    // Diagonally dominant matrices, so that the solutions stay small.
+    for (row = 0; row < FIXMATRIX_MAX_SIZE; row++)
+    {
+        for (column = 0; column < FIXMATRIX_MAX_SIZE; column++)
+            a8.data[row][column] = vectors[row][column % 4] >> 12;
+        a8.data[row][row] += fix16_from_int(FIXMATRIX_MAX_SIZE);
+    }
+    
+    for (row = 0; row < 4; row++)
+    {
+        for (column = 0; column < 4; column++)
+            a4.data[row][column] = a8.data[row][column];
+        b4.data[row][0] = vectors[1][row] >> 8;
+    }
+    
+    mf16_fill_diagonal(&identity, fix16_one);
+    mf16_qr_decomposition(&q4, &r4, &a4, 0);
+    mf16_qr_decomposition(&q8, &r8, &a8, 0);
+    
+    printf("\nSolving with QR decomposition\n");
+    BENCHMARK("mf16_solve, 4x4, 1 column", mf16_solve(&x, &q4, &r4, &b4); sink = x.data[3][0]);
+    BENCHMARK("mf16_solve, NxN, N columns", mf16_solve(&x, &q8, &r8, &identity); sink = x.data[0][0]);
+    BENCHMARK("mf16_solve, NxN in place", x = identity; mf16_solve(&x, &q8, &r8, &x); sink = x.data[0][0]);
+    BENCHMARK("mf16_cond_r, 4x4", sink = mf16_cond_r(&r4));
+    BENCHMARK("mf16_cond_r, NxN", sink = mf16_cond_r(&r8));
+}
+
+// 4x4 systems with a known exact solution: the entries of A are
+// multiples of 1/16 and those of x multiples of 16 LSB, so that b = A x
+// has no rounding error.
+#define REFINE_SYSTEMS 64
+static mf16 refine_a[REFINE_SYSTEMS], refine_b[REFINE_SYSTEMS], refine_x[REFINE_SYSTEMS];
+
+// Solves all the systems and prints the maximum and mean error in LSB.
+static void refine_error(const char *name, int reorthogonalize, int iterations)
+{
+    fix16_t max_error = 0;
+    long total = 0;
+    int i, row;
+    
+    for (i = 0; i < REFINE_SYSTEMS; i++)
+    {
+        mf16 q, r, x;
+        mf16_qr_decomposition(&q, &r, &refine_a[i], reorthogonalize);
+        
+        if (iterations < 0)
+            mf16_solve(&x, &q, &r, &refine_b[i]);
+        else
+            mf16_solve_refined(&x, &refine_a[i], &q, &r, &refine_b[i], iterations);
+        
+        for (row = 0; row < 4; row++)
+        {
+            fix16_t error = fix16_abs(x.data[row][0] - refine_x[i].data[row][0]);
+            max_error = fix16_max(max_error, error);
+            total += error;
+        }
+    }
+    
+    printf("%-40s %8d max, %.1f mean LSB\n", name, max_error,
+           (double)total / (REFINE_SYSTEMS * 4));
+}
+
+static void benchmark_refine()
+{
+    int i, row, column;
+    
+    for (i = 0; i < REFINE_SYSTEMS; i++)
+    {
+        mf16 *a = &refine_a[i], *x = &refine_x[i];
+        a->rows = a->columns = x->rows = 4;
+        x->columns = 1;
+        a->errors = x->errors = 0;
+        
+        for (row = 0; row < 4; row++)
+        {
+            for (column = 0; column < 4; column++)
+                a->data[row][column] = (vectors[i + row][column] >> 4) & ~0x0FFF;
+            x->data[row][0] = (vectors[i + 4][row] >> 8) & ~0x0F;
+        }
+        
+        mf16_mul(&refine_b[i], a, x);
+    }
+    
+    printf("\nAccuracy and time of QR solving, 4x4\n");
+    BENCHMARK("reorthogonalize 0", mf16 q; mf16 r; mf16 x;
+              mf16_qr_decomposition(&q, &r, &refine_a[i % REFINE_SYSTEMS], 0);
+              mf16_solve(&x, &q, &r, &refine_b[i % REFINE_SYSTEMS]); sink = x.data[0][0]);
+    refine_error("reorthogonalize 0", 0, -1);
+    BENCHMARK("reorthogonalize 1", mf16 q; mf16 r; mf16 x;
+              mf16_qr_decomposition(&q, &r, &refine_a[i % REFINE_SYSTEMS], 1);
+              mf16_solve(&x, &q, &r, &refine_b[i % REFINE_SYSTEMS]); sink = x.data[0][0]);
+    refine_error("reorthogonalize 1", 1, -1);
+    BENCHMARK("reorthogonalize 2", mf16 q; mf16 r; mf16 x;
+              mf16_qr_decomposition(&q, &r, &refine_a[i % REFINE_SYSTEMS], 2);
+              mf16_solve(&x, &q, &r, &refine_b[i % REFINE_SYSTEMS]); sink = x.data[0][0]);
+    refine_error("reorthogonalize 2", 2, -1);
+    BENCHMARK("reorthogonalize 0, refined once", mf16 q; mf16 r; mf16 x;
+              mf16_qr_decomposition(&q, &r, &refine_a[i % REFINE_SYSTEMS], 0);
+              mf16_solve_refined(&x, &refine_a[i % REFINE_SYSTEMS], &q, &r,
+                                 &refine_b[i % REFINE_SYSTEMS], 1); sink = x.data[0][0]);
+    refine_error("reorthogonalize 0, refined once", 0, 1);
+    BENCHMARK("reorthogonalize 0, refined twice", mf16 q; mf16 r; mf16 x;
+              mf16_qr_decomposition(&q, &r, &refine_a[i % REFINE_SYSTEMS], 0);
+              mf16_solve_refined(&x, &refine_a[i % REFINE_SYSTEMS], &q, &r,
+                                 &refine_b[i % REFINE_SYSTEMS], 2); sink = x.data[0][0]);
+    refine_error("reorthogonalize 0, refined twice", 0, 2);
+}
+
+static void benchmark_wide()
+{
+    static mf16 spd[COUNT];
+    static mf32 spd32[COUNT];
+    mf16 L;
+    mf32 L32;
+    int i, row, column;
+    
+    // Symmetric positive definite 4x4 matrices A A' + I
+    for (i = 0; i < COUNT; i++)
+    {
+        mf16 a = {4, 4, 0, {{0}}};
+        for (row = 0; row < 4; row++)
+            for (column = 0; column < 4; column++)
+                a.data[row][column] = vectors[(i + row) % COUNT][column] >> 4;
+        
+        mf16_mul_bt(&spd[i], &a, &a);
+        for (row = 0; row < 4; row++)
+            spd[i].data[row][row] += fix16_one;
+        
+        mf32_from_mf16(&spd32[i], &spd[i]);
+    }
+    
+    printf("\nQ32.32 matrices, 4x4\n");
+    BENCHMARK("mf16_mul", mf16_mul(&L, &spd[i], &spd[i]); sink = L.data[3][3]);
+    BENCHMARK("mf32_mul", mf32_mul(&L32, &spd32[i], &spd32[i]); sink = L32.data[3][3]);
+    BENCHMARK("mf16_cholesky", mf16_cholesky(&L, &spd[i]); sink = L.data[3][3]);
+    BENCHMARK("mf32_cholesky", mf32_cholesky(&L32, &spd32[i]); sink = L32.data[3][3]);
+    BENCHMARK("mf32_from_mf16 + cholesky + to_mf16",
+              mf32_from_mf16(&L32, &spd[i]); mf32_cholesky(&L32, &L32);
+              mf32_to_mf16(&L, &L32); sink = L.data[3][3]);
+}
+
+// Circle fit to 8 points: residual d_i - radius, where d_i is the
+// distance of point i from the center.
+static fix16_t circle_x[8], circle_y[8];
+
+static void circle_function(mf16 *residual, mf16 *jacobian, const mf16 *params, void *context)
+{
+    fix16_t cx = params->data[0][0], cy = params->data[1][0], radius = params->data[2][0];
+    int i;
+    (void)context;
+    
+    residual->rows = 8;
+    residual->columns = 1;
+    residual->errors = params->errors;
+    
+    jacobian->rows = 8;
+    jacobian->columns = 3;
+    jacobian->errors = params->errors;
+    
+    for (i = 0; i < 8; i++)
+    {
+        fix16_t dx = circle_x[i] - cx, dy = circle_y[i] - cy;
+        fix16_t d = fix16_sqrt(fix16_sq(dx) + fix16_sq(dy));
+        residual->data[i][0] = d - radius;
+        jacobian->data[i][0] = -fix16_div(dx, d);
+        jacobian->data[i][1] = -fix16_div(dy, d);
+        jacobian->data[i][2] = -fix16_one;
+    }
+}
+
+// Undamped Gauss-Newton iterations written out with mf16 calls.
+static void circle_by_hand(mf16 *params, int iterations)
+{
+    while (iterations--)
+    {
+        mf16 residual, jacobian, q, r, step;
+        circle_function(&residual, &jacobian, params, NULL);
+        mf16_qr_decomposition(&q, &r, &jacobian, 1);
+        mf16_mul_s(&residual, &residual, -fix16_one);
+        mf16_solve(&step, &q, &r, &residual);
+        mf16_add(params, params, &step);
+    }
+}
+
+static void benchmark_nls()
+{
+    static nls16_workspace workspace;
+    const mf16 start = {3, 1, 0, {{F16(1)}, {F16(0)}, {F16(1)}}};
+    nls16_options options;
+    nls16_result result;
+    int i;
+    
+    for (i = 0; i < 8; i++)
+    {
+        fix16_t s, c;
+        fa16_sincos(i * F16(0.785), &s, &c);
+        circle_x[i] = F16(2) + 3 * c + (vectors[i][0] >> 16);
+        circle_y[i] = F16(-1) + 3 * s + (vectors[i][1] >> 16);
+    }
+    
+    nls16_default_options(&options);
+    options.damping = 0;
+    options.method = NLS16_QR;
+    mf16 params = start;
+    nls16_solve(&result, &params, circle_function, NULL, &options, &workspace);
+    
+    printf("\nNonlinear least squares, circle fit to 8 points (%d iterations)\n",
+           result.iterations);
+    BENCHMARK("Gauss-Newton by hand, QR",
+              mf16 p = start; circle_by_hand(&p, result.iterations); sink = p.data[2][0]);
+    BENCHMARK("nls16_solve, Gauss-Newton, QR",
+              mf16 p = start; nls16_solve(&result, &p, circle_function, NULL, &options, &workspace);
+              sink = p.data[2][0]);
+    options.method = NLS16_NORMAL;
+    BENCHMARK("nls16_solve, Gauss-Newton, normal eq.",
+              mf16 p = start; nls16_solve(&result, &p, circle_function, NULL, &options, &workspace);
+              sink = p.data[2][0]);
+    nls16_default_options(&options);
+    BENCHMARK("nls16_solve, default options",
+              mf16 p = start; nls16_solve(&result, &p, circle_function, NULL, &options, &workspace);
+              sink = p.data[2][0]);
+}
+
+// State and covariance of a 6-state filter, published by one writer
+// thread and read continuously by the reader threads.
+#define SHARED_WRITES 100000
+#define SHARED_MAX_READERS 8
+
+static mf16_shared shared_seqlock;
+static pthread_mutex_t shared_mutex = PTHREAD_MUTEX_INITIALIZER;
+static mf16 shared_locked[2];
+static atomic_int shared_done;
+static bool shared_use_mutex;
+
+typedef struct {
+    unsigned long reads;
+    unsigned long retries;
+} shared_reader_stats;
+
+static void *shared_writer(void *arg)
+{
+    mf16 state = {6, 1, 0, {{0}}}, covariance = {6, 6, 0, {{0}}};
+    const mf16 *matrices[2] = {&state, &covariance};
+    int i;
+    (void)arg;
+    
+    for (i = 0; i < SHARED_WRITES; i++)
+    {
+        state.data[i % 6][0] = i;
+        covariance.data[i % 6][(i / 6) % 6] = i;
+        
+        if (shared_use_mutex)
+        {
+            pthread_mutex_lock(&shared_mutex);
+            shared_locked[0] = state;
+            shared_locked[1] = covariance;
+            pthread_mutex_unlock(&shared_mutex);
+        }
+        else
+        {
+            mf16_shared_write(&shared_seqlock, matrices, 2);
+        }
+    }
+    
+    atomic_store(&shared_done, 1);
+    return NULL;
+}
+
+static void *shared_reader(void *arg)
+{
+    shared_reader_stats *stats = arg;
+    mf16 state, covariance;
+    mf16 *const dest[2] = {&state, &covariance};
+    
+    while (!atomic_load_explicit(&shared_done, memory_order_relaxed))
+    {
+        if (shared_use_mutex)
+        {
+            pthread_mutex_lock(&shared_mutex);
+            state = shared_locked[0];
+            covariance = shared_locked[1];
+            pthread_mutex_unlock(&shared_mutex);
+        }
+        else
+        {
+            while (!mf16_shared_try_read(dest, &shared_seqlock, 2))
+                stats->retries++;
+        }
+        
+        sink = covariance.data[5][5];
+        stats->reads++;
+    }
+    
+    return NULL;
+}
+
+static void run_shared(const char *name, bool use_mutex, int readers)
+{
+    static shared_reader_stats stats[SHARED_MAX_READERS];
+    pthread_t writer, reader_threads[SHARED_MAX_READERS];
+    unsigned long reads = 0, retries = 0;
+    char label[64];
+    int i;
+    
+    mf16_shared_init(&shared_seqlock);
+    atomic_store(&shared_done, 0);
+    shared_use_mutex = use_mutex;
+    memset(stats, 0, sizeof(stats));
+    
+    double start = now();
+    for (i = 0; i < readers; i++)
+        pthread_create(&reader_threads[i], NULL, shared_reader, &stats[i]);
+    pthread_create(&writer, NULL, shared_writer, NULL);
+    
+    pthread_join(writer, NULL);
+    double time = now() - start;
+    
+    for (i = 0; i < readers; i++)
+    {
+        pthread_join(reader_threads[i], NULL);
+        reads += stats[i].reads;
+        retries += stats[i].retries;
+    }
+    
+    snprintf(label, sizeof(label), "%s, readers = %d", name, readers);
+    printf("%-40s %8.1f ns per write, %6.1f reads per write, %4.1f %% failed attempts\n",
+           label, time * 1e9 / SHARED_WRITES, (double)reads / SHARED_WRITES,
+           reads ? 100.0 * retries / (reads + retries) : 0.0);
+}
+
+static void benchmark_shared()
+{
+    int readers;
+    
+    printf("\nShared 6x1 state and 6x6 covariance, one writer\n");
+    for (readers = 1; readers <= SHARED_MAX_READERS; readers *= 2)
+    {
+        run_shared("mutex + mf16 copy", true, readers);
+        run_shared("mf16_shared", false, readers);
+    }
+}
+
+int main()
+{
+    int i, j;
+    
+    for (i = 0; i < COUNT; i++)
+    {
+        for (j = 0; j < 4; j++)
+            vectors[i][j] = random_fix16(24);
+        
+        scalars[i] = fix16_abs(random_fix16(24)) + 1;
+    }
+    
+    benchmark_norm();
+    benchmark_vector();
+    benchmark_trig();
+    benchmark_integrate();
+    benchmark_slerp();
+    benchmark_transform();
+    benchmark_orientation();
+    benchmark_string();
+    benchmark_transpose();
+    benchmark_triangular();
+    benchmark_small();
+    benchmark_solve();
+    benchmark_refine();
+    benchmark_wide();
+    benchmark_nls();
+    benchmark_shared();
+    
+    return 0;
+}
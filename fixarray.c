@@ -41,13 +41,13 @@ fix16_t fa16_dot(const fix16_t *a, uint_fast8_t a_stride,
                  const fix16_t *b, uint_fast8_t b_stride,
                  uint_fast8_t n)
 {
-    int64_t sum = 0;
+    fa16_acc sum = {0, 0};
     
     while (n--)
     {
         if (*a != 0 && *b != 0)
         {
-            sum += (int64_t)(*a) * (*b);
+            fa16_acc_add(&sum, (int64_t)(*a) * (*b));
         }
         
         // Go to next item
@@ -55,30 +55,7 @@ fix16_t fa16_dot(const fix16_t *a, uint_fast8_t a_stride,
         b += b_stride;
     }
     
-    // The upper 17 bits should all be the same (the sign).
-    uint32_t upper = sum >> 47;
-    if (sum < 0)
-    {
-        upper = ~upper;
-        
-        #ifndef FIXMATH_NO_ROUNDING
-        // This adjustment is required in order to round -1/2 correctly
-        sum--;
-        #endif
-    }
-    
-    #ifndef FIXMATH_NO_OVERFLOW
-    if (upper)
-        return fix16_overflow;
-    #endif
-    
-    fix16_t result = sum >> 16;
-
-    #ifndef FIXMATH_NO_ROUNDING
-    result += (sum & 0x8000) >> 15;
-    #endif
-    
-    return result;
+    return fa16_acc_round(&sum);
 }
 #endif
 
@@ -96,60 +73,162 @@ static uint8_t clz(uint32_t x)
 }
 #endif
 
-static fix16_t scale_value(fix16_t value, int_fast8_t scale)
+#ifndef FIXMATH_NO_64BIT
+
+static uint_fast8_t clz64(uint64_t x)
 {
-    if (scale > 0)
-    {
-        fix16_t temp = value << scale;
-        if (temp >> scale != value)
-            return fix16_overflow;
-        else
-            return temp;
-    }
-    else if (scale < 0)
-    {
-        return value >> -scale;
-    }
+    uint32_t highpart = (uint32_t)(x >> 32);
+    if (highpart)
+        return clz(highpart);
     else
+        return 32 + clz((uint32_t)x);
+}
+
+// Initial guesses for 1/sqrt(m), m = [16/64, 64/64), indexed by the
+// top 6 bits of m. Values are in 1.15 format and accurate to 7 bits.
+static const uint16_t rsqrt_table[48] = {
+    64535, 62664, 60947, 59364, 57898, 56535, 55265, 54076,
+    52961, 51912, 50923, 49989, 49104, 48265, 47467, 46707,
+    45983, 45292, 44630, 43997, 43390, 42808, 42248, 41710,
+    41192, 40693, 40211, 39746, 39297, 38863, 38443, 38036,
+    37642, 37260, 36889, 36529, 36179, 35840, 35509, 35188,
+    34875, 34571, 34274, 33985, 33703, 33427, 33159, 32897,
+};
+
+// Computes 1/sqrt(m) for m = [0.25, 1) given in 0.32 format, and
+// returns the result in 2.30 format. The table lookup is followed by
+// Newton-Raphson iterations y = y * (3 - m * y^2) / 2, each of which
+// doubles the number of correct bits: 7, 14, 28. The relative error
+// of the result is less than 2^-27.
+static uint32_t rsqrt_normalized(uint32_t m)
+{
+    uint_fast8_t i;
+    uint32_t y = (uint32_t)rsqrt_table[(m >> 26) - 16] << 15;
+    
+    for (i = 0; i < 3; i++)
     {
-        return value;
+        uint64_t y2 = ((uint64_t)y * y) >> 30;
+        uint64_t my2 = (m * y2) >> 32;
+        uint64_t t = ((uint64_t)3 << 30) - my2;
+        y = (uint32_t)((y * t) >> 31);
     }
+    
+    return y;
 }
 
-#ifndef FIXMATH_NO_64BIT
-// Calculates the norm of a vector
-fix16_t fa16_norm(const fix16_t *a, uint_fast8_t a_stride, uint_fast8_t n)
+// Square root of a 64-bit integer, rounded to nearest (or truncated
+// if FIXMATH_NO_ROUNDING is defined). Exact: the Newton-Raphson
+// estimate is fixed up by comparing the square against x.
+static uint32_t isqrt64(uint64_t x)
 {
-    int64_t sum = 0;
+    if (x == 0)
+        return 0;
+    
+    // Normalize to m = x * 2^shift in the range [2^62, 2^64).
+    uint_fast8_t shift = clz64(x) & ~1;
+    uint32_t m = (uint32_t)((x << shift) >> 32);
+    uint64_t y = rsqrt_normalized(m);
+    
+    // sqrt(m) = m / sqrt(m), in 0.32 format.
+    uint64_t root = (m * y) >> 30;
+    uint64_t result = root >> (shift / 2);
+    
+    // The estimate has at most a few LSB error for the largest
+    // values, and is usually exact.
+    if (result > 0xFFFFFFFF) result = 0xFFFFFFFF;
+    while (result * result > x) result--;
+    while (result < 0xFFFFFFFF && (result + 1) * (result + 1) <= x) result++;
+    
+    #ifndef FIXMATH_NO_ROUNDING
+    // (r + 0.5)^2 = r^2 + r + 0.25, and x is integer.
+    if (x - result * result > result && result < 0xFFFFFFFF)
+        result++;
+    #endif
+    
+    return (uint32_t)result;
+}
+
+// Sum of squares of a vector, in 32.32 format.
+// Saturates to UINT64_MAX if the sum does not fit.
+static uint64_t sum_squares(const fix16_t *a, uint_fast8_t a_stride, uint_fast8_t n)
+{
+    uint64_t sum = 0;
     
     while (n--)
     {
         if (*a != 0)
         {
-            sum += (int64_t)(*a) * (*a);
+            uint64_t square = (uint64_t)((int64_t)(*a) * (*a));
+            sum += square;
+            
+            if (sum < square)
+                return UINT64_MAX;
         }
         
         a += a_stride;
     }
     
-    int_fast8_t scale = 0;
-    uint32_t highpart = (uint32_t)(sum >> 32);
-    uint32_t lowpart = (uint32_t)sum;
-    if (highpart)
-        scale = 33 - clz(highpart);
-    else if (lowpart & 0x80000000)
-        scale = 1;
-    
-    if (scale & 1) scale++;
+    return sum;
+}
+
+// Calculates the norm of a vector
+fix16_t fa16_norm(const fix16_t *a, uint_fast8_t a_stride, uint_fast8_t n)
+{
+    // The sum of squares is in 32.32 format, so its integer square
+    // root is directly the norm in 16.16 format.
+    uint64_t sum = sum_squares(a, a_stride, n);
+    uint32_t result = isqrt64(sum);
     
-    fix16_t result = fix16_sqrt((uint32_t)(sum >> scale));
-    result = scale_value(result, scale / 2 - 8);
+    #ifndef FIXMATH_NO_OVERFLOW
+    if (result > 0x7FFFFFFF)
+        return fix16_overflow;
+    #endif
     
     return result;
 }
 
+fix16_t fa16_rsqrt(fix16_t x)
+{
+    if (x <= 0)
+        return fix16_overflow;
+    
+    // With x = m * 2^-shift, 1/sqrt(x) = 1/sqrt(m) * 2^(shift/2).
+    // Converting from 2.30 to 16.16 format and from the 32.32 scale
+    // of m to the 16.16 scale of x gives the final shift.
+    uint_fast8_t shift = clz64((uint64_t)x) & ~1;
+    uint32_t m = (uint32_t)(((uint64_t)x << shift) >> 32);
+    uint32_t y = rsqrt_normalized(m);
+    uint_fast8_t rshift = 38 - shift / 2;
+    
+    #ifndef FIXMATH_NO_ROUNDING
+    y += (uint32_t)1 << (rshift - 1);
+    #endif
+    
+    return y >> rshift;
+}
+
 #else
 
+static fix16_t scale_value(fix16_t value, int_fast8_t scale)
+{
+    if (scale > 0)
+    {
+        fix16_t temp = value << scale;
+        if (temp >> scale != value)
+            return fix16_overflow;
+        else
+            return temp;
+    }
+    else if (scale < 0)
+    {
+        return value >> -scale;
+    }
+    else
+    {
+        return value;
+    }
+}
+
 static uint_fast8_t ilog2(uint_fast8_t v)
 {
     uint_fast8_t result = 0;
@@ -194,6 +273,239 @@ fix16_t fa16_norm(const fix16_t *a, uint_fast8_t a_stride, uint_fast8_t n)
     return scale_value(result, -scale);
 }
 
+fix16_t fa16_rsqrt(fix16_t x)
+{
+    if (x <= 0)
+        return fix16_overflow;
+    
+    return fix16_div(fix16_one, fix16_sqrt(x));
+}
+
+#endif
+
+fix16_t fa16_normalize_inplace(fix16_t *a, uint_fast8_t a_stride, uint_fast8_t n)
+{
+    fix16_t norm = fa16_norm(a, a_stride, n);
+    
+    if (norm == 0 || norm == fix16_overflow)
+        return norm;
+    
+    fa16_divisor divisor;
+    fa16_divisor_init(&divisor, norm);
+    
+    while (n--)
+    {
+        // norm >= a[i] for all i, therefore this cannot overflow.
+        *a = fa16_divide(*a, &divisor);
+        a += a_stride;
+    }
+    
+    return norm;
+}
+
+int_fast8_t fa16_headroom(const fix16_t *a, uint_fast8_t a_stride, uint_fast8_t n)
+{
+    // Inclusive OR of the absolute values has the same highest bit
+    // as the maximum.
+    uint32_t max = 0;
+    while (n--)
+    {
+        max |= (uint32_t)fix16_abs(*a);
+        a += a_stride;
+    }
+    
+    if (max == 0)
+        return 31;
+    
+    if (max & 0x80000000)
+        return 0;
+    
+    return clz(max) - 1;
+}
+
+#ifndef FIXMATH_NO_64BIT
+
+void fa16_divisor_init(fa16_divisor *dest, fix16_t divisor)
+{
+    uint32_t d = (divisor >= 0) ? (uint32_t)divisor : -(uint32_t)divisor;
+    dest->divisor = divisor;
+    
+    if (d == 0)
+        return;
+    
+    // The reciprocal is scaled so that it has 32 significant bits,
+    // 2^31 < multiplier <= 2^32. Then value * multiplier fits in
+    // 64 bits, and the rounding error of the reciprocal causes less
+    // than 0.5 LSB error in any result that does not overflow.
+    uint_fast8_t bits = 32 - clz(d);
+    uint_fast8_t k = bits + 31;
+    dest->multiplier = (((uint64_t)1 << k) + d / 2) / d;
+    dest->shift = k - 16;
+}
+
+fix16_t fa16_divide(fix16_t value, const fa16_divisor *divisor)
+{
+    if (divisor->divisor == 0)
+        return fix16_minimum;
+    
+    uint32_t u = (value >= 0) ? (uint32_t)value : -(uint32_t)value;
+    uint64_t product = (uint64_t)u * divisor->multiplier;
+    
+    #ifndef FIXMATH_NO_ROUNDING
+    product += (uint64_t)1 << (divisor->shift - 1);
+    #endif
+    
+    uint64_t result = product >> divisor->shift;
+    
+    #ifndef FIXMATH_NO_OVERFLOW
+    if (result > 0x7FFFFFFF)
+        return fix16_overflow;
+    #endif
+    
+    if ((value ^ divisor->divisor) & 0x80000000)
+        return -(fix16_t)result;
+    else
+        return (fix16_t)result;
+}
+
+#else
+
+void fa16_divisor_init(fa16_divisor *dest, fix16_t divisor)
+{
+    dest->divisor = divisor;
+}
+
+fix16_t fa16_divide(fix16_t value, const fa16_divisor *divisor)
+{
+    return fix16_div(value, divisor->divisor);
+}
+
+#endif
+
+/************************
+ * Sine and cosine pair *
+ ************************/
+
+#ifndef FIXMATH_NO_64BIT
+
+// The angle is first converted to a fraction of a full turn in 0.32
+// format, by multiplying with 2^16 / (2 pi) in 16.32 format. The
+// product is computed in two halves and wraps around modulo a full
+// turn, so any angle is reduced with an error below 2^-32 turns.
+// Then the nearest multiple of pi/2 is removed, leaving r in the range
+// [-pi/4, pi/4) in units of 2^-30 quarter turns, and the quadrant.
+//
+// The results for r are computed in 2.30 format, and finally rotated
+// to the quadrant and rounded to 16.16 format.
+
+#ifdef FIXMATRIX_SINCOS_TABLE
+
+// sin(i * pi / 128) in 2.30 format for i = 0..64, i.e. both sin and
+// cos of multiples of pi / 128 on [0, pi/4].
+static const uint32_t sin_table[65] = {
+    0, 26350943, 52686014, 78989349, 105245103, 131437462,
+    157550647, 183568930, 209476638, 235258165, 260897982, 286380643,
+    311690799, 336813204, 361732726, 386434353, 410903207, 435124548,
+    459083786, 482766489, 506158392, 529245404, 552013618, 574449320,
+    596538995, 618269338, 639627258, 660599890, 681174602, 701339000,
+    721080937, 740388522, 759250125, 777654384, 795590213, 813046808,
+    830013654, 846480531, 862437520, 877875009, 892783698, 907154608,
+    920979082, 934248793, 946955747, 959092290, 970651112, 981625251,
+    992008094, 1001793390, 1010975242, 1019548121, 1027506862, 1034846671,
+    1041563127, 1047652185, 1053110176, 1057933813, 1062120190, 1065666786,
+    1068571464, 1070832474, 1072448455, 1073418433, 1073741824,
+};
+
+// r = k * pi / 128 + d, where sin and cos of the first part are looked
+// up and those of the remainder, |d| <= pi / 256, are computed with
+// short series. The results are combined with the angle sum formulas.
+static void sincos_reduced(int32_t r, int64_t *s, int64_t *c)
+{
+    const int64_t one = (int64_t)1 << 30;
+    int32_t k = (r + (1 << 23)) >> 24;
+    int64_t d = ((int64_t)(r - k * (1 << 24)) * 1686629713) >> 30;
+    
+    // sin(d) = d - d^3 / 6, cos(d) = 1 - d^2 / 2, with errors below 2^-36.
+    int64_t d2 = (d * d) >> 30;
+    int64_t sin_d = d - ((d * d2) >> 30) / 6;
+    int64_t cos_d = one - d2 / 2;
+    
+    int64_t sin_k = sin_table[(k < 0) ? -k : k];
+    int64_t cos_k = sin_table[64 - ((k < 0) ? -k : k)];
+    if (k < 0)
+        sin_k = -sin_k;
+    
+    *s = (sin_k * cos_d + cos_k * sin_d) >> 30;
+    *c = (cos_k * cos_d - sin_k * sin_d) >> 30;
+}
+
+#else
+
+// Taylor series up to x^7 and x^8. For |x| <= pi/4 the truncation
+// error is below 2^-21, i.e. well below the 16.16 rounding.
+static void sincos_reduced(int32_t r, int64_t *s, int64_t *c)
+{
+    const int64_t one = (int64_t)1 << 30;
+    int64_t x = ((int64_t)r * 1686629713) >> 30;
+    int64_t x2 = (x * x) >> 30;
+    int64_t t;
+    
+    // sin(x) = x (1 - x^2/6 (1 - x^2/20 (1 - x^2/42)))
+    t = one - x2 / 42;
+    t = one - ((x2 * t) >> 30) / 20;
+    t = one - ((x2 * t) >> 30) / 6;
+    *s = (x * t) >> 30;
+    
+    // cos(x) = 1 - x^2/2 (1 - x^2/12 (1 - x^2/30 (1 - x^2/56)))
+    t = one - x2 / 56;
+    t = one - ((x2 * t) >> 30) / 30;
+    t = one - ((x2 * t) >> 30) / 12;
+    *c = one - ((x2 * t) >> 30) / 2;
+}
+
+#endif
+
+static fix16_t round_30_to_16(int64_t value)
+{
+    #ifndef FIXMATH_NO_ROUNDING
+    value += 1 << 13;
+    #endif
+    
+    return (fix16_t)(value >> 14);
+}
+
+void fa16_sincos(fix16_t angle, fix16_t *sine, fix16_t *cosine)
+{
+    const int64_t scale = 44798133900177;
+    uint64_t high = (uint64_t)((angle >> 16) * scale) << 16;
+    uint64_t low = (uint64_t)((angle & 0xFFFF) * scale);
+    uint32_t turns = (uint32_t)((high + low) >> 32);
+    
+    // Round to the nearest quadrant.
+    turns += (uint32_t)1 << 29;
+    uint_fast8_t quadrant = turns >> 30;
+    int32_t r = (int32_t)(turns & 0x3FFFFFFF) - (1 << 29);
+    
+    int64_t s, c;
+    sincos_reduced(r, &s, &c);
+    
+    switch (quadrant)
+    {
+        case 0: *sine = round_30_to_16(s); *cosine = round_30_to_16(c); break;
+        case 1: *sine = round_30_to_16(c); *cosine = round_30_to_16(-s); break;
+        case 2: *sine = round_30_to_16(-s); *cosine = round_30_to_16(-c); break;
+        default: *sine = round_30_to_16(-c); *cosine = round_30_to_16(s); break;
+    }
+}
+
+#else
+
+void fa16_sincos(fix16_t angle, fix16_t *sine, fix16_t *cosine)
+{
+    *sine = fix16_sin(angle);
+    *cosine = fix16_cos(angle);
+}
+
 #endif
 
 void fa16_unalias(void *dest, void **a, void **b, void *tmp, unsigned size)
@@ -3,6 +3,7 @@
 #ifndef _FIXARRAY_H_
 #define _FIXARRAY_H_
 
+#include <stdbool.h>
 #include <fix16.h>
 
 // Calculates the dotproduct of two vectors of size n.
@@ -12,8 +13,113 @@ fix16_t fa16_dot(const fix16_t *a, uint_fast8_t a_stride,
                  uint_fast8_t n);
 
 // Calculates the norm of a vector of size n.
+// If overflow happens, returns fix16_overflow.
+// The result is the correctly rounded square root of the 64-bit sum of
+// squares, computed with a table-seeded Newton-Raphson iteration.
+// With FIXMATH_NO_64BIT, the values are scaled and fix16_sqrt() is used.
 fix16_t fa16_norm(const fix16_t *a, uint_fast8_t a_stride, uint_fast8_t n);
 
+// Divides the vector by its norm in place, and returns the norm.
+// If the norm is 0 or overflows, the vector is left unmodified.
+fix16_t fa16_normalize_inplace(fix16_t *a, uint_fast8_t a_stride, uint_fast8_t n);
+
+// Number of bits that all values can be shifted left without overflow,
+// i.e. the number of redundant sign bits of the largest magnitude.
+// Returns 31 if all values are zero.
+int_fast8_t fa16_headroom(const fix16_t *a, uint_fast8_t a_stride, uint_fast8_t n);
+
+// Calculates 1/sqrt(x) for x > 0, with an error of at most 1 LSB.
+// Returns fix16_overflow for x <= 0.
+fix16_t fa16_rsqrt(fix16_t x);
+
+// Calculates both sin and cos of an angle in radians, with a single
+// range reduction. The error is at most 1 LSB. By default the values
+// are computed with polynomials; define FIXMATRIX_SINCOS_TABLE to use
+// a 260-byte lookup table and shorter polynomials instead.
+// With FIXMATH_NO_64BIT, fix16_sin() and fix16_cos() are used.
+void fa16_sincos(fix16_t angle, fix16_t *sine, fix16_t *cosine);
+
+// Precomputed reciprocal for dividing several values by the same divisor.
+// fa16_divide() replaces the division by a multiplication and returns
+// a result that is within 1 LSB of fix16_div(), including the
+// fix16_overflow and division by zero behaviour.
+typedef struct {
+#ifndef FIXMATH_NO_64BIT
+    uint64_t multiplier;
+    uint8_t shift;
+#endif
+    fix16_t divisor;
+} fa16_divisor;
+
+void fa16_divisor_init(fa16_divisor *dest, fix16_t divisor);
+fix16_t fa16_divide(fix16_t value, const fa16_divisor *divisor);
+
+#ifndef FIXMATH_NO_64BIT
+// Exact sum of up to 512 64-bit products, such as the 32.32 products of
+// fix16_t values, for rounding once at the end. The sum is kept modulo
+// 2^64 in low, and high sums the products divided by 2^40, which is
+// within the number of products of the exact sum divided by 2^40. That
+// detects a sum that wrapped around, without a carry chain through the
+// additions.
+typedef struct {
+    uint64_t low;
+    int32_t high;
+} fa16_acc;
+
+static inline void fa16_acc_add(fa16_acc *acc, int64_t product)
+{
+    acc->low += (uint64_t)product;
+    acc->high += (int32_t)(product >> 40);
+}
+
+// True if the sum fits in int64_t. Below 2^62 in magnitude it always
+// does, and near 2^63 it does if low has the same sign as high.
+static inline bool fa16_acc_fits(const fa16_acc *acc)
+{
+    if (acc->high > -(1 << 22) && acc->high < (1 << 22))
+        return true;
+    
+    if (acc->high < -(1 << 23) - 512 || acc->high > (1 << 23) + 512)
+        return false;
+    
+    return ((int64_t)acc->low < 0) == (acc->high < 0);
+}
+
+// Rounds a sum of 32.32 products to fix16_t.
+// If overflow happens, returns fix16_overflow.
+static inline fix16_t fa16_acc_round(const fa16_acc *acc)
+{
+    int64_t sum = (int64_t)acc->low;
+    
+    // The upper 17 bits should all be the same (the sign).
+    uint32_t upper = sum >> 47;
+    if (sum < 0)
+    {
+        upper = ~upper;
+        
+        #ifndef FIXMATH_NO_ROUNDING
+        // This adjustment is required in order to round -1/2 correctly
+        sum--;
+        #endif
+    }
+    
+    #ifndef FIXMATH_NO_OVERFLOW
+    // A sum that wrapped around has high beyond 2^22, see fa16_acc_fits.
+    upper |= (uint32_t)(acc->high + (1 << 22)) >> 23;
+    if (upper)
+        return fix16_overflow;
+    #endif
+    
+    fix16_t result = sum >> 16;
+    
+    #ifndef FIXMATH_NO_ROUNDING
+    result += (sum & 0x8000) >> 15;
+    #endif
+    
+    return result;
+}
+#endif
+
 // Unalias function arguments using a temporary storage if necessary
 // (not really related to arrays, but common to fixquat/fixvector/fixmatrix)
 void fa16_unalias(void *dest, void **a, void **b, void *tmp, unsigned size);
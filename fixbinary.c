@@ -0,0 +1,281 @@
+#include "fixbinary.h"
+
+static const uint8_t array_magic[4] = {'F', 'X', 'M', 'A'};
+
+static void put_u32(uint8_t *buf, uint32_t value)
+{
+    buf[0] = (uint8_t)value;
+    buf[1] = (uint8_t)(value >> 8);
+    buf[2] = (uint8_t)(value >> 16);
+    buf[3] = (uint8_t)(value >> 24);
+}
+
+static uint32_t get_u32(const uint8_t *buf)
+{
+    return (uint32_t)buf[0] | ((uint32_t)buf[1] << 8) |
+           ((uint32_t)buf[2] << 16) | ((uint32_t)buf[3] << 24);
+}
+
+static void put_values(uint8_t *buf, const fix16_t *values, uint_fast8_t stride, uint_fast8_t n)
+{
+    while (n--)
+    {
+        put_u32(buf, (uint32_t)*values);
+        buf += 4;
+        values += stride;
+    }
+}
+
+static void get_values(fix16_t *values, uint_fast8_t stride, const uint8_t *buf, uint_fast8_t n)
+{
+    while (n--)
+    {
+        *values = (fix16_t)get_u32(buf);
+        buf += 4;
+        values += stride;
+    }
+}
+
+static bool check_tag(const uint8_t *buf, size_t size, size_t needed, uint8_t type)
+{
+    return size >= needed && buf[0] == type && buf[1] == FIXBINARY_VERSION;
+}
+
+/******************
+ * Single records *
+ ******************/
+
+size_t pack_mf16(uint8_t *buf, size_t size, const mf16 *matrix)
+{
+    int row;
+    size_t needed = 5 + 4 * (size_t)matrix->rows * matrix->columns;
+    
+    if (size < needed)
+        return 0;
+    
+    buf[0] = FIXBINARY_MF16;
+    buf[1] = FIXBINARY_VERSION;
+    buf[2] = matrix->rows;
+    buf[3] = matrix->columns;
+    buf[4] = matrix->errors;
+    buf += 5;
+    
+    for (row = 0; row < matrix->rows; row++)
+    {
+        put_values(buf, &matrix->data[row][0], 1, matrix->columns);
+        buf += 4 * matrix->columns;
+    }
+    
+    return needed;
+}
+
+size_t unpack_mf16(mf16 *dest, const uint8_t *buf, size_t size)
+{
+    int row;
+    
+    if (!check_tag(buf, size, 5, FIXBINARY_MF16))
+        return 0;
+    
+    uint8_t rows = buf[2];
+    uint8_t columns = buf[3];
+    size_t needed = 5 + 4 * (size_t)rows * columns;
+    
+    if (size < needed || rows > FIXMATRIX_MAX_SIZE || columns > FIXMATRIX_MAX_SIZE)
+        return 0;
+    
+    dest->rows = rows;
+    dest->columns = columns;
+    dest->errors = buf[4];
+    buf += 5;
+    
+    for (row = 0; row < rows; row++)
+    {
+        get_values(&dest->data[row][0], 1, buf, columns);
+        buf += 4 * columns;
+    }
+    
+    return needed;
+}
+
+size_t pack_qf16(uint8_t *buf, size_t size, const qf16 *quat)
+{
+    if (size < 18)
+        return 0;
+    
+    buf[0] = FIXBINARY_QF16;
+    buf[1] = FIXBINARY_VERSION;
+    put_values(buf + 2, &quat->a, &quat->b - &quat->a, 4);
+    return 18;
+}
+
+size_t unpack_qf16(qf16 *dest, const uint8_t *buf, size_t size)
+{
+    if (!check_tag(buf, size, 18, FIXBINARY_QF16))
+        return 0;
+    
+    get_values(&dest->a, &dest->b - &dest->a, buf + 2, 4);
+    return 18;
+}
+
+size_t pack_v3d(uint8_t *buf, size_t size, const v3d *vector)
+{
+    if (size < 14)
+        return 0;
+    
+    buf[0] = FIXBINARY_V3D;
+    buf[1] = FIXBINARY_VERSION;
+    put_values(buf + 2, &vector->x, &vector->y - &vector->x, 3);
+    return 14;
+}
+
+size_t unpack_v3d(v3d *dest, const uint8_t *buf, size_t size)
+{
+    if (!check_tag(buf, size, 14, FIXBINARY_V3D))
+        return 0;
+    
+    get_values(&dest->x, &dest->y - &dest->x, buf + 2, 3);
+    return 14;
+}
+
+/***************
+ * Array files *
+ ***************/
+
+size_t fb_array_record_size(uint8_t rows, uint8_t columns)
+{
+    return 4 + 4 * (size_t)rows * columns;
+}
+
+size_t pack_array_header(uint8_t *buf, size_t size, const fb_array *array)
+{
+    int i;
+    
+    if (size < FIXBINARY_HEADER_SIZE)
+        return 0;
+    
+    for (i = 0; i < 4; i++)
+        buf[i] = array_magic[i];
+    
+    buf[4] = FIXBINARY_VERSION;
+    buf[5] = array->type;
+    buf[6] = array->rows;
+    buf[7] = array->columns;
+    put_u32(buf + 8, array->count);
+    put_u32(buf + 12, fb_array_record_size(array->rows, array->columns));
+    return FIXBINARY_HEADER_SIZE;
+}
+
+size_t unpack_array_header(fb_array *dest, const uint8_t *buf, size_t size)
+{
+    int i;
+    
+    if (size < FIXBINARY_HEADER_SIZE)
+        return 0;
+    
+    for (i = 0; i < 4; i++)
+    {
+        if (buf[i] != array_magic[i])
+            return 0;
+    }
+    
+    if (buf[4] != FIXBINARY_VERSION)
+        return 0;
+    
+    dest->type = buf[5];
+    dest->rows = buf[6];
+    dest->columns = buf[7];
+    dest->count = get_u32(buf + 8);
+    dest->record_size = get_u32(buf + 12);
+    
+    if (dest->record_size != fb_array_record_size(dest->rows, dest->columns))
+        return 0;
+    
+    return FIXBINARY_HEADER_SIZE;
+}
+
+// Finds the start of a record in an array file of mf16 records.
+// Returns NULL if the file is invalid or too short.
+static const uint8_t *find_record(fb_array *array, const uint8_t *buf,
+                                  size_t size, uint32_t index)
+{
+    if (!unpack_array_header(array, buf, size))
+        return NULL;
+    
+    if (array->type != FIXBINARY_MF16 || index >= array->count ||
+        array->rows > FIXMATRIX_MAX_SIZE || array->columns > FIXMATRIX_MAX_SIZE)
+        return NULL;
+    
+    size_t offset = FIXBINARY_HEADER_SIZE + (size_t)index * array->record_size;
+    if (offset + array->record_size > size)
+        return NULL;
+    
+    return buf + offset;
+}
+
+size_t pack_mf16_record(uint8_t *buf, size_t size, uint32_t index, const mf16 *matrix)
+{
+    fb_array array;
+    uint8_t *record = (uint8_t*)find_record(&array, buf, size, index);
+    int row;
+    
+    if (!record || matrix->rows != array.rows || matrix->columns != array.columns)
+        return 0;
+    
+    record[0] = matrix->errors;
+    record[1] = record[2] = record[3] = 0;
+    
+    for (row = 0; row < matrix->rows; row++)
+    {
+        put_values(record + 4 + 4 * row * matrix->columns,
+                   &matrix->data[row][0], 1, matrix->columns);
+    }
+    
+    return array.record_size;
+}
+
+size_t unpack_mf16_record(mf16 *dest, const uint8_t *buf, size_t size, uint32_t index)
+{
+    fb_array array;
+    const uint8_t *record = find_record(&array, buf, size, index);
+    int row;
+    
+    if (!record)
+        return 0;
+    
+    dest->rows = array.rows;
+    dest->columns = array.columns;
+    dest->errors = record[0];
+    
+    for (row = 0; row < dest->rows; row++)
+    {
+        get_values(&dest->data[row][0], 1,
+                   record + 4 + 4 * row * dest->columns, dest->columns);
+    }
+    
+    return array.record_size;
+}
+
+bool view_mf16_record(mf16_view *dest, uint8_t *buf, size_t size, uint32_t index)
+{
+    return view_mf16_record_const(dest, buf, size, index);
+}
+
+bool view_mf16_record_const(mf16_view *dest, const uint8_t *buf, size_t size, uint32_t index)
+{
+    const uint32_t byte_order = 1;
+    fb_array array;
+    
+    // The view type has no const variant, the caller promises to use
+    // the view only as an operand.
+    uint8_t *record = (uint8_t*)find_record(&array, buf, size, index);
+    
+    if (!record || *(const uint8_t*)&byte_order != 1 || ((uintptr_t)record & 3))
+        return false;
+    
+    dest->data = (fix16_t*)(record + 4);
+    dest->rows = array.rows;
+    dest->columns = array.columns;
+    dest->stride = array.columns;
+    dest->errors = record;
+    return true;
+}
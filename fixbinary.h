@@ -0,0 +1,83 @@
+/* Compact binary encoding of fix16_t datatypes.
+ *
+ * All values are stored as little-endian two's complement 32-bit
+ * integers, independent of the host byte order. Each record starts
+ * with a type tag and FIXBINARY_VERSION, so that readers can reject
+ * data they don't understand.
+ *
+ * Single records (pack_* / unpack_*):
+ *   mf16: 'M', version, rows, columns, errors, rows * columns values
+ *   qf16: 'Q', version, a, b, c, d
+ *   v3d:  'V', version, x, y, z
+ *
+ * Array files hold many records of the same type and size, so that
+ * entry i can be found without parsing the preceding ones:
+ *   header (16 bytes): "FXMA", version, type, rows, columns,
+ *                      count (uint32), record size in bytes (uint32)
+ *   records: errors (1 byte), 3 bytes padding, rows * columns values
+ * The values of a record are 4-byte aligned, so on little-endian hosts
+ * a memory-mapped file can be accessed through mf16_view directly.
+ */
+
+#ifndef _FIXBINARY_H_
+#define _FIXBINARY_H_
+
+#include <stddef.h>
+#include <fix16.h>
+#include "fixmatrix.h"
+#include "fixquat.h"
+#include "fixvector3d.h"
+
+#define FIXBINARY_VERSION 1
+
+#define FIXBINARY_MF16 'M'
+#define FIXBINARY_QF16 'Q'
+#define FIXBINARY_V3D  'V'
+
+#define FIXBINARY_HEADER_SIZE 16
+
+// All pack_*() functions return the number of bytes written, or 0 if
+// the buffer is too small. All unpack_*() functions return the number
+// of bytes consumed, or 0 if the data is truncated or invalid.
+size_t pack_mf16(uint8_t *buf, size_t size, const mf16 *matrix);
+size_t unpack_mf16(mf16 *dest, const uint8_t *buf, size_t size);
+size_t pack_qf16(uint8_t *buf, size_t size, const qf16 *quat);
+size_t unpack_qf16(qf16 *dest, const uint8_t *buf, size_t size);
+size_t pack_v3d(uint8_t *buf, size_t size, const v3d *vector);
+size_t unpack_v3d(v3d *dest, const uint8_t *buf, size_t size);
+
+// Description of an array file.
+typedef struct {
+    uint8_t type;
+    uint8_t rows;
+    uint8_t columns;
+    uint32_t count;
+    uint32_t record_size; // Filled in by unpack_array_header()
+} fb_array;
+
+size_t pack_array_header(uint8_t *buf, size_t size, const fb_array *array);
+size_t unpack_array_header(fb_array *dest, const uint8_t *buf, size_t size);
+
+// Size of a single record in an array file.
+size_t fb_array_record_size(uint8_t rows, uint8_t columns);
+
+// Write or read record number index of an array file. The buffer
+// points to the start of the file, including the header.
+// The matrix must have the dimensions given in the header.
+size_t pack_mf16_record(uint8_t *buf, size_t size, uint32_t index, const mf16 *matrix);
+size_t unpack_mf16_record(mf16 *dest, const uint8_t *buf, size_t size, uint32_t index);
+
+// Create a view to record number index of an array file of mf16
+// records, without copying the values. Buffer must be 4-byte aligned.
+// Returns false if the header is invalid, index is out of range, or
+// the host is not little-endian; use unpack_mf16_record() then.
+// A view used as the destination of an operation writes into the
+// buffer, so the buffer must be writable.
+bool view_mf16_record(mf16_view *dest, uint8_t *buf, size_t size, uint32_t index);
+
+// Same for a read-only buffer, e.g. a file mapped with PROT_READ.
+// The view must only be used as an operand, through const mf16_view *,
+// never as a destination.
+bool view_mf16_record_const(mf16_view *dest, const uint8_t *buf, size_t size, uint32_t index);
+
+#endif
@@ -0,0 +1,115 @@
+#include <stdio.h>
+#include <string.h>
+#include "unittests.h"
+#include "fixbinary.h"
+
+int main()
+{
+    int status = 0;
+    
+    {
+        COMMENT("Test mf16 packing");
+        mf16 a = {3, 2, FIXMATRIX_OVERFLOW, {
+            {F16(1.5), F16(-2)},
+            {fix16_maximum, fix16_minimum},
+            {F16(0.001), F16(-0.001)}
+        }};
+        mf16 b = {0};
+        uint8_t buf[64];
+        
+        TEST(pack_mf16(buf, sizeof(buf), &a) == 5 + 4 * 6);
+        TEST(buf[0] == 'M' && buf[1] == FIXBINARY_VERSION && buf[2] == 3 && buf[3] == 2);
+        TEST(buf[4] == FIXMATRIX_OVERFLOW);
+        TEST(buf[5] == 0x00 && buf[6] == 0x80 && buf[7] == 0x01 && buf[8] == 0x00);
+        TEST(unpack_mf16(&b, buf, sizeof(buf)) == 5 + 4 * 6);
+        TEST(b.rows == 3 && b.columns == 2 && b.errors == FIXMATRIX_OVERFLOW);
+        TEST(memcmp(a.data, b.data, 3 * sizeof(a.data[0])) == 0);
+        
+        TEST(pack_mf16(buf, 28, &a) == 0);
+        TEST(unpack_mf16(&b, buf, 28) == 0);
+        buf[1] = FIXBINARY_VERSION + 1;
+        TEST(unpack_mf16(&b, buf, sizeof(buf)) == 0);
+        buf[1] = FIXBINARY_VERSION;
+        buf[2] = FIXMATRIX_MAX_SIZE + 1;
+        TEST(unpack_mf16(&b, buf, sizeof(buf)) == 0);
+    }
+    
+    {
+        COMMENT("Test qf16 and v3d packing");
+        qf16 q = {F16(0.5), F16(-0.5), F16(0.25), F16(-0.75)}, q2;
+        v3d v = {F16(1), F16(-2), F16(3)}, v2;
+        uint8_t buf[32];
+        
+        TEST(pack_qf16(buf, sizeof(buf), &q) == 18);
+        TEST(unpack_v3d(&v2, buf, sizeof(buf)) == 0);
+        TEST(unpack_qf16(&q2, buf, sizeof(buf)) == 18);
+        TEST(q2.a == q.a && q2.b == q.b && q2.c == q.c && q2.d == q.d);
+        
+        TEST(pack_v3d(buf, 13, &v) == 0);
+        TEST(pack_v3d(buf, sizeof(buf), &v) == 14);
+        TEST(unpack_v3d(&v2, buf, 13) == 0);
+        TEST(unpack_v3d(&v2, buf, sizeof(buf)) == 14);
+        TEST(v2.x == v.x && v2.y == v.y && v2.z == v.z);
+    }
+    
+    {
+        COMMENT("Test array files");
+        uint32_t storage[64];
+        uint8_t *buf = (uint8_t*)storage;
+        size_t size = FIXBINARY_HEADER_SIZE + 3 * fb_array_record_size(2, 2);
+        fb_array array = {FIXBINARY_MF16, 2, 2, 3, 0};
+        mf16 a = {2, 2, 0, {{F16(1), F16(2)}, {F16(3), F16(4)}}};
+        mf16 b;
+        mf16_view view;
+        
+        TEST(pack_array_header(buf, size, &array) == FIXBINARY_HEADER_SIZE);
+        TEST(pack_mf16_record(buf, size, 0, &a) == 20);
+        a.data[0][0] = F16(-1);
+        a.errors = FIXMATRIX_SINGULAR;
+        TEST(pack_mf16_record(buf, size, 2, &a) == 20);
+        TEST(pack_mf16_record(buf, size, 3, &a) == 0);
+        TEST(pack_mf16_record(buf, size - 1, 2, &a) == 0);
+        
+        TEST(unpack_array_header(&array, buf, size) == FIXBINARY_HEADER_SIZE);
+        TEST(array.count == 3 && array.record_size == 20);
+        TEST(unpack_mf16_record(&b, buf, size, 2) == 20);
+        TEST(b.rows == 2 && b.columns == 2 && b.errors == FIXMATRIX_SINGULAR);
+        TEST(b.data[0][0] == F16(-1) && b.data[1][1] == F16(4));
+        
+        COMMENT("Test views to array records");
+        TEST(view_mf16_record(&view, buf, size, 3) == false);
+        TEST(view_mf16_record(&view, buf, size, 0) == true);
+        TEST(view.rows == 2 && view.columns == 2 && view.stride == 2);
+        TEST(view.data[0] == F16(1) && view.data[3] == F16(4));
+        
+        mf16 c = {2, 2, 0, {{F16(1), F16(0)}, {F16(0), F16(1)}}};
+        mf16_view ident;
+        mf16_view_block(&ident, &c, 0, 0, 2, 2);
+        mf16_view_mul_s(&view, &ident, F16(5));
+        TEST(unpack_mf16_record(&b, buf, size, 0) == 20);
+        TEST(b.data[0][0] == F16(5) && b.data[0][1] == 0 && b.errors == 0);
+        
+        TEST(view_mf16_record(&view, buf, size, 2) == true);
+        TEST(*view.errors == FIXMATRIX_SINGULAR);
+        
+        COMMENT("Test read-only views to array records");
+        const uint8_t *cbuf = buf;
+        mf16_view ro, dest;
+        mf16 d = {2, 2, 0, {{0}}};
+        mf16_view_block(&dest, &d, 0, 0, 2, 2);
+        TEST(view_mf16_record_const(&ro, cbuf, size, 3) == false);
+        TEST(view_mf16_record_const(&ro, cbuf, size, 0) == true);
+        mf16_view_mul_s(&dest, &ro, F16(2));
+        TEST(d.errors == 0 && d.data[0][0] == F16(10) && d.data[1][1] == F16(10));
+        TEST(ro.data[0] == F16(5) && *ro.errors == 0);
+        
+        buf[0] = 'X';
+        TEST(view_mf16_record(&view, buf, size, 0) == false);
+        TEST(unpack_mf16_record(&b, buf, size, 0) == 0);
+    }
+    
+    if (status != 0)
+        fprintf(stdout, "\n\nSome tests FAILED!\n");
+    
+    return status;
+}
@@ -36,93 +36,133 @@ void mf16_fill_diagonal(mf16 *dest, fix16_t value)
  * Operations between 2 matrices *
  *********************************/
 
-void mf16_mul(mf16 *dest, const mf16 *a, const mf16 *b)
+// Square products of the common sizes 2x2, 3x3 and 4x4 are computed by
+// kernels where n is a constant, so that the compiler can unroll them
+// completely. The results are identical to those of fa16_dot(), and are
+// collected in a local array, so aliasing needs no copy of the inputs.
+#ifndef FIXMATH_NO_64BIT
+static inline fix16_t small_dot(const fix16_t *a, int a_step,
+                                const fix16_t *b, int b_step, int n)
 {
-    int row, column;
-    
-    // If dest and input matrices alias, we have to use a temp matrix.
-    mf16 tmp;
-    fa16_unalias(dest, (void**)&a, (void**)&b, &tmp, sizeof(tmp));
-    
-    dest->errors = a->errors | b->errors;
+    fa16_acc sum = {0, 0};
+    int k;
     
-    if (a->columns != b->rows)
-        dest->errors |= FIXMATRIX_DIMERR;
+    for (k = 0; k < n; k++)
+        fa16_acc_add(&sum, (int64_t)a[k * a_step] * b[k * b_step]);
     
-    dest->rows = a->rows;
-    dest->columns = b->columns;
+    return fa16_acc_round(&sum);
+}
+#else
+#define small_dot fa16_dot
+#endif
+
+static inline void small_mul(mf16 *dest, const fix16_t *a, int a_row_step, int a_inner_step,
+                             const fix16_t *b, int b_column_step, int b_inner_step,
+                             uint8_t errors, int n)
+{
+    fix16_t result[4][4];
+    int row, column;
     
-    for (row = 0; row < dest->rows; row++)
+    for (row = 0; row < n; row++)
     {
-        for (column = 0; column < dest->columns; column++)
+        for (column = 0; column < n; column++)
         {
-            dest->data[row][column] = fa16_dot(
-                &a->data[row][0], 1,
-                &b->data[0][column], FIXMATRIX_MAX_SIZE,
-                a->columns);
+            fix16_t value = small_dot(a + row * a_row_step, a_inner_step,
+                                      b + column * b_column_step, b_inner_step, n);
+            result[row][column] = value;
             
-            if (dest->data[row][column] == fix16_overflow)
-                dest->errors |= FIXMATRIX_OVERFLOW;
+            if (value == fix16_overflow)
+                errors |= FIXMATRIX_OVERFLOW;
         }
     }
+    
+    dest->rows = dest->columns = n;
+    dest->errors = errors;
+    
+    for (row = 0; row < n; row++)
+    {
+        for (column = 0; column < n; column++)
+            dest->data[row][column] = result[row][column];
+    }
 }
 
-// Multiply transpose of at with b
-void mf16_mul_at(mf16 *dest, const mf16 *at, const mf16 *b)
+void mf16_mul_ex(mf16 *dest, const mf16 *a, const mf16 *b, uint8_t flags)
 {
     int row, column;
-    
-    // If dest and input matrices alias, we have to use a temp matrix.
+    uint_fast8_t a_rows, b_columns, inner, b_inner;
+    uint_fast8_t a_row_step, a_inner_step, b_column_step, b_inner_step;
     mf16 tmp;
-    fa16_unalias(dest, (void**)&at, (void**)&b, &tmp, sizeof(tmp));
     
-    dest->errors = at->errors | b->errors;
-    
-    if (at->rows != b->rows)
-        dest->errors |= FIXMATRIX_DIMERR;
+    // Entry (i, k) of the operand is at i * row_step + k * inner_step,
+    // so a transposed operand just swaps the steps.
+    if (flags & FIXMATRIX_TRANSPOSE_A)
+    {
+        a_rows = a->columns;
+        inner = a->rows;
+        a_row_step = 1;
+        a_inner_step = FIXMATRIX_MAX_SIZE;
+    }
+    else
+    {
+        a_rows = a->rows;
+        inner = a->columns;
+        a_row_step = FIXMATRIX_MAX_SIZE;
+        a_inner_step = 1;
+    }
     
-    dest->rows = at->columns;
-    dest->columns = b->columns;
+    if (flags & FIXMATRIX_TRANSPOSE_B)
+    {
+        b_columns = b->rows;
+        b_inner = b->columns;
+        b_column_step = FIXMATRIX_MAX_SIZE;
+        b_inner_step = 1;
+    }
+    else
+    {
+        b_columns = b->columns;
+        b_inner = b->rows;
+        b_column_step = 1;
+        b_inner_step = FIXMATRIX_MAX_SIZE;
+    }
     
-    for (row = 0; row < dest->rows; row++)
+    if (a_rows == inner && b_inner == inner && b_columns == inner)
     {
-        for (column = 0; column < dest->columns; column++)
+        const fix16_t *pa = &a->data[0][0], *pb = &b->data[0][0];
+        uint8_t errors = a->errors | b->errors;
+        
+        switch (inner)
         {
-            dest->data[row][column] = fa16_dot(
-                &at->data[0][row], FIXMATRIX_MAX_SIZE,
-                &b->data[0][column], FIXMATRIX_MAX_SIZE,
-                at->rows);
-            
-            if (dest->data[row][column] == fix16_overflow)
-                dest->errors |= FIXMATRIX_OVERFLOW;
+            case 2:
+                small_mul(dest, pa, a_row_step, a_inner_step, pb, b_column_step, b_inner_step, errors, 2);
+                return;
+            case 3:
+                small_mul(dest, pa, a_row_step, a_inner_step, pb, b_column_step, b_inner_step, errors, 3);
+                return;
+            case 4:
+                small_mul(dest, pa, a_row_step, a_inner_step, pb, b_column_step, b_inner_step, errors, 4);
+                return;
         }
     }
-}
-
-void mf16_mul_bt(mf16 *dest, const mf16 *a, const mf16 *bt)
-{
-    int row, column;
     
     // If dest and input matrices alias, we have to use a temp matrix.
-    mf16 tmp;
-    fa16_unalias(dest, (void**)&a, (void**)&bt, &tmp, sizeof(tmp));
+    fa16_unalias(dest, (void**)&a, (void**)&b, &tmp, sizeof(tmp));
     
-    dest->errors = a->errors | bt->errors;
+    dest->errors = a->errors | b->errors;
     
-    if (a->columns != bt->columns)
+    if (inner != b_inner)
         dest->errors |= FIXMATRIX_DIMERR;
     
-    dest->rows = a->rows;
-    dest->columns = bt->rows;
+    dest->rows = a_rows;
+    dest->columns = b_columns;
     
     for (row = 0; row < dest->rows; row++)
     {
         for (column = 0; column < dest->columns; column++)
         {
             dest->data[row][column] = fa16_dot(
-                &a->data[row][0], 1,
-                &bt->data[column][0], 1,
-                a->columns);
+                &a->data[0][0] + row * a_row_step, a_inner_step,
+                &b->data[0][0] + column * b_column_step, b_inner_step,
+                inner);
             
             if (dest->data[row][column] == fix16_overflow)
                 dest->errors |= FIXMATRIX_OVERFLOW;
@@ -130,6 +170,22 @@ void mf16_mul_bt(mf16 *dest, const mf16 *a, const mf16 *bt)
     }
 }
 
+void mf16_mul(mf16 *dest, const mf16 *a, const mf16 *b)
+{
+    mf16_mul_ex(dest, a, b, 0);
+}
+
+// Multiply transpose of at with b
+void mf16_mul_at(mf16 *dest, const mf16 *at, const mf16 *b)
+{
+    mf16_mul_ex(dest, at, b, FIXMATRIX_TRANSPOSE_A);
+}
+
+void mf16_mul_bt(mf16 *dest, const mf16 *a, const mf16 *bt)
+{
+    mf16_mul_ex(dest, a, bt, FIXMATRIX_TRANSPOSE_B);
+}
+
 static void mf16_addsub(mf16 *dest, const mf16 *a, const mf16 *b, uint8_t add)
 {
     int row, column;
@@ -173,39 +229,117 @@ void mf16_sub(mf16 *dest, const mf16 *a, const mf16 *b)
  * Operations on a single matrix *
  *********************************/
 
-void mf16_transpose(mf16 *dest, const mf16 *matrix)
+// Both transpose variants go through the matrix in square tiles, so that
+// the rows being read and the rows being written stay in cache when
+// FIXMATRIX_MAX_SIZE is large. With the default size the whole matrix
+// is a single tile.
+#ifndef FIXMATRIX_TRANSPOSE_TILE
+#define FIXMATRIX_TRANSPOSE_TILE 16
+#endif
+
+static int min_int(int a, int b)
+{
+    return (a < b) ? a : b;
+}
+
+// Copies the transpose of rows row0..row_end-1 and columns
+// column0..column_end-1. Each dest row is written sequentially.
+static void transpose_copy_tile(mf16 *dest, const mf16 *matrix,
+                                int row0, int row_end,
+                                int column0, int column_end)
 {
     int row, column;
     
-    // This code is a bit tricky in order to work
-    // in the situation when dest = matrix.
-    // Before writing a value in dest, we must copy
-    // the corresponding value from matrix to a temporary
-    // variable.
+    for (column = column0; column < column_end; column++)
+    {
+        for (row = row0; row < row_end; row++)
+        {
+            dest->data[column][row] = matrix->data[row][column];
+        }
+    }
+}
+
+// Swaps the entries below the diagonal in rows row0..row_end-1 and
+// columns from column0 up to the limit with those above the diagonal.
+// A pair needs to be swapped only if either entry is in the live region.
+static void transpose_swap_tile(mf16 *matrix, int row0, int row_end,
+                                int column0, int column_end)
+{
+    int row, column;
+    int rows = matrix->rows;
+    int columns = matrix->columns;
     
-    // We actually transpose a n by n square matrix, because
-    // that can be done in-place easily. Because mf16 always
-    // allocates a square area even if actual matrix is smaller,
-    // this is not a problem.
-    int n = matrix->rows;
-    if (matrix->columns > n) n = matrix->columns;
+    for (row = row0; row < row_end; row++)
+    {
+        int limit = (row < rows) ? columns : 0;
+        if (row < columns && rows > limit)
+            limit = rows;
+        
+        limit = min_int(min_int(limit, column_end), row);
+        
+        for (column = column0; column < limit; column++)
+        {
+            fix16_t temp = matrix->data[row][column];
+            matrix->data[row][column] = matrix->data[column][row];
+            matrix->data[column][row] = temp;
+        }
+    }
+}
+
+void mf16_transpose(mf16 *dest, const mf16 *matrix)
+{
+    // Only the live region is touched. For dest = matrix, the entries
+    // are swapped in place.
+    int rows = matrix->rows;
+    int columns = matrix->columns;
+    
+#if FIXMATRIX_MAX_SIZE > FIXMATRIX_TRANSPOSE_TILE
+    const int tile = FIXMATRIX_TRANSPOSE_TILE;
+    int row0, column0;
+    
+    if (dest == matrix)
+    {
+        int n = (rows > columns) ? rows : columns;
+        for (row0 = 0; row0 < n; row0 += tile)
+            for (column0 = 0; column0 <= row0; column0 += tile)
+                transpose_swap_tile(dest, row0, min_int(row0 + tile, n), column0, column0 + tile);
+    }
+    else
+    {
+        for (column0 = 0; column0 < columns; column0 += tile)
+            for (row0 = 0; row0 < rows; row0 += tile)
+                transpose_copy_tile(dest, matrix, row0, min_int(row0 + tile, rows),
+                                    column0, min_int(column0 + tile, columns));
+    }
+#else
+    if (dest == matrix)
+        transpose_swap_tile(dest, 0, (rows > columns) ? rows : columns, 0, FIXMATRIX_MAX_SIZE);
+    else
+        transpose_copy_tile(dest, matrix, 0, rows, 0, columns);
+#endif
     
-    uint8_t rows = matrix->rows;
-    dest->rows = matrix->columns;
+    dest->rows = columns;
     dest->columns = rows;
     dest->errors = matrix->errors;
+}
+
+fix16_t mf16_trace(const mf16 *matrix)
+{
+    fix16_t sum = 0;
+    int i;
     
-    for (row = 0; row < n; row++)
+    if (matrix->rows != matrix->columns || matrix->errors)
+        return fix16_overflow;
+    
+    for (i = 0; i < matrix->rows; i++)
     {
-        for (column = 0; column < row; column++)
-        {
-            fix16_t temp = matrix->data[row][column];
-            dest->data[row][column] = matrix->data[column][row];
-            dest->data[column][row] = temp;
-        }
+        sum = fix16_add(sum, matrix->data[i][i]);
         
-        dest->data[row][row] = matrix->data[row][row];
+        if (sum == fix16_overflow)
+            return fix16_overflow;
     }
+    
+    return sum;
 }
 
 /***************************************
@@ -220,6 +354,12 @@ static void mf16_divmul_s(mf16 *dest, const mf16 *matrix, fix16_t scalar, uint8_
     dest->columns = matrix->columns;
     dest->errors = matrix->errors;
     
+    // Division is done by multiplying with a reciprocal that is
+    // computed only once for the whole matrix.
+    fa16_divisor divisor;
+    if (!mul)
+        fa16_divisor_init(&divisor, scalar);
+    
     for (row = 0; row < dest->rows; row++)
     {
         for (column = 0; column < dest->columns; column++)
@@ -229,7 +369,7 @@ static void mf16_divmul_s(mf16 *dest, const mf16 *matrix, fix16_t scalar, uint8_
             if (mul)
                 value = fix16_mul(value, scalar);
             else
-                value = fix16_div(value, scalar);
+                value = fa16_divide(value, &divisor);
             
             if (value == fix16_overflow)
                 dest->errors |= FIXMATRIX_OVERFLOW;
@@ -279,33 +419,36 @@ static void subtract_projection(fix16_t *v, const fix16_t *u, fix16_t dot, int n
     }
 }
 
-void mf16_qr_decomposition(mf16 *q, mf16 *r, const mf16 *matrix, int reorthogonalize)
+// Index of entry (row, column), row >= column, in packed triangular storage.
+static int tri_index(int row, int column)
+{
+    return row * (row + 1) / 2 + column;
+}
+
+// Gram-Schmidt orthogonalization of the columns of q, in place.
+// Entry (i, j) of R is stored at r[i * FIXMATRIX_MAX_SIZE + j], or at
+// r[tri_index(j, i)] if packed is set. Entries below the diagonal are
+// not written.
+static void qr_gram_schmidt(mf16 *q, fix16_t *r, bool packed, int reorthogonalize)
 {
     int i, j, reorth;
     fix16_t dot, norm;
     
     uint8_t stride = FIXMATRIX_MAX_SIZE;
-    uint8_t n = matrix->rows;
+    uint8_t n = q->rows;
     
     // This uses the modified Gram-Schmidt algorithm.
     // subtract_projection takes advantage of the fact that
     // previous columns have already been normalized.
-    
-    // We start with q = matrix
-    if (q != matrix)
-    {
-        *q = *matrix;
-    }
-    
-    // R is initialized to have square size of cols(A) and zeroed.
-    r->columns = matrix->columns;
-    r->rows = matrix->columns;
-    r->errors = 0;
-    mf16_fill(r, 0);
-    
-    // Now do the actual Gram-Schmidt for the rows.
     for (j = 0; j < q->columns; j++)
     {
+        // Column j of R, entries 0..j
+        fix16_t *r_column = packed ? r + tri_index(j, 0) : r + j;
+        int r_stride = packed ? 1 : FIXMATRIX_MAX_SIZE;
+        
+        for (i = 0; i < j; i++)
+            r_column[i * r_stride] = 0;
+        
         for (reorth = 0; reorth <= reorthogonalize; reorth++)
         {
             for (i = 0; i < j; i++)
@@ -319,39 +462,189 @@ void mf16_qr_decomposition(mf16 *q, mf16 *r, const mf16 *matrix, int reorthogona
                 if (dot == fix16_overflow)
                     q->errors |= FIXMATRIX_OVERFLOW;
                 
-                r->data[i][j] += dot;
+                r_column[i * r_stride] += dot;
             }
         }
         
-        // Normalize the row in q
+        // Normalize the column in q
         norm = fa16_norm(&q->data[0][j], stride, n);
-        r->data[j][j] = norm;
+        r_column[j * r_stride] = norm;
         
         if (norm == fix16_overflow)
+        {
             q->errors |= FIXMATRIX_OVERFLOW;
+            continue;
+        }
         
         if (norm < 5 && norm > -5)
         {
             // Nearly zero norm, which means that the row
-            // was linearly dependent.
+            // was linearly dependent. The remainder is rounding
+            // noise, which is left unscaled.
             q->errors |= FIXMATRIX_SINGULAR;
             continue;
         }
         
+        fa16_divisor divisor;
+        fa16_divisor_init(&divisor, norm);
+        
         for (i = 0; i < n; i++)
         {
             // norm >= v[i] for all i, therefore this division
-            // doesn't overflow unless norm approaches 0.
-            q->data[i][j] = fix16_div(q->data[i][j], norm);
+            // doesn't overflow.
+            q->data[i][j] = fa16_divide(q->data[i][j], &divisor);
         }
     }
+}
+
+void mf16_qr_decomposition(mf16 *q, mf16 *r, const mf16 *matrix, int reorthogonalize)
+{
+    // We start with q = matrix
+    if (q != matrix)
+    {
+        *q = *matrix;
+    }
+    
+    // R is initialized to have square size of cols(A) and zeroed.
+    r->columns = q->columns;
+    r->rows = q->columns;
+    r->errors = 0;
+    mf16_fill(r, 0);
+    
+    // Now do the actual Gram-Schmidt for the rows.
+    qr_gram_schmidt(q, &r->data[0][0], false, reorthogonalize);
     
     r->errors = q->errors;
 }
 
+// Sums of products for the substitution loops. With 64-bit support the
+// products are accumulated exactly and rounded once in sum_result(),
+// otherwise each product is rounded by fix16_mul() and overflows are
+// flagged as they happen.
+#ifndef FIXMATH_NO_64BIT
+
+typedef fa16_acc sum_t;
+static const sum_t sum_zero = {0, 0};
+
+static void sum_mac(sum_t *sum, fix16_t a, fix16_t b, uint8_t *errors)
+{
+    (void)errors;
+    fa16_acc_add(sum, (int64_t)a * b);
+}
+
+static void sum_msub(sum_t *sum, fix16_t a, fix16_t b, uint8_t *errors)
+{
+    (void)errors;
+    fa16_acc_add(sum, -((int64_t)a * b));
+}
+
+// Rounds to fix16_t, returns fix16_overflow if the sum doesn't fit.
+static fix16_t sum_result(sum_t sum)
+{
+    return fa16_acc_round(&sum);
+}
+
+// Rounded quotient of two 64-bit values as a fix16_t, i.e. the
+// numerator is in units of 2^-16 of the denominator. Returns
+// fix16_overflow if it doesn't fit. The denominator must not be 0.
+static fix16_t div_round64(int64_t numerator, int64_t denominator)
+{
+    // Magnitudes as unsigned, so that -2^63 needs no special case.
+    uint64_t n = (numerator < 0) ? -(uint64_t)numerator : (uint64_t)numerator;
+    uint64_t d = (denominator < 0) ? -(uint64_t)denominator : (uint64_t)denominator;
+    uint64_t quotient = n / d;
+    
+    #ifndef FIXMATH_NO_ROUNDING
+    uint64_t remainder = n % d;
+    if (remainder >= d - remainder)
+        quotient++;
+    #endif
+    
+    if (quotient > 0x7FFFFFFF)
+        return fix16_overflow;
+    
+    return ((numerator < 0) != (denominator < 0)) ? -(fix16_t)quotient : (fix16_t)quotient;
+}
+
+// Divides the sum by a fix16_t value, so that only the quotient has to
+// fit. Returns fix16_overflow if it doesn't.
+static fix16_t sum_div(sum_t sum, fix16_t divisor)
+{
+    // A sum beyond 64 bits divided by a fix16_t doesn't fit either.
+    if (!fa16_acc_fits(&sum))
+        return fix16_overflow;
+    
+    return div_round64((int64_t)sum.low, divisor);
+}
+
+#else
+
+typedef fix16_t sum_t;
+static const sum_t sum_zero = 0;
+
+static void sum_mac(sum_t *sum, fix16_t a, fix16_t b, uint8_t *errors)
+{
+    fix16_t product = fix16_mul(a, b);
+    *sum = fix16_add(*sum, product);
+    
+    if (product == fix16_overflow || *sum == fix16_overflow)
+        *errors |= FIXMATRIX_OVERFLOW;
+}
+
+static void sum_msub(sum_t *sum, fix16_t a, fix16_t b, uint8_t *errors)
+{
+    fix16_t product = fix16_mul(a, b);
+    *sum = fix16_sub(*sum, product);
+    
+    if (product == fix16_overflow || *sum == fix16_overflow)
+        *errors |= FIXMATRIX_OVERFLOW;
+}
+
+static fix16_t sum_result(sum_t sum)
+{
+    return sum;
+}
+
+static fix16_t sum_div(sum_t sum, fix16_t divisor)
+{
+    return fix16_div(sum, divisor);
+}
+
+#endif
+
+// Divides the sums by the diagonal entry of R or L and stores them
+// as a row of the result. A zero divisor gives a zero row.
+static void store_row(fix16_t *dest, const sum_t *sums, int columns,
+                      fix16_t divider, uint8_t *errors)
+{
+    int column;
+    
+    if (divider == 0)
+    {
+        *errors |= FIXMATRIX_SINGULAR;
+        for (column = 0; column < columns; column++)
+            dest[column] = 0;
+        return;
+    }
+    
+    // The sums are divided directly, so that only the quotient has to
+    // fit and it is rounded once.
+    for (column = 0; column < columns; column++)
+    {
+        fix16_t result = sum_div(sums[column], divider);
+        dest[column] = result;
+        
+        if (result == fix16_overflow)
+            *errors |= FIXMATRIX_OVERFLOW;
+    }
+}
+
 void mf16_solve(mf16 *dest, const mf16 *q, const mf16 *r, const mf16 *matrix)
 {
-    int row, column, variable;
+    int row, column, k;
+    int n = r->rows;
+    int columns = matrix->columns;
+    sum_t sums[FIXMATRIX_MAX_SIZE];
     
     if (r->columns != r->rows || r->columns != q->columns || r == dest)
     {
@@ -359,99 +652,204 @@ void mf16_solve(mf16 *dest, const mf16 *q, const mf16 *r, const mf16 *matrix)
         return;
     }
     
-    // Ax=b <=> QRx=b <=> Q'QRx=Q'b <=> Rx=Q'b
-    // Q'b is calculated directly and x is then solved row-by-row.
-    mf16_mul_at(dest, q, matrix);
+    // Rows of dest are written while q and matrix are still needed,
+    // so they must not share memory with it.
+    mf16 tmp;
+    fa16_unalias(dest, (void**)&q, (void**)&matrix, &tmp, sizeof(tmp));
+    
+    dest->errors = q->errors | matrix->errors;
+    
+    if (q->rows != matrix->rows)
+        dest->errors |= FIXMATRIX_DIMERR;
     
-    for (column = 0; column < dest->columns; column++)
+    dest->rows = n;
+    dest->columns = columns;
+    
+    // Ax=b <=> QRx=b <=> Q'QRx=Q'b <=> Rx=Q'b
+    // x is solved row-by-row from the last one, as
+    // x_i = ((Q'b)_i - sum(R_iv x_v, v > i)) / R_ii.
+    // Both sums are accumulated for all columns at once, so that
+    // each entry of Q and R is loaded only once.
+    for (row = n - 1; row >= 0; row--)
     {
-        for (row = dest->rows - 1; row >= 0; row--)
+        for (column = 0; column < columns; column++)
+            sums[column] = sum_zero;
+        
+        for (k = 0; k < q->rows; k++)
         {
-            fix16_t value = dest->data[row][column];
-            
-            // Subtract any already solved variables
-            for (variable = row + 1; variable < r->columns; variable++)
-            {
-                fix16_t multiplier = r->data[row][variable];
-                fix16_t known_value = dest->data[variable][column];
-                fix16_t product = fix16_mul(multiplier, known_value);
-                value = fix16_sub(value, product);
-                
-                if (product == fix16_overflow || value == fix16_overflow)
-                {
-                    dest->errors |= FIXMATRIX_OVERFLOW;
-                }
-            }
+            fix16_t multiplier = q->data[k][row];
+            const fix16_t *b_row = matrix->data[k];
             
-            // Now value = R_ij x_i <=> x_i = value / R_ij
-            fix16_t divider = r->data[row][row];
-            if (divider == 0)
-            {
-                dest->errors |= FIXMATRIX_SINGULAR;
-                dest->data[row][column] = 0;
+            if (multiplier == 0)
                 continue;
-            }
             
-            fix16_t result = fix16_div(value, divider);
-            dest->data[row][column] = result;
+            for (column = 0; column < columns; column++)
+                sum_mac(&sums[column], multiplier, b_row[column], &dest->errors);
+        }
+        
+        // Subtract any already solved variables
+        for (k = row + 1; k < n; k++)
+        {
+            fix16_t multiplier = r->data[row][k];
+            const fix16_t *known_row = dest->data[k];
             
-            if (result == fix16_overflow)
-            {
-                dest->errors |= FIXMATRIX_OVERFLOW;
-            }
+            for (column = 0; column < columns; column++)
+                sum_msub(&sums[column], multiplier, known_row[column], &dest->errors);
         }
+        
+        store_row(dest->data[row], sums, columns, r->data[row][row], &dest->errors);
     }
 }
 
-/**************************
- * Cholesky decomposition *
- **************************/
-
-void mf16_cholesky(mf16 *dest, const mf16 *matrix)
+// Computes b - Ax for all columns of b. The products are accumulated
+// together with b and rounded once, so the residual of a nearly correct
+// solution is exact, which is what makes the refinement converge.
+static void residual(mf16 *dest, const mf16 *matrix, const mf16 *x, const mf16 *b)
 {
-    // This is the Cholesky–Banachiewicz algorithm.
-    // Refer to http://en.wikipedia.org/wiki/Cholesky_decomposition#The_Cholesky.E2.80.93Banachiewicz_and_Cholesky.E2.80.93Crout_algorithms
-    
     int row, column, k;
-    dest->errors = matrix->errors;
+    sum_t sums[FIXMATRIX_MAX_SIZE];
     
-    if (matrix->rows != matrix->columns)
-        dest->errors |= FIXMATRIX_DIMERR;
-    
-    dest->rows = dest->columns = matrix->rows;
+    dest->rows = b->rows;
+    dest->columns = b->columns;
+    dest->errors = 0;
     
-    for (row = 0; row < dest->rows; row++)
+    for (row = 0; row < b->rows; row++)
     {
-        for (column = 0; column < dest->columns; column++)
+        for (column = 0; column < b->columns; column++)
         {
-            if (row == column)
-            {
-                // Value on the diagonal
-                // Ljj = sqrt(Ajj - sum(Ljk^2, k = 1..(j-1))
-                fix16_t value = matrix->data[row][column];
-                for (k = 0; k < column; k++)
-                {
-                    fix16_t Ljk = dest->data[row][k];
-                    Ljk = fix16_mul(Ljk, Ljk);
-                    value = fix16_sub(value, Ljk);
-                    
-                    if (value == fix16_overflow || Ljk == fix16_overflow)
-                        dest->errors |= FIXMATRIX_OVERFLOW;
-                }
+            sums[column] = sum_zero;
+            sum_mac(&sums[column], b->data[row][column], fix16_one, &dest->errors);
+        }
+        
+        for (k = 0; k < matrix->columns; k++)
+        {
+            fix16_t multiplier = matrix->data[row][k];
+            const fix16_t *x_row = x->data[k];
+            
+            if (multiplier == 0)
+                continue;
+            
+            for (column = 0; column < b->columns; column++)
+                sum_msub(&sums[column], multiplier, x_row[column], &dest->errors);
+        }
+        
+        for (column = 0; column < b->columns; column++)
+        {
+            fix16_t value = sum_result(sums[column]);
+            dest->data[row][column] = value;
+            
+            if (value == fix16_overflow)
+                dest->errors |= FIXMATRIX_OVERFLOW;
+        }
+    }
+}
+
+void mf16_solve_refined(mf16 *dest, const mf16 *matrix, const mf16 *q,
+                        const mf16 *r, const mf16 *b, int iterations)
+{
+    mf16 x, correction;
+    int row, column;
+    
+    if (matrix->rows != q->rows || matrix->columns != q->columns)
+    {
+        // Zeroes with the dimensions of the solution.
+        x.rows = r->rows;
+        x.columns = b->columns;
+        mf16_fill(&x, 0);
+        x.errors = matrix->errors | q->errors | b->errors | FIXMATRIX_DIMERR;
+        *dest = x;
+        return;
+    }
+    
+    mf16_solve(&x, q, r, b);
+    x.errors |= matrix->errors;
+    
+    while (iterations-- > 0 && !x.errors)
+    {
+        residual(&correction, matrix, &x, b);
+        
+        // An overflowing residual cannot improve the solution.
+        if (correction.errors)
+            break;
+        
+        mf16_solve(&correction, q, r, &correction);
+        
+        if (correction.errors)
+            break;
+        
+        bool changed = false;
+        for (row = 0; row < x.rows; row++)
+        {
+            for (column = 0; column < x.columns; column++)
+            {
+                fix16_t delta = correction.data[row][column];
+                
+                if (delta != 0)
+                {
+                    x.data[row][column] = fix16_add(x.data[row][column], delta);
+                    changed = true;
+                    
+                    if (x.data[row][column] == fix16_overflow)
+                        x.errors |= FIXMATRIX_OVERFLOW;
+                }
+            }
+        }
+        
+        // Converged, further corrections would be zero as well.
+        if (!changed)
+            break;
+    }
+    
+    *dest = x;
+}
+
+/**************************
+ * Cholesky decomposition *
+ **************************/
+
+// Computes the lower triangle of L. Row i of L starts at
+// l[i * FIXMATRIX_MAX_SIZE], or at l[tri_index(i, 0)] if packed is set.
+// L and matrix may share memory in the non-packed case, because each
+// entry of matrix is read before the same entry of L is written.
+static void cholesky_rows(fix16_t *l, bool packed, const mf16 *matrix, uint8_t *errors)
+{
+    // This is the Cholesky–Banachiewicz algorithm.
+    // Refer to http://en.wikipedia.org/wiki/Cholesky_decomposition#The_Cholesky.E2.80.93Banachiewicz_and_Cholesky.E2.80.93Crout_algorithms
+    
+    int row, column, k;
+    int n = matrix->rows;
+    
+    for (row = 0; row < n; row++)
+    {
+        fix16_t *Li = packed ? l + tri_index(row, 0) : l + row * FIXMATRIX_MAX_SIZE;
+        
+        for (column = 0; column <= row; column++)
+        {
+            fix16_t *Lj = packed ? l + tri_index(column, 0) : l + column * FIXMATRIX_MAX_SIZE;
+            
+            if (row == column)
+            {
+                // Value on the diagonal
+                // Ljj = sqrt(Ajj - sum(Ljk^2, k = 1..(j-1))
+                fix16_t value = matrix->data[row][column];
+                for (k = 0; k < column; k++)
+                {
+                    fix16_t Ljk = Li[k];
+                    Ljk = fix16_mul(Ljk, Ljk);
+                    value = fix16_sub(value, Ljk);
+                    
+                    if (value == fix16_overflow || Ljk == fix16_overflow)
+                        *errors |= FIXMATRIX_OVERFLOW;
+                }
                 
                 if (value < 0)
                 {
                     if (value < -65)
-                        dest->errors |= FIXMATRIX_NEGATIVE;
+                        *errors |= FIXMATRIX_NEGATIVE;
                     value = 0;
                 }
                 
-                dest->data[row][column] = fix16_sqrt(value);
-            }
-            else if (row < column)
-            {
-                // Value above diagonal
-                dest->data[row][column] = 0;
+                Li[column] = fix16_sqrt(value);
             }
             else
             {
@@ -460,25 +858,47 @@ void mf16_cholesky(mf16 *dest, const mf16 *matrix)
                 fix16_t value = matrix->data[row][column];
                 for (k = 0; k < column; k++)
                 {
-                    fix16_t Lik = dest->data[row][k];
-                    fix16_t Ljk = dest->data[column][k];
+                    fix16_t Lik = Li[k];
+                    fix16_t Ljk = Lj[k];
                     fix16_t product = fix16_mul(Lik, Ljk);
                     value = fix16_sub(value, product);
                     
                     if (value == fix16_overflow || product == fix16_overflow)
-                        dest->errors |= FIXMATRIX_OVERFLOW;
+                        *errors |= FIXMATRIX_OVERFLOW;
                 }
-                fix16_t Ljj = dest->data[column][column];
+                fix16_t Ljj = Lj[column];
                 value = fix16_div(value, Ljj);
-                dest->data[row][column] = value;
+                Li[column] = value;
                 
                 if (value == fix16_overflow)
-                    dest->errors |= FIXMATRIX_OVERFLOW;
+                    *errors |= FIXMATRIX_OVERFLOW;
             }
         }
     }
 }
 
+void mf16_cholesky(mf16 *dest, const mf16 *matrix)
+{
+    int row, column;
+    dest->errors = matrix->errors;
+    
+    if (matrix->rows != matrix->columns)
+        dest->errors |= FIXMATRIX_DIMERR;
+    
+    dest->rows = dest->columns = matrix->rows;
+    
+    cholesky_rows(&dest->data[0][0], false, matrix, &dest->errors);
+    
+    // Values above diagonal
+    for (row = 0; row < dest->rows; row++)
+    {
+        for (column = row + 1; column < dest->columns; column++)
+        {
+            dest->data[row][column] = 0;
+        }
+    }
+}
+
 
 
 /***********************************
@@ -532,3 +952,1574 @@ void mf16_invert_lt(mf16 *dest, const mf16 *matrix)
         }
     }
 }
+
+
+/*******************************
+ * Condition number estimation *
+ *******************************/
+
+// Solves T y = x or T' y = x in place, where T is the upper or lower
+// triangle of t. Returns false on overflow.
+static bool cond_solve(const mf16 *t, bool upper, bool transpose, fix16_t *x)
+{
+    // The transpose of an upper triangular matrix is lower triangular.
+    bool backward = (upper != transpose);
+    int n = t->rows;
+    int step = backward ? -1 : 1;
+    int first = backward ? n - 1 : 0;
+    int i, k;
+    uint8_t errors = 0;
+    
+    for (i = first; i >= 0 && i < n; i += step)
+    {
+        sum_t sum = sum_zero;
+        sum_mac(&sum, x[i], fix16_one, &errors);
+        
+        for (k = first; k != i; k += step)
+        {
+            fix16_t entry = transpose ? t->data[k][i] : t->data[i][k];
+            sum_msub(&sum, entry, x[k], &errors);
+        }
+        
+        x[i] = sum_div(sum, t->data[i][i]);
+        if (x[i] == fix16_overflow)
+            return false;
+    }
+    
+    return !errors;
+}
+
+// Estimate of ||T||_1 * ||T^-1 x||_1 / ||x||_1, where y = T^-1 (s x)
+// has been computed with the scale s, and norm_ratio = ||T||_1 / s.
+static fix16_t cond_ratio(const fix16_t *y, int n, fix16_t norm_ratio, fix16_t x_norm)
+{
+    fix16_t sum = 0;
+    int i;
+    
+    for (i = 0; i < n; i++)
+        sum = fix16_sadd(sum, fix16_abs(y[i]));
+    
+    if (sum == fix16_maximum)
+        return fix16_maximum;
+    
+    return fix16_smul(fix16_sdiv(sum, x_norm), norm_ratio);
+}
+
+// Hager's method as refined by Higham, see N. J. Higham, "FORTRAN codes
+// for estimating the one-norm of a real or complex matrix", 1988.
+// It maximizes ||T^-1 x||_1 over ||x||_1 = 1 by a few steps of gradient
+// ascent, each of which solves with T and T'. The right hand sides are
+// scaled by ||T||_1 / n, so that the solutions are bounded by the
+// condition number and overflow only when it does not fit in fix16_t.
+static fix16_t tri_cond(const mf16 *t, bool upper)
+{
+    fix16_t x[FIXMATRIX_MAX_SIZE], z[FIXMATRIX_MAX_SIZE];
+    int n = t->rows;
+    int i, k, iteration, previous = -1;
+    fix16_t norm = 0, scale, norm_ratio, x_norm, estimate;
+    
+    if (t->columns != n || n == 0 || (t->errors & FIXMATRIX_SINGULAR))
+        return fix16_maximum;
+    
+    for (i = 0; i < n; i++)
+    {
+        if (t->data[i][i] == 0)
+            return fix16_maximum;
+    }
+    
+    for (k = 0; k < n; k++)
+    {
+        fix16_t column_sum = 0;
+        for (i = upper ? 0 : k; i <= (upper ? k : n - 1); i++)
+            column_sum = fix16_sadd(column_sum, fix16_abs(t->data[i][k]));
+        
+        if (column_sum > norm)
+            norm = column_sum;
+    }
+    
+    // Leaves headroom for the alternating vector below.
+    scale = norm / n;
+    if (scale < 1)
+        scale = 1;
+    if (scale > fix16_maximum / 4)
+        scale = fix16_maximum / 4;
+    norm_ratio = fix16_sdiv(norm, scale);
+    
+    // Start from x = [1/n ... 1/n]
+    for (i = 0; i < n; i++)
+        x[i] = scale;
+    x_norm = fix16_from_int(n);
+    
+    for (iteration = 0; iteration < 5; iteration++)
+    {
+        fix16_t z_max = 0;
+        fix16_t z_dot_x = 0;
+        int j = 0;
+        
+        if (!cond_solve(t, upper, false, x))
+            return fix16_maximum;
+        
+        estimate = cond_ratio(x, n, norm_ratio, x_norm);
+        
+        // Gradient z = T'^-1 sign(y)
+        for (i = 0; i < n; i++)
+            z[i] = (x[i] >= 0) ? scale : -scale;
+        
+        if (!cond_solve(t, upper, true, z))
+            return fix16_maximum;
+        
+        for (i = 0; i < n; i++)
+        {
+            if (fix16_abs(z[i]) > z_max)
+            {
+                z_max = fix16_abs(z[i]);
+                j = i;
+            }
+            
+            if (previous < 0)
+                z_dot_x = fix16_sadd(z_dot_x, z[i]);
+        }
+        
+        if (previous >= 0)
+            z_dot_x = z[previous];
+        else
+            z_dot_x /= n;
+        
+        // Local maximum reached when no unit vector is better than x.
+        if (z_max <= z_dot_x || j == previous)
+            break;
+        
+        for (i = 0; i < n; i++)
+            x[i] = 0;
+        x[j] = scale;
+        x_norm = fix16_one;
+        previous = j;
+    }
+    
+    // Higham's extra test vector with alternating signs, which catches
+    // matrices for which the gradient ascent stops at a poor maximum.
+    x_norm = 0;
+    for (i = 0; i < n; i++)
+    {
+        fix16_t value = fix16_one;
+        if (n > 1)
+            value += fix16_one * i / (n - 1);
+        
+        x_norm += value;
+        x[i] = fix16_mul((i & 1) ? -value : value, scale);
+    }
+    
+    if (cond_solve(t, upper, false, x))
+    {
+        fix16_t alternative = cond_ratio(x, n, norm_ratio, x_norm);
+        if (alternative > estimate)
+            estimate = alternative;
+    }
+    
+    return estimate;
+}
+
+fix16_t mf16_cond_r(const mf16 *r)
+{
+    return tri_cond(r, true);
+}
+
+fix16_t mf16_cond_l(const mf16 *l)
+{
+    return tri_cond(l, false);
+}
+
+
+/***************************
+ * Determinant and inverse *
+ ***************************/
+
+// LU decomposition with partial pivoting, P A = L U, in place. L has a
+// unit diagonal, which is not stored, and row i of P A is row perm[i] of
+// A. The entries are computed in the Crout order, each as a sum of
+// products that is rounded once, and the entries of L are divided by the
+// pivot before the rounding. Returns the sign of the permutation, or 0
+// if a pivot is zero.
+static int lu_decomposition(mf16 *lu, uint8_t *perm)
+{
+    sum_t sums[FIXMATRIX_MAX_SIZE];
+    int n = lu->rows;
+    int sign = 1;
+    int row, column, k, m;
+    
+    for (row = 0; row < n; row++)
+        perm[row] = row;
+    
+    for (k = 0; k < n; k++)
+    {
+        // Column k below the diagonal, before the division by the pivot.
+        // The pivot is the largest of them in magnitude.
+        uint32_t max = 0;
+        int pivot = k;
+        
+        for (row = k; row < n; row++)
+        {
+            sum_t sum = sum_zero;
+            sum_mac(&sum, lu->data[row][k], fix16_one, &lu->errors);
+            for (m = 0; m < k; m++)
+                sum_msub(&sum, lu->data[row][m], lu->data[m][k], &lu->errors);
+            
+            uint32_t magnitude = fix16_abs(sum_result(sum));
+            if (magnitude > max)
+            {
+                max = magnitude;
+                pivot = row;
+            }
+            
+            sums[row] = sum;
+        }
+        
+        if (pivot != k)
+        {
+            for (column = 0; column < n; column++)
+            {
+                fix16_t tmp = lu->data[k][column];
+                lu->data[k][column] = lu->data[pivot][column];
+                lu->data[pivot][column] = tmp;
+            }
+            
+            sum_t tmp = sums[k];
+            sums[k] = sums[pivot];
+            sums[pivot] = tmp;
+            
+            uint8_t index = perm[k];
+            perm[k] = perm[pivot];
+            perm[pivot] = index;
+            
+            sign = -sign;
+        }
+        
+        fix16_t diagonal = sum_result(sums[k]);
+        lu->data[k][k] = diagonal;
+        
+        if (diagonal == 0)
+            return 0;
+        
+        if (diagonal == fix16_overflow)
+            lu->errors |= FIXMATRIX_OVERFLOW;
+        
+        for (row = k + 1; row < n; row++)
+        {
+            fix16_t value = sum_div(sums[row], diagonal);
+            lu->data[row][k] = value;
+            
+            if (value == fix16_overflow)
+                lu->errors |= FIXMATRIX_OVERFLOW;
+        }
+        
+        // Row k of U right of the diagonal.
+        for (column = k + 1; column < n; column++)
+        {
+            sum_t sum = sum_zero;
+            sum_mac(&sum, lu->data[k][column], fix16_one, &lu->errors);
+            for (m = 0; m < k; m++)
+                sum_msub(&sum, lu->data[k][m], lu->data[m][column], &lu->errors);
+            
+            fix16_t value = sum_result(sum);
+            lu->data[k][column] = value;
+            
+            if (value == fix16_overflow)
+                lu->errors |= FIXMATRIX_OVERFLOW;
+        }
+    }
+    
+    return sign;
+}
+
+#ifndef FIXMATH_NO_64BIT
+
+// Rounds magnitude * 2^shift to fix16_t, with the given sign.
+// Returns fix16_overflow if the result doesn't fit.
+static fix16_t shift_result(uint64_t magnitude, int shift, bool negative)
+{
+    if (shift >= 0)
+    {
+        if (shift > 30 || magnitude > (0x7FFFFFFFu >> shift))
+            return fix16_overflow;
+        
+        magnitude <<= shift;
+    }
+    else if (shift < -63)
+    {
+        magnitude = 0;
+    }
+    else
+    {
+        #ifndef FIXMATH_NO_ROUNDING
+        magnitude = ((magnitude >> (-shift - 1)) + 1) >> 1;
+        #else
+        magnitude >>= -shift;
+        #endif
+        
+        if (magnitude > 0x7FFFFFFF)
+            return fix16_overflow;
+    }
+    
+    return negative ? -(fix16_t)magnitude : (fix16_t)magnitude;
+}
+
+// Product of the diagonal of U. The intermediate results are kept as a
+// 31-bit mantissa and an exponent, so that only the final result has to
+// fit and the pivots are not rounded to fix16_t precision one by one.
+static fix16_t lu_determinant(const mf16 *lu, int sign)
+{
+    // The product is mantissa * 2^shift in units of fix16_t.
+    uint64_t mantissa = 1;
+    int shift = 16;
+    int k;
+    
+    for (k = 0; k < lu->rows; k++)
+    {
+        fix16_t pivot = lu->data[k][k];
+        
+        if (pivot < 0)
+            sign = -sign;
+        
+        mantissa *= (uint32_t)fix16_abs(pivot);
+        shift -= 16;
+        
+        while (mantissa >> 31)
+        {
+            mantissa >>= 1;
+            shift++;
+        }
+    }
+    
+    return shift_result(mantissa, shift, sign < 0);
+}
+
+// Determinant of a 2x2 matrix, exactly in units of 2^-32. The products
+// are at most 2^62 in magnitude, and can only reach that with both
+// factors -2^31, so the difference cannot overflow.
+static int64_t det_2x2(fix16_t a, fix16_t b, fix16_t c, fix16_t d)
+{
+    return (int64_t)a * d - (int64_t)b * c;
+}
+
+// Cofactors of a 3x3 matrix, rounded to at most 30 significant bits in
+// units of 2^(shift - 32), and the determinant computed exactly from
+// them, in units of 2^(shift - 48).
+static int64_t cofactors_3x3(int64_t cofactors[3][3], int *shift, const mf16 *matrix)
+{
+    const fix16_t (*a)[FIXMATRIX_MAX_SIZE] = matrix->data;
+    uint64_t max = 0;
+    int row, column;
+    
+    for (row = 0; row < 3; row++)
+    {
+        int r1 = (row + 1) % 3, r2 = (row + 2) % 3;
+        
+        for (column = 0; column < 3; column++)
+        {
+            int c1 = (column + 1) % 3, c2 = (column + 2) % 3;
+            int64_t value = det_2x2(a[r1][c1], a[r1][c2], a[r2][c1], a[r2][c2]);
+            uint64_t magnitude = (value < 0) ? -(uint64_t)value : (uint64_t)value;
+            
+            cofactors[row][column] = value;
+            if (magnitude > max)
+                max = magnitude;
+        }
+    }
+    
+    *shift = 0;
+    while ((max >> *shift) >= ((uint64_t)1 << 30))
+        (*shift)++;
+    
+    if (*shift > 0)
+    {
+        for (row = 0; row < 3; row++)
+        {
+            for (column = 0; column < 3; column++)
+            {
+                int64_t value = cofactors[row][column] >> (*shift - 1);
+                cofactors[row][column] = (value + 1) >> 1;
+            }
+        }
+    }
+    
+    // With the cofactors at most 2^30, the three products are below 2^61
+    // and the sum cannot overflow.
+    int64_t det = 0;
+    for (column = 0; column < 3; column++)
+        det += (int64_t)a[0][column] * cofactors[0][column];
+    
+    return det;
+}
+
+#else
+
+static fix16_t lu_determinant(const mf16 *lu, int sign)
+{
+    fix16_t product = (sign > 0) ? fix16_one : -fix16_one;
+    int k;
+    
+    for (k = 0; k < lu->rows; k++)
+    {
+        product = fix16_mul(product, lu->data[k][k]);
+        
+        if (product == fix16_overflow)
+            return fix16_overflow;
+    }
+    
+    return product;
+}
+
+#endif
+
+fix16_t mf16_det(const mf16 *matrix)
+{
+    uint8_t perm[FIXMATRIX_MAX_SIZE];
+    mf16 lu = *matrix;
+    int sign;
+    
+    if (matrix->rows != matrix->columns || matrix->errors)
+        return fix16_overflow;
+    
+    #ifndef FIXMATH_NO_64BIT
+    if (matrix->rows == 2)
+    {
+        const fix16_t (*a)[FIXMATRIX_MAX_SIZE] = matrix->data;
+        sum_t det = sum_zero;
+        uint8_t errors = 0;
+        
+        sum_mac(&det, a[0][0], a[1][1], &errors);
+        sum_msub(&det, a[0][1], a[1][0], &errors);
+        return sum_result(det);
+    }
+    
+    if (matrix->rows == 3)
+    {
+        int64_t cofactors[3][3];
+        int shift;
+        int64_t det = cofactors_3x3(cofactors, &shift, matrix);
+        uint64_t magnitude = (det < 0) ? -(uint64_t)det : (uint64_t)det;
+        return shift_result(magnitude, shift - 32, det < 0);
+    }
+    #endif
+    
+    sign = lu_decomposition(&lu, perm);
+    
+    if (sign == 0)
+        return 0;
+    
+    if (lu.errors)
+        return fix16_overflow;
+    
+    return lu_determinant(&lu, sign);
+}
+
+fix16_t mf16_logdet_spd(const mf16 *matrix)
+{
+    mf16_bfp a, l;
+    fix16_t sum = 0;
+    int k;
+    
+    if (matrix->rows != matrix->columns || matrix->errors)
+        return fix16_overflow;
+    
+    // Scaling to block floating point keeps the precision of L also for
+    // matrices with small entries, e.g. covariances.
+    mf16_bfp_from_mf16(&a, matrix);
+    mf16_bfp_cholesky(&l, &a);
+    
+    if (l.m.errors)
+        return fix16_overflow;
+    
+    for (k = 0; k < l.m.rows; k++)
+    {
+        if (l.m.data[k][k] <= 0)
+            return fix16_overflow;
+        
+        sum += fix16_log(l.m.data[k][k]);
+    }
+    
+    // log det(A) = 2 sum log(L_kk 2^e) = 2 sum log(L_kk) + 2 n e log(2).
+    // log(2) is split to 45426 + 6136 / 65536 LSB, so that the error
+    // stays below 1 LSB for the largest exponents.
+    int32_t count = 2 * l.m.rows * l.exponent;
+    return 2 * sum + count * 45426 + ((count * 6136 + 32768) >> 16);
+}
+
+void mf16_inverse(mf16 *dest, const mf16 *matrix)
+{
+    uint8_t perm[FIXMATRIX_MAX_SIZE];
+    mf16 lu = *matrix, result;
+    int n = matrix->rows;
+    int row, column, k;
+    
+    result.rows = matrix->columns;
+    result.columns = matrix->rows;
+    mf16_fill(&result, 0);
+    result.errors = matrix->errors;
+    
+    if (matrix->rows != matrix->columns)
+    {
+        result.errors |= FIXMATRIX_DIMERR;
+        *dest = result;
+        return;
+    }
+    
+    #ifndef FIXMATH_NO_64BIT
+    if (n == 2 || n == 3)
+    {
+        // Adjugate divided by the determinant. The cofactors are exact
+        // or rounded to 30 significant bits, and the determinant is exact
+        // for them, so each entry is rounded only once. In both cases the
+        // cofactors are in 2^16 times larger units than the determinant.
+        const fix16_t (*a)[FIXMATRIX_MAX_SIZE] = matrix->data;
+        int64_t cofactors[3][3];
+        int64_t det;
+        int shift;
+        
+        if (n == 2)
+        {
+            // Cofactors with the minus sign negate the determinant
+            // instead, because -(-2^31) * 2^32 would not fit.
+            det = det_2x2(a[0][0], a[0][1], a[1][0], a[1][1]);
+            cofactors[0][0] = a[1][1];
+            cofactors[0][1] = a[1][0];
+            cofactors[1][0] = a[0][1];
+            cofactors[1][1] = a[0][0];
+        }
+        else
+        {
+            det = cofactors_3x3(cofactors, &shift, matrix);
+        }
+        
+        if (det == 0)
+        {
+            result.errors |= FIXMATRIX_SINGULAR;
+            *dest = result;
+            return;
+        }
+        
+        for (row = 0; row < n; row++)
+        {
+            for (column = 0; column < n; column++)
+            {
+                int64_t divisor = (n == 2 && row != column) ? -det : det;
+                fix16_t value = div_round64(cofactors[column][row] * ((int64_t)1 << 32), divisor);
+                result.data[row][column] = value;
+                
+                if (value == fix16_overflow)
+                    result.errors |= FIXMATRIX_OVERFLOW;
+            }
+        }
+        
+        *dest = result;
+        return;
+    }
+    #endif
+    
+    lu.errors = 0;
+    if (lu_decomposition(&lu, perm) == 0)
+    {
+        result.errors |= FIXMATRIX_SINGULAR;
+        *dest = result;
+        return;
+    }
+    
+    result.errors |= lu.errors;
+    
+    // Solves L U X = P by forward substitution with the unit lower
+    // triangle, and then back substitution with the upper triangle, for
+    // all columns at once. X replaces the intermediate result row by row.
+    for (row = 0; row < n; row++)
+    {
+        for (column = 0; column < n; column++)
+        {
+            sum_t sum = sum_zero;
+            if (perm[row] == column)
+                sum_mac(&sum, fix16_one, fix16_one, &result.errors);
+            
+            for (k = 0; k < row; k++)
+                sum_msub(&sum, lu.data[row][k], result.data[k][column], &result.errors);
+            
+            fix16_t value = sum_result(sum);
+            result.data[row][column] = value;
+            
+            if (value == fix16_overflow)
+                result.errors |= FIXMATRIX_OVERFLOW;
+        }
+    }
+    
+    for (row = n - 1; row >= 0; row--)
+    {
+        for (column = 0; column < n; column++)
+        {
+            sum_t sum = sum_zero;
+            sum_mac(&sum, result.data[row][column], fix16_one, &result.errors);
+            
+            for (k = row + 1; k < n; k++)
+                sum_msub(&sum, lu.data[row][k], result.data[k][column], &result.errors);
+            
+            fix16_t value = sum_div(sum, lu.data[row][row]);
+            result.data[row][column] = value;
+            
+            if (value == fix16_overflow)
+                result.errors |= FIXMATRIX_OVERFLOW;
+        }
+    }
+    
+    *dest = result;
+}
+
+/******************************
+ * Packed triangular matrices *
+ ******************************/
+
+void mf16_tri_from_mf16(mf16_tri *dest, const mf16 *matrix, bool upper)
+{
+    int row, column;
+    
+    dest->errors = matrix->errors;
+    
+    if (matrix->rows != matrix->columns)
+        dest->errors |= FIXMATRIX_DIMERR;
+    
+    dest->size = matrix->rows;
+    dest->upper = upper;
+    
+    for (row = 0; row < dest->size; row++)
+    {
+        fix16_t *line = &dest->data[tri_index(row, 0)];
+        
+        for (column = 0; column <= row; column++)
+        {
+            line[column] = upper ? matrix->data[column][row] : matrix->data[row][column];
+        }
+    }
+}
+
+void mf16_tri_to_mf16(mf16 *dest, const mf16_tri *matrix)
+{
+    int row, column;
+    
+    dest->rows = dest->columns = matrix->size;
+    dest->errors = matrix->errors;
+    
+    for (row = 0; row < dest->rows; row++)
+    {
+        for (column = 0; column < dest->columns; column++)
+        {
+            if (matrix->upper ? (column < row) : (column > row))
+                dest->data[row][column] = 0;
+            else if (matrix->upper)
+                dest->data[row][column] = matrix->data[tri_index(column, row)];
+            else
+                dest->data[row][column] = matrix->data[tri_index(row, column)];
+        }
+    }
+}
+
+// Returns row 'row' of the triangular matrix, of which only the entries
+// on the non-zero side of the diagonal are valid. Rows of lower triangular
+// matrices are contiguous, while rows of upper triangular matrices are
+// gathered to 'line'.
+static const fix16_t *tri_row(const mf16_tri *t, int row, fix16_t *line)
+{
+    int k;
+    
+    if (!t->upper)
+        return &t->data[tri_index(row, 0)];
+    
+    for (k = row; k < t->size; k++)
+        line[k] = t->data[tri_index(k, row)];
+    
+    return line;
+}
+
+void mf16_trmul(mf16 *dest, const mf16_tri *t, const mf16 *b)
+{
+    int i, row, column;
+    int n = t->size;
+    int columns = b->columns;
+    fix16_t line[FIXMATRIX_MAX_SIZE];
+    
+    dest->errors = t->errors | b->errors;
+    
+    if (b->rows != n)
+        dest->errors |= FIXMATRIX_DIMERR;
+    
+    dest->rows = n;
+    dest->columns = columns;
+    
+    // Row i of the result depends only on rows of b on the non-zero side
+    // of i, so going towards the zeroes allows dest = b.
+    for (i = 0; i < n; i++)
+    {
+        int first, count;
+        const fix16_t *t_row;
+        
+        row = t->upper ? i : n - 1 - i;
+        t_row = tri_row(t, row, line);
+        first = t->upper ? row : 0;
+        count = t->upper ? n - row : row + 1;
+        
+        for (column = 0; column < columns; column++)
+        {
+            fix16_t value = fa16_dot(t_row + first, 1,
+                                     &b->data[first][column], FIXMATRIX_MAX_SIZE,
+                                     count);
+            dest->data[row][column] = value;
+            
+            if (value == fix16_overflow)
+                dest->errors |= FIXMATRIX_OVERFLOW;
+        }
+    }
+}
+
+void mf16_trsolve(mf16 *dest, const mf16_tri *t, const mf16 *matrix)
+{
+    int i, row, column, variable;
+    int n = t->size;
+    fix16_t line[FIXMATRIX_MAX_SIZE];
+    sum_t sums[FIXMATRIX_MAX_SIZE];
+    
+    if (dest != matrix)
+        *dest = *matrix;
+    
+    dest->errors |= t->errors;
+    
+    if (dest->rows != n)
+        dest->errors |= FIXMATRIX_DIMERR;
+    
+    dest->rows = n;
+    
+    // Forward substitution for lower, back substitution for upper
+    // triangular matrices, processing all columns for each row of t.
+    for (i = 0; i < n; i++)
+    {
+        int first, end;
+        const fix16_t *t_row;
+        
+        row = t->upper ? n - 1 - i : i;
+        t_row = tri_row(t, row, line);
+        first = t->upper ? row + 1 : 0;
+        end = t->upper ? n : row;
+        
+        for (column = 0; column < dest->columns; column++)
+        {
+            sums[column] = sum_zero;
+            sum_mac(&sums[column], fix16_one, dest->data[row][column], &dest->errors);
+        }
+        
+        // Subtract any already solved variables
+        for (variable = first; variable < end; variable++)
+        {
+            fix16_t multiplier = t_row[variable];
+            const fix16_t *known_row = dest->data[variable];
+            
+            for (column = 0; column < dest->columns; column++)
+                sum_msub(&sums[column], multiplier, known_row[column], &dest->errors);
+        }
+        
+        store_row(dest->data[row], sums, dest->columns, t_row[row], &dest->errors);
+    }
+}
+
+void mf16_tri_cholesky(mf16_tri *dest, const mf16 *matrix)
+{
+    dest->errors = matrix->errors;
+    
+    if (matrix->rows != matrix->columns)
+        dest->errors |= FIXMATRIX_DIMERR;
+    
+    dest->size = matrix->rows;
+    dest->upper = false;
+    
+    cholesky_rows(dest->data, true, matrix, &dest->errors);
+}
+
+void mf16_tri_qr_decomposition(mf16 *q, mf16_tri *r, const mf16 *matrix,
+                               int reorthogonalize)
+{
+    if (q != matrix)
+    {
+        *q = *matrix;
+    }
+    
+    r->size = q->columns;
+    r->upper = true;
+    
+    qr_gram_schmidt(q, r->data, true, reorthogonalize);
+    
+    r->errors = q->errors;
+}
+
+/**********************************
+ * UD decomposition and filtering *
+ **********************************/
+
+// Sum of a[k] * w[k] * b[k] for k = 0..n-1, where the weights are
+// w_stride apart. Returns fix16_overflow on overflow.
+static fix16_t weighted_dot(const fix16_t *a, const fix16_t *w, uint_fast8_t w_stride,
+                            const fix16_t *b, uint_fast8_t n)
+{
+    fix16_t aw[FIXMATRIX_MAX_SIZE];
+    int k;
+    
+    for (k = 0; k < n; k++)
+    {
+        aw[k] = fix16_mul(a[k], w[k * w_stride]);
+        
+        if (aw[k] == fix16_overflow)
+            return fix16_overflow;
+    }
+    
+    return fa16_dot(aw, 1, b, 1, n);
+}
+
+// Expands the unit upper triangular U of a UD matrix to a full matrix.
+static void ud_unit_upper(mf16 *dest, const mf16 *ud)
+{
+    int row, column;
+    
+    dest->rows = dest->columns = ud->rows;
+    dest->errors = ud->errors;
+    
+    for (row = 0; row < dest->rows; row++)
+    {
+        for (column = 0; column < dest->columns; column++)
+        {
+            if (column > row)
+                dest->data[row][column] = ud->data[row][column];
+            else
+                dest->data[row][column] = (row == column) ? fix16_one : 0;
+        }
+    }
+}
+
+void mf16_ud_decomposition(mf16 *dest, const mf16 *matrix)
+{
+    int row, column, k;
+    int n = matrix->rows;
+    const uint_fast8_t diagonal = FIXMATRIX_MAX_SIZE + 1;
+    
+    dest->errors = matrix->errors;
+    
+    if (matrix->rows != matrix->columns)
+        dest->errors |= FIXMATRIX_DIMERR;
+    
+    dest->rows = dest->columns = n;
+    
+    // Columns are processed from the last one, and each entry of
+    // matrix is read before the same entry of dest is written.
+    for (column = n - 1; column >= 0; column--)
+    {
+        // Dj = Pjj - sum(Dk Ujk^2, k = j+1..n-1)
+        // For the last column the sums are empty, and Dk would point
+        // outside the matrix when n is FIXMATRIX_MAX_SIZE.
+        fix16_t *Uj = &dest->data[column][column + 1];
+        const fix16_t *Dk = (column < n - 1) ? &dest->data[column + 1][column + 1] : Uj;
+        fix16_t sum = weighted_dot(Uj, Dk, diagonal, Uj, n - 1 - column);
+        fix16_t Dj = fix16_sub(matrix->data[column][column], sum);
+        fa16_divisor divisor;
+        
+        if (sum == fix16_overflow || Dj == fix16_overflow)
+            dest->errors |= FIXMATRIX_OVERFLOW;
+        
+        if (Dj < 0)
+        {
+            if (Dj < -65)
+                dest->errors |= FIXMATRIX_NEGATIVE;
+            Dj = 0;
+        }
+        
+        dest->data[column][column] = Dj;
+        fa16_divisor_init(&divisor, Dj);
+        
+        // Uij = (Pij - sum(Dk Uik Ujk, k = j+1..n-1)) / Dj
+        for (row = column - 1; row >= 0; row--)
+        {
+            fix16_t *Ui = &dest->data[row][column + 1];
+            fix16_t value;
+            
+            if (Dj == 0)
+            {
+                dest->data[row][column] = 0;
+                continue;
+            }
+            
+            sum = weighted_dot(Ui, Dk, diagonal, Uj, n - 1 - column);
+            value = fix16_sub(matrix->data[row][column], sum);
+            value = fa16_divide(value, &divisor);
+            dest->data[row][column] = value;
+            
+            if (sum == fix16_overflow || value == fix16_overflow)
+                dest->errors |= FIXMATRIX_OVERFLOW;
+        }
+    }
+    
+    // Values below diagonal
+    for (row = 0; row < n; row++)
+    {
+        for (k = 0; k < row; k++)
+        {
+            dest->data[row][k] = 0;
+        }
+    }
+}
+
+void mf16_ud_to_covariance(mf16 *dest, const mf16 *ud)
+{
+    mf16 u, ud_product;
+    int row, column;
+    
+    // P = (U D) U'
+    ud_unit_upper(&u, ud);
+    ud_product = u;
+    
+    for (row = 0; row < u.rows; row++)
+    {
+        for (column = row; column < u.columns; column++)
+        {
+            fix16_t value = fix16_mul(u.data[row][column], ud->data[column][column]);
+            ud_product.data[row][column] = value;
+            
+            if (value == fix16_overflow)
+                ud_product.errors |= FIXMATRIX_OVERFLOW;
+        }
+    }
+    
+    mf16_mul_bt(dest, &ud_product, &u);
+}
+
+void mf16_ud_predict(mf16 *dest, const mf16 *ud, const mf16 *f, const mf16 *q)
+{
+    // The rows of W = [F U, I] are orthogonalized with respect to the
+    // weights diag(D, Q), from the last row up. The weighted squared
+    // norms become the new D, and the projection coefficients the new U.
+    // W is stored as two n x n matrices wf = F U and wq = I.
+    mf16 wf, wq;
+    fix16_t d[FIXMATRIX_MAX_SIZE];
+    int row, column, k;
+    int n = ud->rows;
+    uint8_t errors;
+    
+    ud_unit_upper(&wq, ud);
+    mf16_mul(&wf, f, &wq);
+    
+    errors = wf.errors | q->errors;
+    
+    if (f->rows != n || q->rows != n || q->columns != 1)
+        errors |= FIXMATRIX_DIMERR;
+    
+    for (k = 0; k < n; k++)
+        d[k] = ud->data[k][k];
+    
+    wq.rows = wq.columns = n;
+    mf16_fill_diagonal(&wq, fix16_one);
+    
+    dest->rows = dest->columns = n;
+    
+    for (column = n - 1; column >= 0; column--)
+    {
+        fix16_t *wf_j = wf.data[column];
+        fix16_t *wq_j = wq.data[column];
+        fix16_t norm_f = weighted_dot(wf_j, d, 1, wf_j, n);
+        fix16_t norm_q = weighted_dot(wq_j, &q->data[0][0], FIXMATRIX_MAX_SIZE, wq_j, n);
+        fix16_t Dj = fix16_add(norm_f, norm_q);
+        fa16_divisor divisor;
+        
+        if (norm_f == fix16_overflow || norm_q == fix16_overflow || Dj == fix16_overflow)
+            errors |= FIXMATRIX_OVERFLOW;
+        
+        dest->data[column][column] = Dj;
+        fa16_divisor_init(&divisor, Dj);
+        
+        for (row = 0; row < column; row++)
+        {
+            fix16_t *wf_i = wf.data[row];
+            fix16_t *wq_i = wq.data[row];
+            fix16_t dot_f, dot_q, Uij;
+            
+            if (Dj <= 0)
+            {
+                dest->data[row][column] = 0;
+                continue;
+            }
+            
+            dot_f = weighted_dot(wf_i, d, 1, wf_j, n);
+            dot_q = weighted_dot(wq_i, &q->data[0][0], FIXMATRIX_MAX_SIZE, wq_j, n);
+            Uij = fa16_divide(fix16_add(dot_f, dot_q), &divisor);
+            dest->data[row][column] = Uij;
+            
+            if (dot_f == fix16_overflow || dot_q == fix16_overflow || Uij == fix16_overflow)
+                errors |= FIXMATRIX_OVERFLOW;
+            
+            // Remove the projection from row i
+            for (k = 0; k < n; k++)
+            {
+                wf_i[k] = fix16_sub(wf_i[k], fix16_mul(Uij, wf_j[k]));
+                wq_i[k] = fix16_sub(wq_i[k], fix16_mul(Uij, wq_j[k]));
+                
+                if (wf_i[k] == fix16_overflow || wq_i[k] == fix16_overflow)
+                    errors |= FIXMATRIX_OVERFLOW;
+            }
+        }
+        
+        for (row = column + 1; row < n; row++)
+            dest->data[row][column] = 0;
+    }
+    
+    dest->errors = errors;
+}
+
+void mf16_ud_update(mf16 *ud, mf16 *x, const mf16 *h, fix16_t z, fix16_t r)
+{
+    fix16_t f[FIXMATRIX_MAX_SIZE], g[FIXMATRIX_MAX_SIZE], b[FIXMATRIX_MAX_SIZE];
+    fix16_t alpha, innovation;
+    fa16_divisor divisor;
+    int i, j;
+    int n = ud->rows;
+    
+    if (h->rows != 1 || h->columns != n || x->rows != n || x->columns != 1)
+    {
+        ud->errors |= FIXMATRIX_DIMERR;
+        return;
+    }
+    
+    // f = U' h', g = D f
+    for (j = 0; j < n; j++)
+    {
+        fix16_t dot = fa16_dot(&ud->data[0][j], FIXMATRIX_MAX_SIZE, &h->data[0][0], 1, j);
+        fix16_t value = fix16_add(h->data[0][j], dot);
+        f[j] = value;
+        g[j] = fix16_mul(ud->data[j][j], value);
+        
+        if (dot == fix16_overflow || value == fix16_overflow || g[j] == fix16_overflow)
+            ud->errors |= FIXMATRIX_OVERFLOW;
+    }
+    
+    // Innovation z - h x, computed before x changes
+    {
+        fix16_t predicted = fa16_dot(&h->data[0][0], 1, &x->data[0][0], FIXMATRIX_MAX_SIZE, n);
+        innovation = fix16_sub(z, predicted);
+        
+        if (predicted == fix16_overflow)
+            innovation = fix16_overflow;
+    }
+    
+    // alpha accumulates the innovation variance r + h P h', and b the
+    // unscaled gain P h'.
+    alpha = r;
+    for (j = 0; j < n; j++)
+    {
+        fix16_t beta = alpha;
+        fix16_t variance = fix16_mul(f[j], g[j]);
+        
+        alpha = fix16_add(alpha, variance);
+        
+        if (variance == fix16_overflow || alpha == fix16_overflow)
+        {
+            ud->errors |= FIXMATRIX_OVERFLOW;
+            return;
+        }
+        
+        if (alpha <= 0)
+        {
+            // Measurement without noise in a direction without variance
+            ud->errors |= FIXMATRIX_SINGULAR;
+            return;
+        }
+        
+        // Dj = Dj beta / alpha, where beta / alpha <= 1. The ratio alone
+        // can be much below the resolution of fix16_t, when the prior
+        // variance is large compared to r.
+#ifndef FIXMATH_NO_64BIT
+        ud->data[j][j] = div_round64((int64_t)ud->data[j][j] * beta, alpha);
+#else
+        {
+            // Dj beta or beta / alpha, whichever keeps more bits
+            fix16_t product = fix16_mul(ud->data[j][j], beta);
+            fix16_t ratio = fix16_div(beta, alpha);
+            
+            if (ratio == fix16_overflow)
+                ud->errors |= FIXMATRIX_OVERFLOW;
+            
+            if (product != fix16_overflow && product > ratio)
+                ud->data[j][j] = fix16_div(product, alpha);
+            else
+                ud->data[j][j] = fix16_mul(ud->data[j][j], ratio);
+        }
+#endif
+        
+        if (ud->data[j][j] == fix16_overflow)
+            ud->errors |= FIXMATRIX_OVERFLOW;
+        
+        // Uij = Uij - fj bi / beta, where bi / beta is the gain of the
+        // measurement restricted to the first j states.
+        fa16_divisor_init(&divisor, beta);
+        
+        for (i = 0; i < j; i++)
+        {
+            fix16_t Uij = ud->data[i][j];
+            fix16_t gain = fa16_divide(b[i], &divisor);
+            ud->data[i][j] = fix16_sub(Uij, fix16_mul(f[j], gain));
+            b[i] = fix16_add(b[i], fix16_mul(g[j], Uij));
+            
+            if (gain == fix16_overflow || ud->data[i][j] == fix16_overflow || b[i] == fix16_overflow)
+                ud->errors |= FIXMATRIX_OVERFLOW;
+        }
+        
+        b[j] = g[j];
+    }
+    
+    // x = x + b / alpha (z - h x)
+    fa16_divisor_init(&divisor, alpha);
+    
+    for (i = 0; i < n; i++)
+    {
+        fix16_t gain = fa16_divide(b[i], &divisor);
+        fix16_t value = fix16_add(x->data[i][0], fix16_mul(gain, innovation));
+        x->data[i][0] = value;
+        
+        if (value == fix16_overflow || innovation == fix16_overflow)
+            x->errors |= FIXMATRIX_OVERFLOW;
+    }
+}
+
+/***********************
+ * Views into a matrix *
+ ***********************/
+
+void mf16_view_block(mf16_view *dest, mf16 *matrix,
+                     uint8_t row, uint8_t column, uint8_t rows, uint8_t columns)
+{
+    if (row > matrix->rows) row = matrix->rows;
+    if (column > matrix->columns) column = matrix->columns;
+    
+    if (rows > matrix->rows - row)
+    {
+        rows = matrix->rows - row;
+        matrix->errors |= FIXMATRIX_DIMERR;
+    }
+    
+    if (columns > matrix->columns - column)
+    {
+        columns = matrix->columns - column;
+        matrix->errors |= FIXMATRIX_DIMERR;
+    }
+    
+    dest->data = &matrix->data[row][column];
+    dest->rows = rows;
+    dest->columns = columns;
+    dest->stride = FIXMATRIX_MAX_SIZE;
+    dest->errors = &matrix->errors;
+}
+
+void mf16_view_row(mf16_view *dest, mf16 *matrix, uint8_t row)
+{
+    mf16_view_block(dest, matrix, row, 0, 1, matrix->columns);
+}
+
+void mf16_view_column(mf16_view *dest, mf16 *matrix, uint8_t column)
+{
+    mf16_view_block(dest, matrix, 0, column, matrix->rows, 1);
+}
+
+void mf16_view_diagonal(mf16_view *dest, mf16 *matrix)
+{
+    uint8_t n = matrix->rows;
+    if (matrix->columns < n) n = matrix->columns;
+    
+    // Each step down the view moves one row down and one column right.
+    dest->data = &matrix->data[0][0];
+    dest->rows = n;
+    dest->columns = 1;
+    dest->stride = FIXMATRIX_MAX_SIZE + 1;
+    dest->errors = &matrix->errors;
+}
+
+// Checks whether the memory areas covered by two views intersect.
+// This is conservative: e.g. two side-by-side blocks of the same
+// matrix are reported as overlapping.
+static bool views_overlap(const mf16_view *a, const mf16_view *b)
+{
+    const fix16_t *a_end = a->data + (a->rows - 1) * a->stride + a->columns;
+    const fix16_t *b_end = b->data + (b->rows - 1) * b->stride + b->columns;
+    return a->data < b_end && b->data < a_end;
+}
+
+// Copies the operand to tmp if it overlaps with dest.
+// If allow_same is set, an operand that is exactly the same area as
+// dest is left in place, because elementwise operations handle that.
+static void view_unalias(const mf16_view *dest, const mf16_view **operand,
+                         mf16_view *tmpview, mf16 *tmp, bool allow_same)
+{
+    const mf16_view *v = *operand;
+    int row, column;
+    
+    if (allow_same && v->data == dest->data && v->stride == dest->stride)
+        return;
+    
+    if (!views_overlap(dest, v))
+        return;
+    
+    for (row = 0; row < v->rows; row++)
+    {
+        for (column = 0; column < v->columns; column++)
+        {
+            tmp->data[row][column] = v->data[row * v->stride + column];
+        }
+    }
+    
+    tmpview->data = &tmp->data[0][0];
+    tmpview->rows = v->rows;
+    tmpview->columns = v->columns;
+    tmpview->stride = FIXMATRIX_MAX_SIZE;
+    tmpview->errors = v->errors;
+    *operand = tmpview;
+}
+
+void mf16_view_copy(mf16_view *dest, const mf16_view *matrix)
+{
+    int row, column;
+    mf16 tmp;
+    mf16_view tmpview;
+    
+    if (dest->rows != matrix->rows || dest->columns != matrix->columns)
+    {
+        *dest->errors |= FIXMATRIX_DIMERR;
+        return;
+    }
+    
+    view_unalias(dest, &matrix, &tmpview, &tmp, true);
+    *dest->errors |= *matrix->errors;
+    
+    for (row = 0; row < dest->rows; row++)
+    {
+        for (column = 0; column < dest->columns; column++)
+        {
+            dest->data[row * dest->stride + column] =
+                matrix->data[row * matrix->stride + column];
+        }
+    }
+}
+
+void mf16_view_mul(mf16_view *dest, const mf16_view *a, const mf16_view *b)
+{
+    int row, column;
+    uint8_t errors;
+    
+    if (a->columns != b->rows || dest->rows != a->rows || dest->columns != b->columns)
+    {
+        *dest->errors |= FIXMATRIX_DIMERR;
+        return;
+    }
+    
+    // Every entry of a and b is read several times, so any overlap
+    // with dest requires a temporary copy.
+    mf16 tmp_a, tmp_b;
+    mf16_view tmpview_a, tmpview_b;
+    view_unalias(dest, &a, &tmpview_a, &tmp_a, false);
+    view_unalias(dest, &b, &tmpview_b, &tmp_b, false);
+    
+    errors = *a->errors | *b->errors;
+    
+    for (row = 0; row < dest->rows; row++)
+    {
+        for (column = 0; column < dest->columns; column++)
+        {
+            fix16_t value = fa16_dot(
+                &a->data[row * a->stride], 1,
+                &b->data[column], b->stride,
+                a->columns);
+            
+            if (value == fix16_overflow)
+                errors |= FIXMATRIX_OVERFLOW;
+            
+            dest->data[row * dest->stride + column] = value;
+        }
+    }
+    
+    *dest->errors |= errors;
+}
+
+static void mf16_view_addsub(mf16_view *dest, const mf16_view *a, const mf16_view *b, uint8_t add)
+{
+    int row, column;
+    uint8_t errors;
+    
+    if (a->rows != b->rows || a->columns != b->columns ||
+        dest->rows != a->rows || dest->columns != a->columns)
+    {
+        *dest->errors |= FIXMATRIX_DIMERR;
+        return;
+    }
+    
+    mf16 tmp_a, tmp_b;
+    mf16_view tmpview_a, tmpview_b;
+    view_unalias(dest, &a, &tmpview_a, &tmp_a, true);
+    view_unalias(dest, &b, &tmpview_b, &tmp_b, true);
+    
+    errors = *a->errors | *b->errors;
+    
+    for (row = 0; row < dest->rows; row++)
+    {
+        for (column = 0; column < dest->columns; column++)
+        {
+            fix16_t va = a->data[row * a->stride + column];
+            fix16_t vb = b->data[row * b->stride + column];
+            fix16_t sum;
+            if (add)
+                sum = fix16_add(va, vb);
+            else
+                sum = fix16_sub(va, vb);
+            
+            if (sum == fix16_overflow)
+                errors |= FIXMATRIX_OVERFLOW;
+            
+            dest->data[row * dest->stride + column] = sum;
+        }
+    }
+    
+    *dest->errors |= errors;
+}
+
+void mf16_view_add(mf16_view *dest, const mf16_view *a, const mf16_view *b)
+{
+    mf16_view_addsub(dest, a, b, 1);
+}
+
+void mf16_view_sub(mf16_view *dest, const mf16_view *a, const mf16_view *b)
+{
+    mf16_view_addsub(dest, a, b, 0);
+}
+
+void mf16_view_mul_s(mf16_view *dest, const mf16_view *matrix, fix16_t scalar)
+{
+    int row, column;
+    uint8_t errors;
+    
+    if (dest->rows != matrix->rows || dest->columns != matrix->columns)
+    {
+        *dest->errors |= FIXMATRIX_DIMERR;
+        return;
+    }
+    
+    mf16 tmp;
+    mf16_view tmpview;
+    view_unalias(dest, &matrix, &tmpview, &tmp, true);
+    
+    errors = *matrix->errors;
+    
+    for (row = 0; row < dest->rows; row++)
+    {
+        for (column = 0; column < dest->columns; column++)
+        {
+            fix16_t value = fix16_mul(matrix->data[row * matrix->stride + column], scalar);
+            
+            if (value == fix16_overflow)
+                errors |= FIXMATRIX_OVERFLOW;
+            
+            dest->data[row * dest->stride + column] = value;
+        }
+    }
+    
+    *dest->errors |= errors;
+}
+
+fix16_t mf16_view_dot(const mf16_view *a, const mf16_view *b)
+{
+    uint_fast8_t a_len, a_step, b_len, b_step;
+    
+    // Row vectors step by one entry, column vectors by the stride.
+    if (a->rows == 1) { a_len = a->columns; a_step = 1; }
+    else if (a->columns == 1) { a_len = a->rows; a_step = a->stride; }
+    else return fix16_overflow;
+    
+    if (b->rows == 1) { b_len = b->columns; b_step = 1; }
+    else if (b->columns == 1) { b_len = b->rows; b_step = b->stride; }
+    else return fix16_overflow;
+    
+    if (a_len != b_len)
+        return fix16_overflow;
+    
+    return fa16_dot(a->data, a_step, b->data, b_step, a_len);
+}
+
+
+/************************
+ * Block floating point *
+ ************************/
+
+static int_fast8_t mf16_headroom(const mf16 *matrix)
+{
+    int row;
+    int_fast8_t headroom = 31;
+    
+    for (row = 0; row < matrix->rows; row++)
+    {
+        int_fast8_t h = fa16_headroom(&matrix->data[row][0], 1, matrix->columns);
+        if (h < headroom)
+            headroom = h;
+    }
+    
+    return headroom;
+}
+
+static void bfp_set_exponent(mf16_bfp *matrix, int exponent)
+{
+    if (exponent > INT8_MAX || exponent < INT8_MIN)
+    {
+        matrix->m.errors |= FIXMATRIX_OVERFLOW;
+        exponent = (exponent > 0) ? INT8_MAX : INT8_MIN;
+    }
+    
+    matrix->exponent = exponent;
+}
+
+// Shifts the entries left by shift bits, or right with rounding if
+// shift is negative, and adjusts the exponent to keep the value.
+// Left shifts must fit in the headroom.
+static void bfp_shift(mf16_bfp *matrix, int_fast8_t shift)
+{
+    int row, column;
+    
+    if (shift == 0)
+        return;
+    
+    for (row = 0; row < matrix->m.rows; row++)
+    {
+        for (column = 0; column < matrix->m.columns; column++)
+        {
+            fix16_t value = matrix->m.data[row][column];
+            
+            if (shift >= 32 || shift <= -32)
+                value = 0;
+            else if (shift > 0)
+                value = (fix16_t)((uint32_t)value << shift);
+            else
+                value = (value >> -shift) + ((value >> (-shift - 1)) & 1);
+            
+            matrix->m.data[row][column] = value;
+        }
+    }
+    
+    bfp_set_exponent(matrix, matrix->exponent - shift);
+}
+
+// Scales the entries so that the largest magnitude has the given number
+// of significant bits. Zero matrices are left unmodified.
+static void bfp_scale(mf16_bfp *matrix, int_fast8_t bits)
+{
+    int_fast8_t headroom = mf16_headroom(&matrix->m);
+    
+    if (headroom < 31)
+        bfp_shift(matrix, bits - (31 - headroom));
+}
+
+static int_fast8_t ceil_log2(uint_fast8_t n)
+{
+    int_fast8_t result = 0;
+    while ((1 << result) < n)
+        result++;
+    return result;
+}
+
+void mf16_bfp_from_mf16(mf16_bfp *dest, const mf16 *matrix)
+{
+    dest->m = *matrix;
+    dest->exponent = 0;
+    mf16_bfp_normalize(dest);
+}
+
+void mf16_bfp_to_mf16(mf16 *dest, const mf16_bfp *matrix)
+{
+    mf16_bfp tmp = *matrix;
+    
+    if (tmp.exponent > 0 && mf16_headroom(&tmp.m) < tmp.exponent)
+        tmp.m.errors |= FIXMATRIX_OVERFLOW;
+    
+    bfp_shift(&tmp, tmp.exponent);
+    *dest = tmp.m;
+}
+
+void mf16_bfp_normalize(mf16_bfp *matrix)
+{
+    bfp_scale(matrix, 30);
+}
+
+void mf16_bfp_mul(mf16_bfp *dest, const mf16_bfp *a, const mf16_bfp *b)
+{
+    // The result entries are bounded by n * max(a) * max(b), which must
+    // stay below 2^15 even if rounding adds one LSB to the maxima.
+    mf16_bfp sa = *a, sb = *b;
+    int_fast8_t bits = 14 - ceil_log2(a->m.columns);
+    int_fast8_t a_bits = bits / 2;
+    
+    bfp_scale(&sa, 16 + a_bits);
+    bfp_scale(&sb, 16 + bits - a_bits);
+    
+    mf16_mul(&dest->m, &sa.m, &sb.m);
+    bfp_set_exponent(dest, sa.exponent + sb.exponent);
+    mf16_bfp_normalize(dest);
+}
+
+static void mf16_bfp_addsub(mf16_bfp *dest, const mf16_bfp *a, const mf16_bfp *b, uint8_t add)
+{
+    // With both operands below 2^29, the sum cannot overflow.
+    mf16_bfp sa = *a, sb = *b;
+    bfp_scale(&sa, 29);
+    bfp_scale(&sb, 29);
+    
+    // Zero matrices keep their exponent, so only align to matrices
+    // that have nonzero entries.
+    if (mf16_headroom(&sb.m) == 31 || (mf16_headroom(&sa.m) < 31 && sa.exponent > sb.exponent))
+        bfp_shift(&sb, sb.exponent - sa.exponent);
+    else
+        bfp_shift(&sa, sa.exponent - sb.exponent);
+    
+    if (add)
+        mf16_add(&dest->m, &sa.m, &sb.m);
+    else
+        mf16_sub(&dest->m, &sa.m, &sb.m);
+    
+    bfp_set_exponent(dest, sa.exponent);
+    mf16_bfp_normalize(dest);
+}
+
+void mf16_bfp_add(mf16_bfp *dest, const mf16_bfp *a, const mf16_bfp *b)
+{
+    mf16_bfp_addsub(dest, a, b, 1);
+}
+
+void mf16_bfp_sub(mf16_bfp *dest, const mf16_bfp *a, const mf16_bfp *b)
+{
+    mf16_bfp_addsub(dest, a, b, 0);
+}
+
+void mf16_bfp_cholesky(mf16_bfp *dest, const mf16_bfp *matrix)
+{
+    // The exponent must be even to be halved. The 29-bit scaling leaves
+    // room for the sums in mf16_cholesky().
+    mf16_bfp tmp = *matrix;
+    bfp_scale(&tmp, 29);
+    
+    if (tmp.exponent & 1)
+        bfp_shift(&tmp, -1);
+    
+    mf16_cholesky(&dest->m, &tmp.m);
+    dest->exponent = tmp.exponent / 2;
+    mf16_bfp_normalize(dest);
+}
+
+void mf16_bfp_qr_decomposition(mf16 *q, mf16_bfp *r, const mf16_bfp *matrix,
+                               int reorthogonalize)
+{
+    // Column norms are bounded by sqrt(rows) * max(matrix),
+    // which must stay below 2^15.
+    mf16_bfp tmp = *matrix;
+    bfp_scale(&tmp, 30 - (ceil_log2(matrix->m.rows) + 1) / 2);
+    
+    mf16_qr_decomposition(q, &r->m, &tmp.m, reorthogonalize);
+    r->exponent = tmp.exponent;
+    mf16_bfp_normalize(r);
+}
@@ -77,14 +77,29 @@ void mf16_mul_at(mf16 *dest, const mf16 *at, const mf16 *b);
 // Multiply a with transpose of bt
 void mf16_mul_bt(mf16 *dest, const mf16 *a, const mf16 *bt);
 
+// Multiply with the transpose of either or both operands, as selected
+// by the flags, without computing the transpose. mf16_mul, mf16_mul_at
+// and mf16_mul_bt are the same as flags 0, FIXMATRIX_TRANSPOSE_A and
+// FIXMATRIX_TRANSPOSE_B. Square 2x2, 3x3 and 4x4 products use unrolled
+// code, with the same results.
+#define FIXMATRIX_TRANSPOSE_A 0x01
+#define FIXMATRIX_TRANSPOSE_B 0x02
+void mf16_mul_ex(mf16 *dest, const mf16 *a, const mf16 *b, uint8_t flags);
+
 // In addition and subtraction, a = dest and b = dest are allowed.
 void mf16_add(mf16 *dest, const mf16 *a, const mf16 *b);
 void mf16_sub(mf16 *dest, const mf16 *a, const mf16 *b);
 
 // Operations on a single matrix
 // matrix and dest can alias.
+// mf16_transpose only accesses the rows x columns region, and the
+// corresponding region of dest.
 void mf16_transpose(mf16 *dest, const mf16 *matrix);
 
+// Sum of the diagonal entries. Returns fix16_overflow if the sum
+// doesn't fit, the matrix is not square or it has error flags.
+fix16_t mf16_trace(const mf16 *matrix);
+
 // Operations of a matrix and a scalar
 // matrix and dest can alias.
 void mf16_mul_s(mf16 *dest, const mf16 *matrix, fix16_t scalar);
@@ -116,12 +131,27 @@ void mf16_qr_decomposition(mf16 *q, mf16 *r, const mf16 *matrix, int reorthogona
 // matrix is the b and x is stored to dest.
 // Dest can alias with matrix or q, but not with r.
 // matrix may have multiple columns, which are then solved
-// independently.
+// independently, but in a single pass over q and r.
 // If you really really want and think that it is a
 // good idea to invert matrices, you can do it by
 // passing identity matrix as 'matrix'.
 void mf16_solve(mf16 *dest, const mf16 *q, const mf16 *r, const mf16 *matrix);
 
+// Solves Ax = b like mf16_solve() and then improves the solution by
+// iterative refinement: the residual b - Ax is computed with a 64-bit
+// accumulator and rounded once, solved for a correction with the same
+// Q and R, and added to x. This is repeated at most 'iterations' times,
+// stopping early when the correction is zero.
+// One or two iterations with Q and R from mf16_qr_decomposition() with
+// reorthogonalize = 0 typically reduce the error to a few LSB, while
+// reorthogonalization is slower and leaves errors of tens or hundreds
+// of LSB for poorly conditioned A. The original matrix A must be passed
+// along with its decomposition. Dest can alias with any of the
+// inputs. With FIXMATH_NO_64BIT the residual is rounded per product, and
+// the refinement is correspondingly less effective.
+void mf16_solve_refined(mf16 *dest, const mf16 *matrix, const mf16 *q,
+                        const mf16 *r, const mf16 *b, int iterations);
+
 // Cholesky decomposition of a symmetric positive-definite matrix (matrix square root)
 //
 // Finds L so that L L' = A and L is lower triangular.
@@ -151,4 +181,214 @@ void mf16_cholesky(mf16 *dest, const mf16 *matrix);
 // Dest and matrix can alias.
 void mf16_invert_lt(mf16 *dest, const mf16 *matrix);
 
+// Estimates of the 1-norm condition number ||T||_1 ||T^-1||_1 of the
+// upper triangular R from mf16_qr_decomposition() or the lower
+// triangular L from mf16_cholesky(). Only the triangle is used.
+//
+// These take O(n^2) operations, a few triangular solves, so they can
+// be used to choose the solution method before doing the expensive
+// work, e.g. to skip mf16_solve_refined() for well conditioned systems.
+// The estimate is a lower bound that is almost always within a factor
+// of 3 of the true value.
+//
+// The relative error of a solution of A x = b is roughly the condition
+// number times the relative rounding error of b and of the
+// decomposition. For square A, cond(A) is within a factor of n of
+// cond(R). For A = L L', cond(A) is about the square of cond(L).
+//
+// Returns fix16_maximum for singular matrices, including R flagged
+// with FIXMATRIX_SINGULAR, and when the estimate does not fit. With
+// FIXMATH_NO_64BIT, intermediate overflows can give fix16_maximum
+// already for condition numbers above a few thousand.
+fix16_t mf16_cond_r(const mf16 *r);
+fix16_t mf16_cond_l(const mf16 *l);
+
+// Determinant of a square matrix. 2x2 and 3x3 matrices use the closed
+// forms with 64-bit products, and larger ones LU decomposition with
+// partial pivoting. The result is rounded once for 2x2, and has a
+// relative error of about n LSB of the pivots for larger matrices.
+// Returns fix16_overflow if the determinant doesn't fit, the matrix is
+// not square or it has error flags.
+//
+// Determinants of matrices with small entries are often too small for
+// fix16_t, e.g. 0.01 I has 1e-6, which rounds to 0. For likelihoods
+// and such use mf16_logdet_spd() instead.
+fix16_t mf16_det(const mf16 *matrix);
+
+// Natural logarithm of the determinant of a symmetric positive-definite
+// matrix, e.g. a covariance, from its Cholesky decomposition. The matrix
+// is scaled by a power of two first, so this is accurate also when the
+// determinant itself is not representable. Returns fix16_overflow if
+// the matrix is not positive-definite, not square or has error flags.
+fix16_t mf16_logdet_spd(const mf16 *matrix);
+
+// Inverse of a square matrix. 2x2 and 3x3 matrices use the adjugate
+// divided by the determinant, computed with 64-bit products so that each
+// entry is rounded once. Larger matrices, and all with FIXMATH_NO_64BIT,
+// use LU decomposition with partial pivoting.
+//
+// Sets FIXMATRIX_SINGULAR and returns zeroes for a singular matrix, and
+// FIXMATRIX_DIMERR if it is not square. Dest and matrix can alias.
+//
+// Solving with mf16_solve(), mf16_trsolve() or mf16_cholesky() is more
+// accurate and often faster than multiplying by the inverse.
+void mf16_inverse(mf16 *dest, const mf16 *matrix);
+
+// Packed triangular matrices
+//
+// A lower or upper triangular n x n matrix, of which only the n(n+1)/2
+// entries on and below (lower) or above (upper) the diagonal are stored.
+// Both kinds use the same storage: entry (i, j) of a lower triangular
+// matrix, i >= j, is at data[i * (i + 1) / 2 + j], and entry (j, i) of
+// an upper triangular matrix is at the same place. Toggling 'upper'
+// therefore transposes the matrix without moving any data.
+#define FIXMATRIX_TRI_SIZE (FIXMATRIX_MAX_SIZE * (FIXMATRIX_MAX_SIZE + 1) / 2)
+
+typedef struct {
+    uint8_t size;
+    uint8_t upper;
+    
+    // Same error flags as in mf16.
+    uint8_t errors;
+    
+    fix16_t data[FIXMATRIX_TRI_SIZE];
+} mf16_tri;
+
+// Conversions from and to square matrices. mf16_tri_from_mf16() sets
+// FIXMATRIX_DIMERR if the matrix is not square. The entries on the
+// other side of the diagonal are ignored, and filled with zeroes
+// by mf16_tri_to_mf16().
+void mf16_tri_from_mf16(mf16_tri *dest, const mf16 *matrix, bool upper);
+void mf16_tri_to_mf16(mf16 *dest, const mf16_tri *matrix);
+
+// Multiply a triangular matrix with b, skipping the known zeroes.
+// The result is the same as from mf16_mul(). Dest can alias with b.
+void mf16_trmul(mf16 *dest, const mf16_tri *t, const mf16 *b);
+
+// Solve T X = B by forward or back substitution, where B is 'matrix'.
+// For a zero diagonal entry FIXMATRIX_SINGULAR is set and the
+// corresponding row of the result is zeroed. Dest can alias with matrix.
+//
+// mf16_solve(dest, q, r, b) is equivalent to mf16_mul_at(dest, q, b)
+// followed by mf16_trsolve(dest, r, dest) with a packed r, except for
+// the rounding of Q'b.
+void mf16_trsolve(mf16 *dest, const mf16_tri *t, const mf16 *matrix);
+
+// Cholesky and QR decompositions that store L and R in packed form.
+// The results are the same as from mf16_cholesky() and
+// mf16_qr_decomposition(). In the QR decomposition q and matrix can alias.
+void mf16_tri_cholesky(mf16_tri *dest, const mf16 *matrix);
+void mf16_tri_qr_decomposition(mf16 *q, mf16_tri *r, const mf16 *matrix,
+                               int reorthogonalize);
+
+// UD decomposition and square-root Kalman filtering
+//
+// A symmetric positive semi-definite matrix P is factored as P = U D U',
+// where U is unit upper triangular and D is diagonal. Both are stored in
+// a single mf16: D on the diagonal and U above it. The unit diagonal of
+// U is implicit and the entries below the diagonal are zero.
+//
+// A covariance kept in this form cannot lose positive definiteness by
+// rounding, because D is never negative. The entries of U are of order
+// one, so D holds the range of the variances, and the updates below
+// need no matrix inversions or re-factorizations.
+
+// Factor P = U D U'. Only the upper triangle of matrix is used.
+// Negative entries of D are floored to zero, and FIXMATRIX_NEGATIVE is
+// set if they are smaller than -0.001. Dest and matrix can alias.
+void mf16_ud_decomposition(mf16 *dest, const mf16 *matrix);
+
+// Compute P = U D U' from the factors.
+void mf16_ud_to_covariance(mf16 *dest, const mf16 *ud);
+
+// Time update P = F P F' + Q, where Q is diagonal and given as n x 1
+// column of variances. Uses Thornton's modified weighted Gram-Schmidt
+// orthogonalization. Dest can alias with ud. The state is predicted
+// separately by mf16_mul(x, f, x).
+void mf16_ud_predict(mf16 *dest, const mf16 *ud, const mf16 *f, const mf16 *q);
+
+// Bierman's measurement update for a scalar measurement z = h x + v,
+// where h is a 1 x n row and v has variance r. The factors and the
+// n x 1 state x are updated in place. A vector measurement with
+// uncorrelated noise is processed one row of H at a time.
+void mf16_ud_update(mf16 *ud, mf16 *x, const mf16 *h, fix16_t z, fix16_t r);
+
+// Views into matrices
+//
+// A view refers to a rectangular region of an mf16 without copying it.
+// Entry (row, column) of the view is at data[row * stride + column].
+// Operations on views accumulate the error flags into the matrix that
+// the destination view points to, instead of replacing them.
+typedef struct {
+    fix16_t *data;
+    uint8_t rows;
+    uint8_t columns;
+    uint8_t stride;
+    uint8_t *errors;
+} mf16_view;
+
+// View of rows x columns block starting at (row, column).
+// If the block does not fit inside the matrix, it is clipped and
+// FIXMATRIX_DIMERR is set in the matrix.
+void mf16_view_block(mf16_view *dest, mf16 *matrix,
+                     uint8_t row, uint8_t column, uint8_t rows, uint8_t columns);
+
+// Single row as a 1 x columns view, or single column as a rows x 1 view.
+void mf16_view_row(mf16_view *dest, mf16 *matrix, uint8_t row);
+void mf16_view_column(mf16_view *dest, mf16 *matrix, uint8_t column);
+
+// Diagonal entries as a n x 1 view, where n = min(rows, columns).
+// Requires FIXMATRIX_MAX_SIZE < 255 because the stride is MAX_SIZE + 1.
+void mf16_view_diagonal(mf16_view *dest, mf16 *matrix);
+
+// Operations on views. The destination must already have the size of
+// the result, otherwise FIXMATRIX_DIMERR is set and dest is not modified.
+// Overlapping views are allowed, operands are copied to a temporary
+// matrix if they share memory with dest.
+void mf16_view_copy(mf16_view *dest, const mf16_view *matrix);
+void mf16_view_mul(mf16_view *dest, const mf16_view *a, const mf16_view *b);
+void mf16_view_add(mf16_view *dest, const mf16_view *a, const mf16_view *b);
+void mf16_view_sub(mf16_view *dest, const mf16_view *a, const mf16_view *b);
+void mf16_view_mul_s(mf16_view *dest, const mf16_view *matrix, fix16_t scalar);
+
+// Dot product of two views that are row or column vectors of the same
+// length. Returns fix16_overflow on overflow or if the lengths differ.
+fix16_t mf16_view_dot(const mf16_view *a, const mf16_view *b);
+
+// Block floating point
+//
+// A matrix with a shared exponent: the value of each entry is
+// m.data[row][column] * 2^exponent. The operations rescale their
+// operands so that the 16.16 arithmetic cannot overflow, and normalize
+// the result so that the largest entry has 30 significant bits. This
+// allows matrices with entries of widely different magnitude, e.g.
+// 1e-4 .. 1e4, at the cost of some extra shifting. Small entries lose
+// precision relative to the largest one.
+//
+// FIXMATRIX_OVERFLOW is set if the exponent exceeds the int8_t range.
+typedef struct {
+    mf16 m;
+    int8_t exponent;
+} mf16_bfp;
+
+// Conversions from and to plain matrices. mf16_bfp_to_mf16() sets
+// FIXMATRIX_OVERFLOW if the values don't fit in the 16.16 range.
+void mf16_bfp_from_mf16(mf16_bfp *dest, const mf16 *matrix);
+void mf16_bfp_to_mf16(mf16 *dest, const mf16_bfp *matrix);
+
+// Shift the entries so that the largest has 30 significant bits.
+void mf16_bfp_normalize(mf16_bfp *matrix);
+
+// Operations with the same semantics as the mf16 versions.
+// Dest can alias with the operands.
+void mf16_bfp_mul(mf16_bfp *dest, const mf16_bfp *a, const mf16_bfp *b);
+void mf16_bfp_add(mf16_bfp *dest, const mf16_bfp *a, const mf16_bfp *b);
+void mf16_bfp_sub(mf16_bfp *dest, const mf16_bfp *a, const mf16_bfp *b);
+void mf16_bfp_cholesky(mf16_bfp *dest, const mf16_bfp *matrix);
+
+// QR decomposition of a block floating point matrix. Q is orthogonal
+// and needs no exponent, R gets the scale of the matrix.
+void mf16_bfp_qr_decomposition(mf16 *q, mf16_bfp *r, const mf16_bfp *matrix,
+                               int reorthogonalize);
+
 #endif
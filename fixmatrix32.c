@@ -0,0 +1,410 @@
+#include "fixmatrix32.h"
+#include "fixarray.h"
+
+/*********************
+ * Scalar arithmetic *
+ *********************/
+
+static uint64_t abs64(fix32_t x)
+{
+    return (x < 0) ? -(uint64_t)x : (uint64_t)x;
+}
+
+static fix32_t apply_sign(uint64_t magnitude, bool negative)
+{
+    return negative ? (fix32_t)-magnitude : (fix32_t)magnitude;
+}
+
+fix16_t fix32_to_fix16(fix32_t value)
+{
+    fix32_t result = value >> 16;
+
+#ifndef FIXMATH_NO_ROUNDING
+    if (value & 0x8000)
+        result++;
+#endif
+
+    if (result > fix16_maximum || result < -fix16_maximum)
+        return fix16_overflow;
+    
+    return (fix16_t)result;
+}
+
+fix32_t fix32_add(fix32_t a, fix32_t b)
+{
+    fix32_t sum = (fix32_t)((uint64_t)a + (uint64_t)b);
+    
+    // Overflow can only occur if the operands have the same sign
+    if (!((a ^ b) & fix32_minimum) && ((a ^ sum) & fix32_minimum))
+        return fix32_overflow;
+    
+    return sum;
+}
+
+fix32_t fix32_sub(fix32_t a, fix32_t b)
+{
+    fix32_t diff = (fix32_t)((uint64_t)a - (uint64_t)b);
+    
+    // Overflow can only occur if the operands have different signs
+    if (((a ^ b) & fix32_minimum) && ((a ^ diff) & fix32_minimum))
+        return fix32_overflow;
+    
+    return diff;
+}
+
+fix32_t fix32_mul(fix32_t a, fix32_t b)
+{
+    // The 128-bit product is built from four 32x32-bit products,
+    // of which bits 32..95 are kept.
+    uint64_t ua = abs64(a), ub = abs64(b);
+    uint64_t al = (uint32_t)ua, ah = ua >> 32;
+    uint64_t bl = (uint32_t)ub, bh = ub >> 32;
+    
+    uint64_t ll = al * bl;
+    uint64_t lh = al * bh;
+    uint64_t hl = ah * bl;
+    uint64_t hh = ah * bh;
+    
+    uint64_t mid = (ll >> 32) + (uint32_t)lh + (uint32_t)hl;
+#ifndef FIXMATH_NO_ROUNDING
+    mid += (ll >> 31) & 1;
+#endif
+    uint64_t high = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+    
+    if (high >> 31)
+        return fix32_overflow;
+    
+    return apply_sign((high << 32) | (uint32_t)mid, (a < 0) != (b < 0));
+}
+
+fix32_t fix32_div(fix32_t a, fix32_t b)
+{
+    if (b == 0)
+        return fix32_overflow;
+    
+    uint64_t ua = abs64(a), ub = abs64(b);
+    uint64_t quotient, remainder;
+    
+    if (!(ua >> 32))
+    {
+        // Dividend fits in 64 bits after shifting
+        quotient = (ua << 32) / ub;
+        remainder = (ua << 32) % ub;
+    }
+    else
+    {
+        // Integer part first, then the fractional bits.
+        quotient = ua / ub;
+        remainder = ua % ub;
+        
+        if (quotient >> 31)
+            return fix32_overflow;
+        
+        if (!(ub >> 32))
+        {
+            // Remainder is less than 2^32, so all 32 bits at once.
+            quotient = (quotient << 32) | ((remainder << 32) / ub);
+            remainder = (remainder << 32) % ub;
+        }
+        else
+        {
+            // Remainder < ub <= 2^63, so shifting it left can't overflow.
+            int i;
+            for (i = 0; i < 32; i++)
+            {
+                remainder <<= 1;
+                quotient <<= 1;
+                if (remainder >= ub)
+                {
+                    remainder -= ub;
+                    quotient |= 1;
+                }
+            }
+        }
+    }
+
+#ifndef FIXMATH_NO_ROUNDING
+    if (remainder >= ub - remainder)
+        quotient++;
+#endif
+
+    if (quotient >> 63)
+        return fix32_overflow;
+    
+    return apply_sign(quotient, (a < 0) != (b < 0));
+}
+
+fix32_t fix32_sqrt(fix32_t value)
+{
+    // Digit-by-digit square root of value * 2^32, two radicand bits
+    // at a time. The remainder stays below 2 * root < 2^49.
+    uint64_t root = 0, remainder = 0;
+    int shift;
+    
+    if (value < 0)
+        return fix32_overflow;
+    
+    for (shift = 62; shift >= -32; shift -= 2)
+    {
+        uint64_t bits = (shift >= 0) ? ((uint64_t)value >> shift) & 3 : 0;
+        uint64_t test = (root << 2) | 1;
+        remainder = (remainder << 2) | bits;
+        root <<= 1;
+        
+        if (remainder >= test)
+        {
+            remainder -= test;
+            root |= 1;
+        }
+    }
+
+#ifndef FIXMATH_NO_ROUNDING
+    if (remainder > root)
+        root++;
+#endif
+
+    return (fix32_t)root;
+}
+
+/***************
+ * Conversions *
+ ***************/
+
+void mf32_from_mf16(mf32 *dest, const mf16 *matrix)
+{
+    int row, column;
+    
+    dest->rows = matrix->rows;
+    dest->columns = matrix->columns;
+    dest->errors = matrix->errors;
+    
+    for (row = 0; row < dest->rows; row++)
+    {
+        for (column = 0; column < dest->columns; column++)
+        {
+            dest->data[row][column] = fix32_from_fix16(matrix->data[row][column]);
+        }
+    }
+}
+
+void mf32_to_mf16(mf16 *dest, const mf32 *matrix)
+{
+    int row, column;
+    
+    dest->rows = matrix->rows;
+    dest->columns = matrix->columns;
+    dest->errors = matrix->errors;
+    
+    for (row = 0; row < dest->rows; row++)
+    {
+        for (column = 0; column < dest->columns; column++)
+        {
+            fix16_t value = fix32_to_fix16(matrix->data[row][column]);
+            dest->data[row][column] = value;
+            
+            if (value == fix16_overflow)
+                dest->errors |= FIXMATRIX_OVERFLOW;
+        }
+    }
+}
+
+/*********************************
+ * Operations between 2 matrices *
+ *********************************/
+
+// Dot product with overflow detection, returns fix32_overflow on overflow.
+static fix32_t dot32(const fix32_t *a, uint_fast8_t a_stride,
+                     const fix32_t *b, uint_fast8_t b_stride,
+                     uint_fast8_t n)
+{
+    fix32_t sum = 0;
+    
+    while (n--)
+    {
+        fix32_t product = fix32_mul(*a, *b);
+        sum = fix32_add(sum, product);
+        
+        if (product == fix32_overflow || sum == fix32_overflow)
+            return fix32_overflow;
+        
+        a += a_stride;
+        b += b_stride;
+    }
+    
+    return sum;
+}
+
+void mf32_mul(mf32 *dest, const mf32 *a, const mf32 *b)
+{
+    int row, column;
+    
+    // If dest and input matrices alias, we have to use a temp matrix.
+    mf32 tmp;
+    fa16_unalias(dest, (void**)&a, (void**)&b, &tmp, sizeof(tmp));
+    
+    dest->errors = a->errors | b->errors;
+    
+    if (a->columns != b->rows)
+        dest->errors |= FIXMATRIX_DIMERR;
+    
+    dest->rows = a->rows;
+    dest->columns = b->columns;
+    
+    for (row = 0; row < dest->rows; row++)
+    {
+        for (column = 0; column < dest->columns; column++)
+        {
+            dest->data[row][column] = dot32(
+                &a->data[row][0], 1,
+                &b->data[0][column], FIXMATRIX_MAX_SIZE,
+                a->columns);
+            
+            if (dest->data[row][column] == fix32_overflow)
+                dest->errors |= FIXMATRIX_OVERFLOW;
+        }
+    }
+}
+
+void mf32_mul_bt(mf32 *dest, const mf32 *a, const mf32 *bt)
+{
+    int row, column;
+    
+    // If dest and input matrices alias, we have to use a temp matrix.
+    mf32 tmp;
+    fa16_unalias(dest, (void**)&a, (void**)&bt, &tmp, sizeof(tmp));
+    
+    dest->errors = a->errors | bt->errors;
+    
+    if (a->columns != bt->columns)
+        dest->errors |= FIXMATRIX_DIMERR;
+    
+    dest->rows = a->rows;
+    dest->columns = bt->rows;
+    
+    for (row = 0; row < dest->rows; row++)
+    {
+        for (column = 0; column < dest->columns; column++)
+        {
+            dest->data[row][column] = dot32(
+                &a->data[row][0], 1,
+                &bt->data[column][0], 1,
+                a->columns);
+            
+            if (dest->data[row][column] == fix32_overflow)
+                dest->errors |= FIXMATRIX_OVERFLOW;
+        }
+    }
+}
+
+static void mf32_addsub(mf32 *dest, const mf32 *a, const mf32 *b, uint8_t add)
+{
+    int row, column;
+    
+    dest->errors = a->errors | b->errors;
+    if (a->columns != b->columns || a->rows != b->rows)
+        dest->errors |= FIXMATRIX_DIMERR;
+    
+    dest->rows = a->rows;
+    dest->columns = a->columns;
+    
+    for (row = 0; row < dest->rows; row++)
+    {
+        for (column = 0; column < dest->columns; column++)
+        {
+            fix32_t sum;
+            if (add)
+                sum = fix32_add(a->data[row][column], b->data[row][column]);
+            else
+                sum = fix32_sub(a->data[row][column], b->data[row][column]);
+            
+            if (sum == fix32_overflow)
+                dest->errors |= FIXMATRIX_OVERFLOW;
+            
+            dest->data[row][column] = sum;
+        }
+    }
+}
+
+void mf32_add(mf32 *dest, const mf32 *a, const mf32 *b)
+{
+    mf32_addsub(dest, a, b, 1);
+}
+
+void mf32_sub(mf32 *dest, const mf32 *a, const mf32 *b)
+{
+    mf32_addsub(dest, a, b, 0);
+}
+
+/**************************
+ * Cholesky decomposition *
+ **************************/
+
+void mf32_cholesky(mf32 *dest, const mf32 *matrix)
+{
+    // Same Cholesky–Banachiewicz algorithm as mf16_cholesky().
+    int row, column, k;
+    dest->errors = matrix->errors;
+    
+    if (matrix->rows != matrix->columns)
+        dest->errors |= FIXMATRIX_DIMERR;
+    
+    dest->rows = dest->columns = matrix->rows;
+    
+    for (row = 0; row < dest->rows; row++)
+    {
+        for (column = 0; column < dest->columns; column++)
+        {
+            if (row == column)
+            {
+                // Value on the diagonal
+                // Ljj = sqrt(Ajj - sum(Ljk^2, k = 1..(j-1))
+                fix32_t value = matrix->data[row][column];
+                for (k = 0; k < column; k++)
+                {
+                    fix32_t Ljk = dest->data[row][k];
+                    Ljk = fix32_mul(Ljk, Ljk);
+                    value = fix32_sub(value, Ljk);
+                    
+                    if (value == fix32_overflow || Ljk == fix32_overflow)
+                        dest->errors |= FIXMATRIX_OVERFLOW;
+                }
+                
+                if (value < 0)
+                {
+                    if (value < -F32(0.001))
+                        dest->errors |= FIXMATRIX_NEGATIVE;
+                    value = 0;
+                }
+                
+                dest->data[row][column] = fix32_sqrt(value);
+            }
+            else if (row < column)
+            {
+                // Value above diagonal
+                dest->data[row][column] = 0;
+            }
+            else
+            {
+                // Value below diagonal
+                // Lij = 1/Ljj (Aij - sum(Lik Ljk, k = 1..(j-1)))
+                fix32_t value = matrix->data[row][column];
+                for (k = 0; k < column; k++)
+                {
+                    fix32_t Lik = dest->data[row][k];
+                    fix32_t Ljk = dest->data[column][k];
+                    fix32_t product = fix32_mul(Lik, Ljk);
+                    value = fix32_sub(value, product);
+                    
+                    if (value == fix32_overflow || product == fix32_overflow)
+                        dest->errors |= FIXMATRIX_OVERFLOW;
+                }
+                fix32_t Ljj = dest->data[column][column];
+                value = fix32_div(value, Ljj);
+                dest->data[row][column] = value;
+                
+                if (value == fix32_overflow)
+                    dest->errors |= FIXMATRIX_OVERFLOW;
+            }
+        }
+    }
+}
@@ -0,0 +1,71 @@
+/* Matrices with 64-bit Q32.32 entries, for the steps of a computation
+ * that would overflow the 16.16 range of mf16.
+ *
+ * The fix32_t datatype has a range of about +-2.1e9 with a resolution
+ * of 2.3e-10. Arithmetic is done with 32x32-bit partial products and
+ * bitwise division, so no 128-bit integer support is needed. The
+ * operations are several times slower than the mf16 ones, so the
+ * intention is to convert only the critical matrices with
+ * mf32_from_mf16() and to convert the results back with mf32_to_mf16().
+ *
+ * The error flags are the same as for mf16.
+ * This module is not available with FIXMATH_NO_64BIT.
+ */
+
+#ifndef _FIXMATRIX32_H_
+#define _FIXMATRIX32_H_
+
+#include "fixmatrix.h"
+
+#ifdef FIXMATH_NO_64BIT
+#error fixmatrix32 requires 64-bit integer support
+#endif
+
+typedef int64_t fix32_t;
+
+#define fix32_one      ((fix32_t)1 << 32)
+#define fix32_maximum  ((fix32_t)INT64_MAX)
+#define fix32_minimum  ((fix32_t)INT64_MIN)
+#define fix32_overflow ((fix32_t)INT64_MIN)
+
+// Conversion from a floating point constant, like F16() for fix16_t.
+#define F32(x) ((fix32_t)(((x) >= 0) ? ((x) * 4294967296.0 + 0.5) : ((x) * 4294967296.0 - 0.5)))
+
+static inline fix32_t fix32_from_fix16(fix16_t value) { return (fix32_t)value * 65536; }
+
+// Rounds to nearest. Returns fix16_overflow if the value doesn't fit.
+fix16_t fix32_to_fix16(fix32_t value);
+
+// Arithmetic with rounding. All functions return fix32_overflow
+// if the result doesn't fit, and fix32_div also for division by zero.
+fix32_t fix32_add(fix32_t a, fix32_t b);
+fix32_t fix32_sub(fix32_t a, fix32_t b);
+fix32_t fix32_mul(fix32_t a, fix32_t b);
+fix32_t fix32_div(fix32_t a, fix32_t b);
+
+// Square root, returns fix32_overflow for negative values.
+fix32_t fix32_sqrt(fix32_t value);
+
+typedef struct {
+    uint8_t rows;
+    uint8_t columns;
+    
+    uint8_t errors;
+    
+    fix32_t data[FIXMATRIX_MAX_SIZE][FIXMATRIX_MAX_SIZE];
+} mf32;
+
+// Conversions between the matrix types. Entries that don't fit in
+// fix16_t are stored as fix16_overflow and FIXMATRIX_OVERFLOW is set.
+void mf32_from_mf16(mf32 *dest, const mf16 *matrix);
+void mf32_to_mf16(mf16 *dest, const mf32 *matrix);
+
+// Operations, with the same semantics and aliasing rules as the
+// corresponding mf16 functions.
+void mf32_mul(mf32 *dest, const mf32 *a, const mf32 *b);
+void mf32_mul_bt(mf32 *dest, const mf32 *a, const mf32 *bt);
+void mf32_add(mf32 *dest, const mf32 *a, const mf32 *b);
+void mf32_sub(mf32 *dest, const mf32 *a, const mf32 *b);
+void mf32_cholesky(mf32 *dest, const mf32 *matrix);
+
+#endif
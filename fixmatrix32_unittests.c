@@ -0,0 +1,153 @@
+#include <stdio.h>
+#include <math.h>
+#include "unittests.h"
+#include "fixmatrix32.h"
+
+// Reference implementations using double, accurate to about 2^-20
+// relative, which is enough to catch any real error in the 64-bit code.
+static double to_double(fix32_t x)
+{
+    return x / 4294967296.0;
+}
+
+static uint32_t random_state = 1;
+static fix32_t random_fix32(int bits)
+{
+    uint64_t value;
+    random_state = random_state * 1664525 + 1013904223;
+    value = (uint64_t)random_state << 32;
+    random_state = random_state * 1664525 + 1013904223;
+    value |= random_state;
+    return (fix32_t)value >> (64 - bits);
+}
+
+static bool close_to(fix32_t x, double expected)
+{
+    return fabs(to_double(x) - expected) <= fabs(expected) * 1e-12 + 1e-9;
+}
+
+int main()
+{
+    int status = 0;
+    
+    {
+        COMMENT("Test fix32 arithmetic");
+        TEST(fix32_mul(F32(1.5), F32(-2.25)) == F32(-3.375));
+        TEST(fix32_mul(F32(100000), F32(20000)) == F32(2000000000));
+        TEST(fix32_mul(F32(100000), F32(30000)) == fix32_overflow);
+        TEST(fix32_div(F32(1), F32(3)) == F32(1.0 / 3.0));
+        TEST(fix32_div(F32(-2e9), F32(0.5)) == fix32_overflow);
+        TEST(fix32_div(F32(1), 0) == fix32_overflow);
+        TEST(fix32_sqrt(F32(2)) == F32(1.4142135623730951));
+        TEST(fix32_sqrt(F32(1e9)) == F32(31622.776601683792));
+        TEST(fix32_sqrt(F32(-1)) == fix32_overflow);
+        TEST(fix32_add(fix32_maximum, 1) == fix32_overflow);
+        TEST(fix32_sub(fix32_minimum + 1, 2) == fix32_overflow);
+        TEST(fix32_to_fix16(F32(1.5)) == F16(1.5));
+        TEST(fix32_to_fix16(F32(40000)) == fix16_overflow);
+        TEST(fix32_to_fix16(F32(-32767.5)) == F16(-32767.5));
+        
+        int i, errors = 0;
+        for (i = 0; i < 100000; i++)
+        {
+            fix32_t a = random_fix32(24 + i % 40);
+            fix32_t b = random_fix32(24 + (i / 40) % 40);
+            double product = to_double(a) * to_double(b);
+            double quotient = to_double(a) / to_double(b);
+            
+            fix32_t p = fix32_mul(a, b);
+            if ((fabs(product) < 2.1e9 && !close_to(p, product)) ||
+                (fabs(product) > 2.2e9 && p != fix32_overflow))
+                errors++;
+            
+            fix32_t q = fix32_div(a, b);
+            if (b != 0 && fabs(quotient) < 2.1e9 && !close_to(q, quotient))
+                errors++;
+            
+            fix32_t s = fix32_sqrt(a < 0 ? -a : a);
+            if (!close_to(s, sqrt(fabs(to_double(a)))))
+                errors++;
+        }
+        TEST(errors == 0);
+    }
+    
+    {
+        COMMENT("Test conversions");
+        mf16 a = {2, 2, 0, {{F16(1.5), F16(-32767)}, {F16(32767.99), 1}}};
+        mf16 b;
+        mf32 wide;
+        
+        mf32_from_mf16(&wide, &a);
+        TEST(wide.data[0][0] == F32(1.5) && wide.data[1][1] == F32(1.0 / 65536));
+        mf32_to_mf16(&b, &wide);
+        TEST(b.errors == 0 && b.data[0][1] == F16(-32767) && b.data[1][0] == a.data[1][0]);
+        
+        wide.data[0][0] = F32(32768);
+        mf32_to_mf16(&b, &wide);
+        TEST(b.errors == FIXMATRIX_OVERFLOW && b.data[0][0] == fix16_overflow);
+    }
+    
+    {
+        COMMENT("Test covariance update beyond the mf16 range");
+        // P = F P F' + Q, where the result exceeds 32767
+        mf16 F16mat = {2, 2, 0, {{F16(1), F16(10)}, {0, F16(1)}}};
+        mf16 P16 = {2, 2, 0, {{F16(1000), F16(100)}, {F16(100), F16(500)}}};
+        mf32 F, P, Q = {2, 2, 0, {{F32(1), 0}, {0, F32(1)}}};
+        
+        mf16_mul(&P16, &F16mat, &P16);
+        mf16_mul_bt(&P16, &P16, &F16mat);
+        TEST(P16.errors & FIXMATRIX_OVERFLOW);
+        
+        P16.errors = 0;
+        P16.data[0][0] = F16(1000); P16.data[0][1] = F16(100);
+        P16.data[1][0] = F16(100); P16.data[1][1] = F16(500);
+        mf32_from_mf16(&F, &F16mat);
+        mf32_from_mf16(&P, &P16);
+        mf32_mul(&P, &F, &P);
+        mf32_mul_bt(&P, &P, &F);
+        mf32_add(&P, &P, &Q);
+        TEST(P.errors == 0);
+        TEST(P.data[0][0] == F32(53001) && P.data[0][1] == F32(5100));
+        TEST(P.data[1][0] == F32(5100) && P.data[1][1] == F32(501));
+        
+        mf32_sub(&P, &P, &Q);
+        TEST(P.data[0][0] == F32(53000) && P.data[1][1] == F32(500));
+        
+        COMMENT("Test cholesky of large matrix");
+        mf32 L, LLt;
+        mf32_cholesky(&L, &P);
+        TEST(L.errors == 0 && L.data[0][1] == 0);
+        mf32_mul_bt(&LLt, &L, &L);
+        
+        int row, column;
+        fix32_t max_delta = 0;
+        for (row = 0; row < 2; row++)
+        {
+            for (column = 0; column < 2; column++)
+            {
+                fix32_t delta = LLt.data[row][column] - P.data[row][column];
+                if (delta < 0) delta = -delta;
+                if (delta > max_delta) max_delta = delta;
+            }
+        }
+        TEST(max_delta < F32(1e-6));
+        
+        mf16 L16;
+        mf32_to_mf16(&L16, &L);
+        TEST(L16.errors == 0 && L16.data[0][0] == F16(230.2172886644));
+        
+        mf32 N = {2, 2, 0, {{F32(1), F32(2)}, {F32(2), F32(1)}}};
+        mf32_cholesky(&L, &N);
+        TEST(L.errors & FIXMATRIX_NEGATIVE);
+        
+        mf32 bad = {2, 3, 0, {{0}}};
+        mf32_mul(&L, &N, &bad);
+        mf32_mul(&L, &bad, &N);
+        TEST(L.errors & FIXMATRIX_DIMERR);
+    }
+    
+    if (status != 0)
+        fprintf(stdout, "\n\nSome tests FAILED!\n");
+    
+    return status;
+}
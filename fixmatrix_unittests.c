@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include "unittests.h"
 #include "fixmatrix.h"
+#include "fixarray.h"
 #include "fixstring.h"
 
 fix16_t max_delta(const mf16 *a, const mf16 *b)
@@ -27,6 +28,85 @@ fix16_t max_delta(const mf16 *a, const mf16 *b)
     return max;
 }
 
+// Value of a block floating point entry as double.
+double bfp_value(const mf16_bfp *m, int row, int column)
+{
+    double value = m->m.data[row][column] / 65536.0;
+    int e = m->exponent;
+    while (e > 0) { value *= 2; e--; }
+    while (e < 0) { value /= 2; e++; }
+    return value;
+}
+
+// Largest error relative to the largest expected entry.
+double bfp_error(const mf16_bfp *m, const double *expected, int rows, int columns)
+{
+    double max_error = 0, max_value = 0;
+    int i, j;
+    
+    if (m->m.rows != rows || m->m.columns != columns || m->m.errors)
+        return 1.0;
+    
+    for (i = 0; i < rows; i++)
+    {
+        for (j = 0; j < columns; j++)
+        {
+            double error = bfp_value(m, i, j) - expected[i * columns + j];
+            double value = expected[i * columns + j];
+            if (error < 0) error = -error;
+            if (value < 0) value = -value;
+            if (error > max_error) max_error = error;
+            if (value > max_value) max_value = value;
+        }
+    }
+    
+    return max_error / max_value;
+}
+
+// Kalman filter update in double precision, for checking the UD filter.
+// p is n x n row-major, h is the measurement row.
+void kalman_update_double(double *p, double *x, const double *h,
+                          double z, double r, int n)
+{
+    double ph[FIXMATRIX_MAX_SIZE];
+    double s = r, y = z;
+    int i, j;
+    
+    for (i = 0; i < n; i++)
+    {
+        for (ph[i] = 0, j = 0; j < n; j++)
+            ph[i] += p[i * n + j] * h[j];
+        s += h[i] * ph[i];
+        y -= h[i] * x[i];
+    }
+    
+    for (i = 0; i < n; i++)
+    {
+        x[i] += ph[i] / s * y;
+        for (j = 0; j < n; j++)
+            p[i * n + j] -= ph[i] * ph[j] / s;
+    }
+}
+
+// Largest absolute difference between a matrix and a double array.
+double max_delta_double(const mf16 *a, const double *expected)
+{
+    double max = 0;
+    int i, j;
+    
+    for (i = 0; i < a->rows; i++)
+    {
+        for (j = 0; j < a->columns; j++)
+        {
+            double diff = a->data[i][j] / 65536.0 - expected[i * a->columns + j];
+            if (diff < 0) diff = -diff;
+            if (diff > max) max = diff;
+        }
+    }
+    
+    return max;
+}
+
 int main()
 {
     int status = 0;
@@ -208,6 +288,72 @@ int main()
         TEST(max_delta(&r, &a) == 0);
     }
     
+    {
+        const fix16_t values[] = {0, 1, -1, 7, 0x8000, 0x10000, -0x10000, 0x12345678,
+            -0x12345678, 0x7FFFFFFF, -0x7FFFFFFF, 123456, -987654, 31, 0x3FFFFFFF};
+        const fix16_t divisors[] = {1, -1, 3, 0x10000, -0x10000, 0x4000, 12345, -98765,
+            0x7FFFFFFF, 0x00FF0000, -0x01000000, 655, 0x10001, 0x7FFF0000};
+        unsigned i, j;
+        int max_error = 0;
+        int overflow_mismatch = 0;
+        
+        COMMENT("Test fa16_divide against fix16_div");
+        for (i = 0; i < sizeof(divisors) / sizeof(divisors[0]); i++)
+        {
+            fa16_divisor divisor;
+            fa16_divisor_init(&divisor, divisors[i]);
+            
+            for (j = 0; j < sizeof(values) / sizeof(values[0]); j++)
+            {
+                fix16_t expected = fix16_div(values[j], divisors[i]);
+                fix16_t result = fa16_divide(values[j], &divisor);
+                
+                if ((expected == fix16_overflow) != (result == fix16_overflow))
+                    overflow_mismatch++;
+                else if (fix16_abs(expected - result) > max_error)
+                    max_error = fix16_abs(expected - result);
+            }
+        }
+        TEST(overflow_mismatch == 0);
+        TEST(max_error <= 1);
+        
+        fa16_divisor zero;
+        fa16_divisor_init(&zero, 0);
+        TEST(fa16_divide(fix16_one, &zero) == fix16_div(fix16_one, 0));
+    }
+    
+    {
+        fix16_t v[4] = {fix16_from_int(1), fix16_from_int(-2), fix16_from_int(3), fix16_from_int(4)};
+        fix16_t big[2] = {fix16_from_int(30000), fix16_from_int(30000)};
+        fix16_t zero[2] = {0, 0};
+        fix16_t huge[4] = {fix16_minimum, fix16_minimum, fix16_minimum, fix16_minimum};
+        fix16_t signs[4] = {fix16_minimum, -fix16_maximum, fix16_minimum, -fix16_maximum};
+        
+        COMMENT("Test fa16_dot with a sum that wraps around 64 bits");
+        TEST(fa16_dot(huge, 1, huge, 1, 4) == fix16_overflow);
+        TEST(fa16_dot(huge, 1, signs, 1, 2) == fix16_overflow);
+        TEST(fa16_dot(huge, 1, signs, 1, 0) == 0);
+        
+        COMMENT("Test fa16_norm and fa16_normalize_inplace");
+        TEST(fa16_norm(v, 1, 4) == F16(5.477226));
+        TEST(fa16_norm(big, 1, 2) == fix16_overflow);
+        
+        TEST(fa16_normalize_inplace(v, 1, 4) == F16(5.477226));
+        TEST(fix16_abs(v[0] - F16(0.182574)) < 2);
+        TEST(fix16_abs(v[1] - F16(-0.365148)) < 2);
+        TEST(fix16_abs(v[3] - F16(0.730297)) < 2);
+        
+        TEST(fa16_normalize_inplace(zero, 1, 2) == 0);
+        TEST(zero[0] == 0 && zero[1] == 0);
+        
+        COMMENT("Test fa16_rsqrt");
+        TEST(fa16_rsqrt(fix16_from_int(4)) == F16(0.5));
+        TEST(fix16_abs(fa16_rsqrt(F16(2)) - F16(0.707107)) <= 1);
+        TEST(fix16_abs(fa16_rsqrt(1) - fix16_from_int(256)) <= 1);
+        TEST(fix16_abs(fa16_rsqrt(fix16_from_int(30000)) - F16(0.0057735)) <= 1);
+        TEST(fa16_rsqrt(0) == fix16_overflow);
+    }
+    
     {
         mf16 a = {5, 1, 0,
             {{fix16_from_int(1)},
@@ -233,6 +379,143 @@ int main()
         TEST(max_delta(&r, &a) == 0);
     }
     
+    {
+        mf16 a, r;
+        int row, column, errors = 0;
+        const fix16_t sentinel = 0x12345;
+        
+        COMMENT("Test that transposition only touches the live region");
+        a.rows = a.columns = r.rows = r.columns = FIXMATRIX_MAX_SIZE;
+        mf16_fill(&a, sentinel);
+        mf16_fill(&r, sentinel);
+        a.rows = 3;
+        a.columns = 5;
+        for (row = 0; row < 3; row++)
+            for (column = 0; column < 5; column++)
+                a.data[row][column] = fix16_from_int(row * 10 + column);
+        
+        mf16_transpose(&r, &a);
+        TEST(r.rows == 5 && r.columns == 3);
+        for (row = 0; row < FIXMATRIX_MAX_SIZE; row++)
+            for (column = 0; column < FIXMATRIX_MAX_SIZE; column++)
+                if (r.data[row][column] != ((row < 5 && column < 3) ?
+                        fix16_from_int(column * 10 + row) : sentinel))
+                    errors++;
+        TEST(errors == 0);
+        
+        mf16_transpose(&a, &a);
+        TEST(a.rows == 5 && a.columns == 3);
+        for (row = 0; row < FIXMATRIX_MAX_SIZE; row++)
+            for (column = 0; column < FIXMATRIX_MAX_SIZE; column++)
+                if (row < 5 && column < 3 ? a.data[row][column] != r.data[row][column] :
+                    (row >= 3 || column >= 5) && a.data[row][column] != sentinel)
+                    errors++;
+        TEST(errors == 0);
+    }
+    
+    {
+        mf16 a = {2, 3, 0, {{F16(1), F16(2), F16(3)}, {F16(4), F16(5), F16(6)}}};
+        mf16 b = {3, 2, 0, {{F16(-1), F16(2)}, {F16(0.5), F16(1)}, {F16(3), F16(-2)}}};
+        mf16 at, bt, expected, result;
+        
+        COMMENT("Test mf16_mul_ex with lazy transposes");
+        mf16_transpose(&at, &a);
+        mf16_transpose(&bt, &b);
+        
+        mf16_mul(&expected, &a, &b);
+        mf16_mul_ex(&result, &a, &b, 0);
+        TEST(max_delta(&result, &expected) == 0);
+        mf16_mul_ex(&result, &at, &b, FIXMATRIX_TRANSPOSE_A);
+        TEST(max_delta(&result, &expected) == 0);
+        mf16_mul_ex(&result, &a, &bt, FIXMATRIX_TRANSPOSE_B);
+        TEST(max_delta(&result, &expected) == 0);
+        mf16_mul_ex(&result, &at, &bt, FIXMATRIX_TRANSPOSE_A | FIXMATRIX_TRANSPOSE_B);
+        TEST(max_delta(&result, &expected) == 0);
+        
+        mf16_mul_ex(&result, &a, &b, FIXMATRIX_TRANSPOSE_A | FIXMATRIX_TRANSPOSE_B);
+        mf16_mul(&expected, &b, &a);
+        mf16_transpose(&expected, &expected);
+        TEST(result.rows == 3 && result.columns == 3);
+        TEST(max_delta(&result, &expected) == 0);
+        
+        mf16_mul_ex(&result, &a, &b, FIXMATRIX_TRANSPOSE_B);
+        TEST(result.errors & FIXMATRIX_DIMERR);
+    }
+    
+    {
+        mf16 a, b, result;
+        uint32_t state = 1;
+        int n, flags, row, column, mismatches = 0;
+        
+        COMMENT("Test 2x2, 3x3 and 4x4 multiplication against fa16_dot");
+        for (n = 2; n <= 4; n++)
+        {
+            a.rows = a.columns = b.rows = b.columns = n;
+            a.errors = b.errors = 0;
+            
+            for (flags = 0; flags < 4; flags++)
+            {
+                // Values up to 2^(8 + flags), so that some products overflow.
+                for (row = 0; row < n; row++)
+                {
+                    for (column = 0; column < n; column++)
+                    {
+                        state = state * 1664525 + 1013904223;
+                        a.data[row][column] = (fix16_t)state >> (15 - flags * 2);
+                        state = state * 1664525 + 1013904223;
+                        b.data[row][column] = (fix16_t)state >> (15 - flags * 2);
+                    }
+                }
+                
+                mf16_mul_ex(&result, &a, &b, flags);
+                
+                uint8_t errors = 0;
+                for (row = 0; row < n; row++)
+                {
+                    for (column = 0; column < n; column++)
+                    {
+                        fix16_t expected = fa16_dot(
+                            (flags & FIXMATRIX_TRANSPOSE_A) ? &a.data[0][row] : &a.data[row][0],
+                            (flags & FIXMATRIX_TRANSPOSE_A) ? FIXMATRIX_MAX_SIZE : 1,
+                            (flags & FIXMATRIX_TRANSPOSE_B) ? &b.data[column][0] : &b.data[0][column],
+                            (flags & FIXMATRIX_TRANSPOSE_B) ? 1 : FIXMATRIX_MAX_SIZE, n);
+                        
+                        if (expected == fix16_overflow)
+                            errors = FIXMATRIX_OVERFLOW;
+                        
+                        if (result.data[row][column] != expected)
+                            mismatches++;
+                    }
+                }
+                
+                if (result.rows != n || result.columns != n || result.errors != errors)
+                    mismatches++;
+            }
+        }
+        TEST(mismatches == 0);
+        
+        COMMENT("Test 4x4 multiplication with aliasing dest = a and dest = b");
+        for (row = 0; row < 4; row++)
+        {
+            for (column = 0; column < 4; column++)
+            {
+                a.data[row][column] >>= 10;
+                b.data[row][column] >>= 10;
+            }
+        }
+        mf16_mul(&result, &a, &a);
+        mf16_mul(&a, &a, &a);
+        TEST(a.errors == result.errors && max_delta(&a, &result) == 0);
+        mf16_mul(&result, &a, &b);
+        mf16_mul(&b, &a, &b);
+        TEST(b.errors == result.errors && max_delta(&b, &result) == 0);
+        
+        COMMENT("Test overflow of the 64-bit sum in 4x4 multiplication");
+        mf16_fill(&a, fix16_maximum);
+        mf16_mul(&result, &a, &a);
+        TEST(result.errors == FIXMATRIX_OVERFLOW && result.data[0][0] == fix16_overflow);
+    }
+    
     {
         mf16 a = {3, 3, 0,
             {{fix16_from_int(1), fix16_from_int(2), fix16_from_int(3)},
@@ -434,6 +717,22 @@ int main()
         TEST(max_delta(&qtq, &identity) < 50);
     }
     
+    {
+        // The second column is 0.3 times the first, so after the
+        // projection only a few LSB of rounding noise remain.
+        mf16 a = {3, 2, 0,
+            {{F16(-1), F16(-0.3)},
+             {0, 0},
+             {F16(-4), F16(-1.2)}}};
+        mf16 q, r;
+        
+        COMMENT("Test rank-deficient QR decomp.");
+        mf16_qr_decomposition(&q, &r, &a, 0);
+        TEST(q.errors == FIXMATRIX_SINGULAR);
+        TEST(fix16_abs(q.data[0][1]) < 5 && fix16_abs(q.data[1][1]) < 5 &&
+             fix16_abs(q.data[2][1]) < 5);
+    }
+    
     {
         mf16 a = {3, 3, 0,
             {{fix16_from_int(1), fix16_from_int(2), fix16_from_int(3)},
@@ -562,6 +861,197 @@ int main()
         TEST(max_delta(&result, &identity) < 100);
     }
     
+    {
+        // Entries of A are multiples of 1/16 and those of x multiples of
+        // 16 LSB, so that b = A x is exact and x is the exact solution.
+        mf16 a = {4, 4, 0,
+            {{20 * 4096, 34 * 4096, -6 * 4096, -16 * 4096},
+             {1 * 4096, 16 * 4096, 10 * 4096, -1 * 4096},
+             {-30 * 4096, -25 * 4096, -40 * 4096, -29 * 4096},
+             {48 * 4096, -30 * 4096, 18 * 4096, 60 * 4096}}};
+        mf16 x = {4, 1, 0, {{-1465 * 16}, {1488 * 16}, {-184 * 16}, {1140 * 16}}};
+        mf16 q, r, b, plain, refined;
+        
+        mf16_mul(&b, &a, &x);
+        mf16_qr_decomposition(&q, &r, &a, 0);
+        mf16_solve(&plain, &q, &r, &b);
+        
+        COMMENT("Test mf16_solve_refined against the exact solution");
+        mf16_solve_refined(&refined, &a, &q, &r, &b, 2);
+        printf("error without refinement %d, with refinement %d\n",
+               max_delta(&plain, &x), max_delta(&refined, &x));
+        TEST(refined.errors == 0 && refined.rows == 4 && refined.columns == 1);
+        TEST(max_delta(&plain, &x) > 20);
+        
+        // R_33 is about 0.11, so the residual rounded to 1 LSB can still
+        // move x by a few LSB.
+        TEST(max_delta(&refined, &x) <= 4);
+        
+        COMMENT("Test mf16_solve_refined with zero iterations");
+        mf16_solve_refined(&refined, &a, &q, &r, &b, 0);
+        TEST(max_delta(&refined, &plain) == 0);
+        
+        COMMENT("Test mf16_solve_refined with aliasing dest = b");
+        refined = b;
+        mf16_solve_refined(&refined, &a, &q, &r, &refined, 2);
+        TEST(max_delta(&refined, &x) <= 4);
+        
+        COMMENT("Test mf16_solve_refined with error flags in A");
+        a.errors = FIXMATRIX_OVERFLOW;
+        mf16_solve_refined(&refined, &a, &q, &r, &b, 2);
+        TEST(refined.errors == FIXMATRIX_OVERFLOW);
+        a.errors = 0;
+        
+        COMMENT("Test mf16_solve_refined dimension checking");
+        a.rows = 3;
+        refined = a;
+        mf16_solve_refined(&refined, &a, &q, &r, &b, 2);
+        TEST(refined.errors & FIXMATRIX_DIMERR);
+        TEST(refined.rows == 4 && refined.columns == 1 && refined.data[0][0] == 0);
+    }
+    
+    {
+        // inv(R) = [0.5 -1; 0 2], so cond(R) = 2 * 3 = 6
+        mf16 r = {2, 2, 0, {{F16(2), F16(1)}, {F16(100), F16(0.5)}}};
+        mf16 l = {8, 8, 0, {{0}}};
+        int row, column;
+        
+        COMMENT("Test mf16_cond_r");
+        TEST(fix16_abs(mf16_cond_r(&r) - F16(6)) <= 2);
+        
+        COMMENT("Test mf16_cond_l with 1 on the diagonal and -1 below");
+        // Column 0 of inv(L) is [1 1 2 4 ... 64], so cond(L) = 8 * 128
+        for (row = 0; row < 8; row++)
+            for (column = 0; column <= row; column++)
+                l.data[row][column] = (row == column) ? fix16_one : -fix16_one;
+        TEST(fix16_abs(mf16_cond_l(&l) - F16(1024)) <= 2);
+        
+        COMMENT("Test mf16_cond_l with identity");
+        mf16_fill(&l, 0);
+        mf16_fill_diagonal(&l, F16(3));
+        TEST(mf16_cond_l(&l) == fix16_one);
+        
+        COMMENT("Test condition estimates of singular matrices");
+        l.data[5][5] = 0;
+        TEST(mf16_cond_l(&l) == fix16_maximum);
+        r.errors = FIXMATRIX_SINGULAR;
+        TEST(mf16_cond_r(&r) == fix16_maximum);
+    }
+    
+    {
+        mf16 a2 = {2, 2, 0, {{F16(4), F16(7)}, {F16(2), F16(6)}}};
+        mf16 a3 = {3, 3, 0,
+            {{F16(2), F16(-3), F16(1)},
+             {F16(2), F16(0), F16(-1)},
+             {F16(1), F16(4), F16(5)}}};
+        mf16 inv2 = {2, 2, 0, {{F16(0.6), F16(-0.7)}, {F16(-0.2), F16(0.4)}}};
+        mf16 inv3 = {3, 3, 0,
+            {{F16(4 / 49.0), F16(19 / 49.0), F16(3 / 49.0)},
+             {F16(-11 / 49.0), F16(9 / 49.0), F16(4 / 49.0)},
+             {F16(8 / 49.0), F16(-11 / 49.0), F16(6 / 49.0)}}};
+        mf16 a5 = {5, 5, 0, {{0}}}, inv5 = {5, 5, 0, {{0}}};
+        mf16 inv, small;
+        int row, column;
+        
+        // The inverse of the second difference matrix is known exactly.
+        for (row = 0; row < 5; row++)
+        {
+            a5.data[row][row] = F16(2);
+            if (row > 0)
+                a5.data[row][row - 1] = a5.data[row - 1][row] = F16(-1);
+            
+            for (column = 0; column < 5; column++)
+            {
+                int i = row + 1, j = column + 1;
+                inv5.data[row][column] = F16((i < j ? i : j) * (6 - (i > j ? i : j)) / 6.0);
+            }
+        }
+        
+        COMMENT("Test mf16_trace");
+        TEST(mf16_trace(&a3) == F16(7));
+        TEST(mf16_trace(&a5) == F16(10));
+        a2.rows = 1;
+        TEST(mf16_trace(&a2) == fix16_overflow);
+        a2.rows = 2;
+        
+        COMMENT("Test mf16_det with 2x2, 3x3 and 5x5 matrices");
+        TEST(mf16_det(&a2) == F16(10));
+        TEST(fix16_abs(mf16_det(&a3) - F16(49)) <= 16);
+        TEST(fix16_abs(mf16_det(&a5) - F16(6)) <= 2);
+        
+        COMMENT("Test the sign of mf16_det with swapped rows");
+        mf16_transpose(&small, &a3);
+        TEST(fix16_abs(mf16_det(&small) - F16(49)) <= 16);
+        for (column = 0; column < 5; column++)
+        {
+            fix16_t tmp = a5.data[0][column];
+            a5.data[0][column] = a5.data[3][column];
+            a5.data[3][column] = tmp;
+        }
+        TEST(fix16_abs(mf16_det(&a5) + F16(6)) <= 2);
+        
+        COMMENT("Test mf16_inverse with 2x2, 3x3 and 5x5 matrices");
+        mf16_inverse(&inv, &a2);
+        TEST(max_delta(&inv, &inv2) <= 1);
+        mf16_inverse(&inv, &a3);
+        TEST(max_delta(&inv, &inv3) <= 4);
+        
+        // With rows 0 and 3 swapped, columns 0 and 3 of the inverse are.
+        mf16_inverse(&inv, &a5);
+        for (row = 0; row < 5; row++)
+        {
+            fix16_t tmp = inv.data[row][0];
+            inv.data[row][0] = inv.data[row][3];
+            inv.data[row][3] = tmp;
+        }
+        TEST(max_delta(&inv, &inv5) <= 4);
+        
+        COMMENT("Test mf16_inverse with aliasing dest = matrix");
+        inv = a2;
+        mf16_inverse(&inv, &inv);
+        TEST(max_delta(&inv, &inv2) <= 1);
+        
+        COMMENT("Test mf16_det and mf16_inverse with small entries");
+        mf16_div_s(&small, &a3, F16(16));
+        mf16_mul_s(&inv3, &inv3, F16(16));
+        mf16_inverse(&inv, &small);
+        TEST(fix16_abs(mf16_det(&small) - 784) <= 1);
+        TEST(max_delta(&inv, &inv3) <= 16);
+        
+        COMMENT("Test singular and non-square matrices");
+        a3.data[2][0] = a3.data[0][0] + a3.data[1][0];
+        a3.data[2][1] = a3.data[0][1] + a3.data[1][1];
+        a3.data[2][2] = a3.data[0][2] + a3.data[1][2];
+        TEST(mf16_det(&a3) == 0);
+        mf16_inverse(&inv, &a3);
+        TEST(inv.errors == FIXMATRIX_SINGULAR && inv.data[0][0] == 0);
+        mf16_fill(&a5, 0);
+        a5.data[0][1] = F16(1);
+        mf16_inverse(&inv, &a5);
+        TEST(inv.errors == FIXMATRIX_SINGULAR && mf16_det(&a5) == 0);
+        a5.columns = 4;
+        mf16_inverse(&inv, &a5);
+        TEST(inv.errors == FIXMATRIX_DIMERR && inv.rows == 4 && inv.columns == 5);
+        TEST(mf16_det(&a5) == fix16_overflow);
+    }
+    
+    {
+        mf16 a = {2, 2, 0, {{F16(4), F16(2)}, {F16(2), F16(5)}}};
+        mf16 small = {3, 3, 0, {{64, 0, 0}, {0, 64, 0}, {0, 0, 64}}};
+        
+        COMMENT("Test mf16_logdet_spd");
+        TEST(fix16_abs(mf16_logdet_spd(&a) - F16(2.7725887)) <= 4);
+        
+        // 2^-30, not representable, but its logarithm is.
+        TEST(mf16_det(&small) == 0);
+        TEST(fix16_abs(mf16_logdet_spd(&small) - F16(-20.7944154)) <= 4);
+        
+        COMMENT("Test mf16_logdet_spd with an indefinite matrix");
+        a.data[1][1] = F16(-1);
+        a.data[0][1] = a.data[1][0] = F16(2);
+        TEST(mf16_logdet_spd(&a) == fix16_overflow);
+    }
+    
     {
         mf16 a = {3, 3, 0,
             {{fix16_from_int(66), fix16_from_int(78), fix16_from_int(90)},
@@ -619,7 +1109,463 @@ int main()
         
         TEST(max_delta(&a, &identity) < 10);
     }
+    
+    {
+        mf16 a = {3, 3, 0,
+            {{fix16_from_int(4), fix16_from_int(12), fix16_from_int(-16)},
+             {fix16_from_int(12), fix16_from_int(37), fix16_from_int(-43)},
+             {fix16_from_int(-16), fix16_from_int(-43), fix16_from_int(98)}}};
+        mf16 b = {3, 2, 0,
+            {{fix16_from_int(1), F16(0.5)},
+             {fix16_from_int(-2), F16(2.25)},
+             {fix16_from_int(3), F16(-1.75)}}};
+        mf16 l, full, expected, x;
+        mf16_tri tl, tl2;
         
+        COMMENT("Test packed triangular conversions");
+        mf16_cholesky(&l, &a);
+        mf16_tri_from_mf16(&tl, &a, false);
+        mf16_tri_to_mf16(&full, &tl);
+        TEST(full.errors == 0 && full.data[2][0] == fix16_from_int(-16) && full.data[0][2] == 0);
+        mf16_tri_from_mf16(&tl, &a, true);
+        mf16_tri_to_mf16(&full, &tl);
+        TEST(full.errors == 0 && full.data[0][2] == fix16_from_int(-16) && full.data[2][0] == 0);
+        
+        full.columns = 2;
+        mf16_tri_from_mf16(&tl, &full, false);
+        TEST(tl.errors == FIXMATRIX_DIMERR);
+        
+        COMMENT("Test packed Cholesky factorization");
+        mf16_tri_cholesky(&tl, &a);
+        mf16_tri_to_mf16(&full, &tl);
+        TEST(tl.errors == 0 && tl.size == 3 && !tl.upper);
+        TEST(max_delta(&full, &l) == 0);
+        
+        COMMENT("Test mf16_trmul against mf16_mul");
+        mf16_mul(&expected, &l, &b);
+        mf16_trmul(&x, &tl, &b);
+        TEST(max_delta(&x, &expected) == 0);
+        x = b;
+        mf16_trmul(&x, &tl, &x);
+        TEST(max_delta(&x, &expected) == 0);
+        
+        tl2 = tl;
+        tl2.upper = true;
+        mf16_transpose(&full, &l);
+        mf16_mul(&expected, &full, &b);
+        x = b;
+        mf16_trmul(&x, &tl2, &x);
+        TEST(max_delta(&x, &expected) == 0);
+        
+        COMMENT("Test mf16_trsolve with L L' x = b");
+        mf16_trsolve(&x, &tl, &b);
+        mf16_trsolve(&x, &tl2, &x);
+        mf16_mul(&expected, &a, &x);
+        TEST(max_delta(&expected, &b) < 10);
+        
+        COMMENT("Test mf16_trsolve singular detection");
+        tl.data[2] = 0;
+        mf16_trsolve(&x, &tl, &b);
+        TEST(x.errors & FIXMATRIX_SINGULAR);
+        TEST(x.data[1][0] == 0 && x.data[1][1] == 0);
+        
+        b.rows = 2;
+        mf16_trsolve(&x, &tl2, &b);
+        TEST(x.errors & FIXMATRIX_DIMERR);
+    }
+    
+    {
+        // The sum of products for x0 is 2^64 - 4, which wraps around a
+        // 64-bit accumulator to a value that looks like it fits.
+        mf16 r = {6, 6, 0, {{0}}}, q = {6, 6, 0, {{0}}};
+        mf16 b = {6, 1, 0, {{fix16_one}, {0x7FFFFFFF}, {0x7FFFFFFF}, {0x7FFFFFFF}, {0x7FFFFFFF}, {8}}};
+        mf16 x;
+        mf16_tri t;
+        int k;
+        
+        mf16_fill_diagonal(&r, fix16_one);
+        mf16_fill_diagonal(&q, fix16_one);
+        for (k = 1; k < 6; k++)
+            r.data[0][k] = 0x7FFFFFFF;
+        
+        COMMENT("Test overflow of the sums in mf16_trsolve and mf16_solve");
+        mf16_tri_from_mf16(&t, &r, true);
+        mf16_trsolve(&x, &t, &b);
+        TEST(x.errors & FIXMATRIX_OVERFLOW);
+        
+        mf16_solve(&x, &q, &r, &b);
+        TEST(x.errors & FIXMATRIX_OVERFLOW);
+    }
+    
+#ifndef FIXMATH_NO_64BIT
+    {
+        // (Q'b)_0 is about 42426, but the solution fits.
+        mf16 a = {2, 1, 0, {{fix16_one}, {fix16_one}}};
+        mf16 b = {2, 1, 0, {{F16(30000)}, {F16(30000)}}};
+        mf16 q, r, x;
+        
+        COMMENT("Test mf16_solve with an intermediate sum beyond fix16_t");
+        mf16_qr_decomposition(&q, &r, &a, 0);
+        mf16_solve(&x, &q, &r, &b);
+        TEST(x.errors == 0 && fix16_abs(x.data[0][0] - F16(30000)) <= 2);
+    }
+#endif
+    
+    {
+        mf16 a = {4, 3, 0,
+            {{fix16_from_int(1), fix16_from_int(2), fix16_from_int(3)},
+             {fix16_from_int(4), fix16_from_int(5), fix16_from_int(6)},
+             {fix16_from_int(7), fix16_from_int(8), fix16_from_int(10)},
+             {fix16_from_int(1), fix16_from_int(-1), fix16_from_int(2)}}};
+        mf16 b = {4, 1, 0,
+            {{fix16_from_int(1)}, {fix16_from_int(2)}, {fix16_from_int(3)}, {fix16_from_int(4)}}};
+        mf16 q, r, q2, r2, x, x2;
+        mf16_tri tr;
+        
+        COMMENT("Test packed QR decomposition and solving");
+        mf16_qr_decomposition(&q, &r, &a, 1);
+        q2 = a;
+        mf16_tri_qr_decomposition(&q2, &tr, &q2, 1);
+        mf16_tri_to_mf16(&r2, &tr);
+        TEST(tr.size == 3 && tr.upper);
+        TEST(max_delta(&q, &q2) == 0);
+        TEST(max_delta(&r, &r2) == 0);
+        
+        mf16_solve(&x, &q, &r, &b);
+        mf16_mul_at(&x2, &q2, &b);
+        mf16_trsolve(&x2, &tr, &x2);
+        TEST(max_delta(&x, &x2) == 0);
+    }
+    
+    {
+        mf16 p = {3, 3, 0,
+            {{F16(4), F16(2), F16(0.6)},
+             {F16(2), F16(2), F16(0.4)},
+             {F16(0.6), F16(0.4), F16(1)}}};
+        mf16 f = {3, 3, 0,
+            {{F16(1), F16(0.1), 0},
+             {0, F16(1), F16(0.1)},
+             {0, 0, F16(0.9)}}};
+        mf16 q = {3, 1, 0, {{F16(0.01)}, {F16(0.02)}, {F16(0.05)}}};
+        mf16 h = {1, 3, 0, {{F16(1), F16(0.5), 0}}};
+        mf16 x = {3, 1, 0, {{F16(1)}, {F16(-1)}, {F16(0.5)}}};
+        mf16 ud, ud2, expected, tmp;
+        double pd[9], xd[3], hd[3] = {1, 0.5, 0};
+        int i, j;
+        
+        COMMENT("Test UD decomposition");
+        mf16_ud_decomposition(&ud, &p);
+        TEST(ud.errors == 0);
+        TEST(ud.data[1][0] == 0 && ud.data[2][0] == 0 && ud.data[2][1] == 0);
+        TEST(ud.data[2][2] == F16(1));
+        mf16_ud_to_covariance(&tmp, &ud);
+        TEST(max_delta(&tmp, &p) < 10);
+        
+        ud2 = p;
+        mf16_ud_decomposition(&ud2, &ud2);
+        TEST(max_delta(&ud, &ud2) == 0);
+        
+        COMMENT("Test UD time update against F P F' + Q");
+        mf16_mul(&tmp, &f, &p);
+        mf16_mul_bt(&expected, &tmp, &f);
+        for (i = 0; i < 3; i++)
+            expected.data[i][i] += q.data[i][0];
+        
+        mf16_ud_predict(&ud, &ud, &f, &q);
+        TEST(ud.errors == 0);
+        mf16_ud_to_covariance(&tmp, &ud);
+        TEST(max_delta(&tmp, &expected) < 20);
+        
+        COMMENT("Test Bierman measurement update");
+        for (i = 0; i < 3; i++)
+        {
+            xd[i] = x.data[i][0] / 65536.0;
+            for (j = 0; j < 3; j++)
+                pd[i * 3 + j] = expected.data[i][j] / 65536.0;
+        }
+        
+        kalman_update_double(pd, xd, hd, 2.0, 0.25, 3);
+        mf16_ud_update(&ud, &x, &h, F16(2), F16(0.25));
+        mf16_ud_to_covariance(&tmp, &ud);
+        TEST(ud.errors == 0 && x.errors == 0);
+        TEST(max_delta_double(&tmp, pd) < 0.001);
+        TEST(max_delta_double(&x, xd) < 0.001);
+        
+        COMMENT("Test UD update with a small r relative to the variance");
+        {
+            mf16 ud1 = {1, 1, 0, {{F16(10000)}}}, x1 = {1, 1, 0, {{0}}};
+            mf16 h1 = {1, 1, 0, {{F16(1)}}};
+            
+            mf16_ud_update(&ud1, &x1, &h1, F16(1), F16(0.1));
+            TEST(ud1.errors == 0 && fix16_abs(ud1.data[0][0] - F16(0.099999)) <= 2);
+            
+            ud1.data[0][0] = F16(10000);
+            mf16_ud_update(&ud1, &x1, &h1, F16(1), F16(0.01));
+            TEST(ud1.errors == 0 && fix16_abs(ud1.data[0][0] - F16(0.01)) <= 2);
+        }
+        
+        COMMENT("Test UD update overflow detection");
+        {
+            mf16 ud1 = {1, 1, 0, {{F16(1000)}}}, x1 = {1, 1, 0, {{0}}};
+            mf16 h1 = {1, 1, 0, {{F16(10)}}};
+            mf16 ud2 = {2, 2, 0, {{F16(1), F16(30000)}, {0, F16(1)}}};
+            mf16 x2 = {2, 1, 0, {{0}, {0}}};
+            mf16 h2 = {1, 2, 0, {{F16(2), F16(1)}}};
+            
+            // h P h' = 100000
+            mf16_ud_update(&ud1, &x1, &h1, F16(1), F16(1));
+            TEST(ud1.errors == FIXMATRIX_OVERFLOW);
+            
+            // f = U' h' = [2, 60001]
+            mf16_ud_update(&ud2, &x2, &h2, F16(1), F16(1));
+            TEST(ud2.errors & FIXMATRIX_OVERFLOW);
+            
+            // h x = 60000, with a small gain so that only the
+            // innovation overflows
+            ud2.data[0][1] = 0;
+            ud2.errors = 0;
+            h2.data[0][0] = F16(1);
+            x2.data[0][0] = x2.data[1][0] = F16(30000);
+            mf16_ud_update(&ud2, &x2, &h2, F16(-1), F16(30000));
+            TEST(ud2.errors == 0 && (x2.errors & FIXMATRIX_OVERFLOW));
+        }
+        
+        COMMENT("Test UD decomposition of the largest matrix size");
+        {
+            mf16 big = {FIXMATRIX_MAX_SIZE, FIXMATRIX_MAX_SIZE, 0, {{0}}};
+            
+            mf16_fill_diagonal(&big, F16(2));
+            big.data[0][1] = big.data[1][0] = F16(1);
+            mf16_ud_decomposition(&tmp, &big);
+            TEST(tmp.errors == 0);
+            TEST(tmp.data[FIXMATRIX_MAX_SIZE - 1][FIXMATRIX_MAX_SIZE - 1] == F16(2));
+            TEST(tmp.data[0][1] == F16(0.5) && tmp.data[0][0] == F16(1.5));
+        }
+        
+        COMMENT("Test UD update dimension checking");
+        h.columns = 2;
+        mf16_ud_update(&ud, &x, &h, F16(2), F16(0.25));
+        TEST(ud.errors == FIXMATRIX_DIMERR);
+    }
+    
+    {
+        // Constant velocity model with a large initial uncertainty and
+        // accurate position measurements, where P - K H P loses
+        // positive definiteness in 16.16.
+        mf16 p = {2, 2, 0, {{F16(10000), 0}, {0, F16(10000)}}};
+        mf16 f = {2, 2, 0, {{F16(1), F16(0.01)}, {0, F16(1)}}};
+        mf16 q = {2, 1, 0, {{F16(0.0001)}, {F16(0.01)}}};
+        mf16 h = {1, 2, 0, {{F16(1), 0}}};
+        mf16 x = {2, 1, 0, {{0}, {0}}};
+        mf16 ud, cov;
+        double pd[4] = {10000, 0, 0, 10000}, xd[2] = {0, 0}, hd[2] = {1, 0};
+        double fd[4] = {1, 0.01, 0, 1}, qd[2] = {0.0001, 0.01};
+        int i, step;
+        bool nonnegative = true;
+        
+        COMMENT("Test UD filter with a wide range of variances");
+        mf16_ud_decomposition(&ud, &p);
+        
+        for (step = 0; step < 100; step++)
+        {
+            double z = step * 0.05;
+            double tmp[4];
+            
+            mf16_mul(&x, &f, &x);
+            mf16_ud_predict(&ud, &ud, &f, &q);
+            mf16_ud_update(&ud, &x, &h, fix16_from_dbl(z), F16(0.001));
+            
+            for (i = 0; i < 2; i++)
+                nonnegative = nonnegative && ud.data[i][i] >= 0;
+            
+            // Same in double precision
+            tmp[0] = fd[0] * xd[0] + fd[1] * xd[1];
+            xd[1] = fd[3] * xd[1];
+            xd[0] = tmp[0];
+            tmp[0] = pd[0] + 2 * fd[1] * pd[1] + fd[1] * fd[1] * pd[3] + qd[0];
+            tmp[1] = pd[1] + fd[1] * pd[3];
+            tmp[3] = pd[3] + qd[1];
+            pd[0] = tmp[0];
+            pd[1] = pd[2] = tmp[1];
+            pd[3] = tmp[3];
+            kalman_update_double(pd, xd, hd, z, 0.001, 2);
+        }
+        
+        mf16_ud_to_covariance(&cov, &ud);
+        TEST(ud.errors == 0 && x.errors == 0);
+        TEST(nonnegative);
+        TEST(max_delta_double(&x, xd) < 0.01);
+        TEST(cov.data[0][0] > 0 && max_delta_double(&cov, pd) < 0.005);
+        
+        // The plain 16.16 update ends up at about 0.08 here.
+        TEST(cov.data[1][1] / 65536.0 > pd[3] * 0.95 && cov.data[1][1] / 65536.0 < pd[3] * 1.05);
+    }
+    
+    {
+        mf16 a = {4, 4, 0,
+            {{fix16_from_int(1), fix16_from_int(2), fix16_from_int(3), fix16_from_int(4)},
+             {fix16_from_int(5), fix16_from_int(6), fix16_from_int(7), fix16_from_int(8)},
+             {fix16_from_int(9), fix16_from_int(10), fix16_from_int(11), fix16_from_int(12)},
+             {fix16_from_int(13), fix16_from_int(14), fix16_from_int(15), fix16_from_int(16)}}};
+        mf16 b = a;
+        mf16 r = {2, 2, 0, {{0}}};
+        mf16_view va, vb, vr;
+        
+        COMMENT("Test multiplication of 2x2 blocks through views");
+        mf16_view_block(&va, &a, 0, 0, 2, 2);
+        mf16_view_block(&vb, &a, 2, 2, 2, 2);
+        mf16_view_block(&vr, &r, 0, 0, 2, 2);
+        mf16_view_mul(&vr, &va, &vb);
+        TEST(r.errors == 0);
+        TEST(r.data[0][0] == fix16_from_int(1 * 11 + 2 * 15));
+        TEST(r.data[0][1] == fix16_from_int(1 * 12 + 2 * 16));
+        TEST(r.data[1][0] == fix16_from_int(5 * 11 + 6 * 15));
+        TEST(r.data[1][1] == fix16_from_int(5 * 12 + 6 * 16));
+        
+        COMMENT("Test view multiplication with overlapping dest");
+        mf16_view_block(&vr, &b, 1, 1, 2, 2);
+        mf16_view_block(&va, &b, 0, 0, 2, 2);
+        mf16_view_block(&vb, &b, 1, 1, 2, 2);
+        mf16_view_mul(&vr, &va, &vb);
+        TEST(b.errors == 0);
+        TEST(b.data[1][1] == fix16_from_int(1 * 6 + 2 * 10));
+        TEST(b.data[1][2] == fix16_from_int(1 * 7 + 2 * 11));
+        TEST(b.data[2][1] == fix16_from_int(5 * 6 + 6 * 10));
+        TEST(b.data[2][2] == fix16_from_int(5 * 7 + 6 * 11));
+        TEST(b.data[0][0] == fix16_from_int(1) && b.data[3][3] == fix16_from_int(16));
+        
+        COMMENT("Test row, column and diagonal views");
+        mf16_view_row(&va, &a, 1);
+        mf16_view_column(&vb, &a, 2);
+        TEST(va.rows == 1 && va.columns == 4);
+        TEST(vb.rows == 4 && vb.columns == 1);
+        TEST(mf16_view_dot(&va, &vb) == fix16_from_int(5 * 3 + 6 * 7 + 7 * 11 + 8 * 15));
+        
+        b = a;
+        mf16_view_diagonal(&va, &b);
+        mf16_view_mul_s(&va, &va, fix16_from_int(-1));
+        TEST(b.data[0][0] == fix16_from_int(-1));
+        TEST(b.data[2][2] == fix16_from_int(-11));
+        TEST(b.data[3][3] == fix16_from_int(-16));
+        TEST(b.data[0][1] == fix16_from_int(2));
+        
+        mf16_view_add(&va, &va, &vb);
+        TEST(b.data[1][1] == fix16_from_int(-6 + 7));
+        
+        COMMENT("Test view dimension checking");
+        mf16_view_block(&va, &b, 3, 3, 2, 2);
+        TEST(b.errors == FIXMATRIX_DIMERR);
+        TEST(va.rows == 1 && va.columns == 1);
+        
+        r.errors = 0;
+        mf16_view_block(&vr, &r, 0, 0, 2, 2);
+        mf16_view_row(&va, &a, 0);
+        mf16_view_add(&vr, &vr, &va);
+        TEST(r.errors == FIXMATRIX_DIMERR);
+        TEST(r.data[0][0] == fix16_from_int(1 * 11 + 2 * 15));
+    }
+        
+    {
+        COMMENT("Test block floating point conversions");
+        mf16 a = {2, 2, 0, {{F16(100), F16(0.01)}, {F16(-0.01), F16(200)}}};
+        mf16 c;
+        mf16_bfp ba, bb;
+        
+        mf16_bfp_from_mf16(&ba, &a);
+        TEST(ba.exponent == -6);
+        TEST(ba.m.data[1][1] == F16(200) << 6);
+        mf16_bfp_to_mf16(&c, &ba);
+        TEST(max_delta(&c, &a) == 0);
+        
+        COMMENT("Test block floating point multiplication");
+        // A^4 has entries of 1.6e9, far beyond the 16.16 range.
+        double a2[4], a4[4];
+        int i, j, k;
+        for (i = 0; i < 2; i++)
+            for (j = 0; j < 2; j++)
+                for (a2[i * 2 + j] = 0, k = 0; k < 2; k++)
+                    a2[i * 2 + j] += a.data[i][k] / 65536.0 * (a.data[k][j] / 65536.0);
+        for (i = 0; i < 2; i++)
+            for (j = 0; j < 2; j++)
+                for (a4[i * 2 + j] = 0, k = 0; k < 2; k++)
+                    a4[i * 2 + j] += a2[i * 2 + k] * a2[k * 2 + j];
+        
+        mf16_bfp_mul(&bb, &ba, &ba);
+        TEST(bfp_error(&bb, a2, 2, 2) < 1e-6);
+        mf16_bfp_mul(&bb, &bb, &bb);
+        TEST(bfp_error(&bb, a4, 2, 2) < 1e-5);
+        TEST(bfp_value(&bb, 0, 1) > 0 && bfp_value(&bb, 1, 0) < 0);
+        mf16_bfp_to_mf16(&c, &bb);
+        TEST(c.errors & FIXMATRIX_OVERFLOW);
+        
+        // Products of small values would underflow to zero in 16.16.
+        mf16 s = {2, 2, 0, {{F16(0.001), F16(0.002)}, {F16(-0.003), F16(0.004)}}};
+        mf16_bfp bs;
+        mf16_mul(&c, &s, &s);
+        TEST(c.data[0][0] == 0);
+        mf16_bfp_from_mf16(&bs, &s);
+        mf16_bfp_mul(&bs, &bs, &bs);
+        double s2[4] = {
+            (s.data[0][0] / 65536.0) * (s.data[0][0] / 65536.0) + (s.data[0][1] / 65536.0) * (s.data[1][0] / 65536.0),
+            (s.data[0][0] / 65536.0) * (s.data[0][1] / 65536.0) + (s.data[0][1] / 65536.0) * (s.data[1][1] / 65536.0),
+            (s.data[1][0] / 65536.0) * (s.data[0][0] / 65536.0) + (s.data[1][1] / 65536.0) * (s.data[1][0] / 65536.0),
+            (s.data[1][0] / 65536.0) * (s.data[0][1] / 65536.0) + (s.data[1][1] / 65536.0) * (s.data[1][1] / 65536.0)
+        };
+        TEST(bfp_error(&bs, s2, 2, 2) < 1e-6);
+        
+        COMMENT("Test block floating point addition");
+        mf16_bfp_from_mf16(&ba, &a);
+        mf16_bfp_add(&bb, &bb, &ba);
+        double sum[4] = {a4[0] + a.data[0][0] / 65536.0, a4[1] + a.data[0][1] / 65536.0,
+                         a4[2] + a.data[1][0] / 65536.0, a4[3] + a.data[1][1] / 65536.0};
+        TEST(bfp_error(&bb, sum, 2, 2) < 1e-5);
+        
+        mf16_bfp_sub(&bb, &ba, &ba);
+        TEST(bb.m.errors == 0 && bb.m.data[0][0] == 0 && bb.m.data[1][1] == 0);
+        mf16_bfp_add(&bb, &bb, &bs);
+        TEST(bfp_error(&bb, s2, 2, 2) < 1e-6);
+        
+        bb.exponent = 120;
+        mf16_bfp_mul(&bb, &bb, &bb);
+        TEST(bb.m.errors & FIXMATRIX_OVERFLOW);
+    }
+    
+    {
+        COMMENT("Test block floating point cholesky and QR");
+        // P = B B' with entries up to 90000
+        mf16 b = {3, 3, 0, {{F16(300), 0, 0}, {F16(200), F16(100), 0}, {F16(-50), F16(10), F16(0.5)}}};
+        mf16 bt, l, q;
+        mf16_bfp bb, bbt, p, bl, r;
+        double expected_b[9], expected_p[9];
+        int i, j, k;
+        
+        for (i = 0; i < 3; i++)
+            for (j = 0; j < 3; j++)
+                expected_b[i * 3 + j] = b.data[i][j] / 65536.0;
+        for (i = 0; i < 3; i++)
+            for (j = 0; j < 3; j++)
+                for (expected_p[i * 3 + j] = 0, k = 0; k < 3; k++)
+                    expected_p[i * 3 + j] += expected_b[i * 3 + k] * expected_b[j * 3 + k];
+        
+        mf16_transpose(&bt, &b);
+        mf16_bfp_from_mf16(&bb, &b);
+        mf16_bfp_from_mf16(&bbt, &bt);
+        mf16_bfp_mul(&p, &bb, &bbt);
+        TEST(bfp_error(&p, expected_p, 3, 3) < 1e-6);
+        
+        mf16_bfp_cholesky(&bl, &p);
+        TEST(bfp_error(&bl, expected_b, 3, 3) < 1e-5);
+        mf16_bfp_to_mf16(&l, &bl);
+        TEST(l.errors == 0 && l.data[0][0] == F16(300));
+        
+        mf16_bfp_qr_decomposition(&q, &r, &p, 1);
+        TEST(q.errors == 0 && r.m.errors == 0);
+        mf16_bfp_from_mf16(&bb, &q);
+        mf16_bfp_mul(&bb, &bb, &r);
+        TEST(bfp_error(&bb, expected_p, 3, 3) < 2e-5);
+        
+    }
+    
     if (status != 0)
         fprintf(stdout, "\n\nSome tests FAILED!\n");
     
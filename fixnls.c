@@ -0,0 +1,225 @@
+#include <stddef.h>
+#include "fixnls.h"
+#include "fixarray.h"
+
+// Errors in the step that can be cured by more damping.
+#define STEP_ERRORS (FIXMATRIX_OVERFLOW | FIXMATRIX_SINGULAR | FIXMATRIX_NEGATIVE)
+
+void nls16_default_options(nls16_options *options)
+{
+    options->max_iterations = 20;
+    options->method = NLS16_AUTO;
+    options->damping = F16(0.001);
+    options->tolerance = F16(0.0001);
+    options->time_exceeded = NULL;
+}
+
+static fix16_t column_norm(const mf16 *vector)
+{
+    return fa16_norm(&vector->data[0][0], FIXMATRIX_MAX_SIZE, vector->rows);
+}
+
+// Largest diagonal entry of J'J, i.e. the largest squared column norm.
+static fix16_t max_diagonal(const mf16 *jacobian)
+{
+    fix16_t max = 0;
+    int column;
+    
+    for (column = 0; column < jacobian->columns; column++)
+    {
+        const fix16_t *p = &jacobian->data[0][column];
+        fix16_t square = fa16_dot(p, FIXMATRIX_MAX_SIZE, p, FIXMATRIX_MAX_SIZE, jacobian->rows);
+        
+        if (square == fix16_overflow)
+            return fix16_maximum;
+        
+        max = fix16_max(max, square);
+    }
+    
+    return max;
+}
+
+// Increases the damping after a rejected step. Returns false if it
+// cannot be increased further.
+static bool increase_damping(fix16_t *lambda, const mf16 *jacobian)
+{
+    if (*lambda == 0)
+    {
+        *lambda = fix16_max(max_diagonal(jacobian) >> 10, 1);
+        return true;
+    }
+    
+    if (*lambda > fix16_maximum / 4)
+        return false;
+    
+    *lambda *= 4;
+    return true;
+}
+
+// Solves (J'J + lambda I) step = -J' r, and returns the error flags.
+static uint8_t solve_step(nls16_workspace *w, fix16_t lambda, uint8_t method)
+{
+    const mf16 *j = &w->jacobian;
+    int m = j->rows, n = j->columns;
+    int rows = (lambda > 0) ? m + n : m;
+    int row, column;
+    
+    if (method == NLS16_QR || (method == NLS16_AUTO && rows <= FIXMATRIX_MAX_SIZE))
+    {
+        if (rows > FIXMATRIX_MAX_SIZE)
+            return FIXMATRIX_DIMERR;
+        
+        // Least squares solution of [J; sqrt(lambda) I] step = [-r; 0]
+        w->a = *j;
+        w->a.rows = rows;
+        w->b.rows = rows;
+        w->b.columns = 1;
+        w->b.errors = w->residual.errors;
+        
+        for (row = 0; row < m; row++)
+            w->b.data[row][0] = -w->residual.data[row][0];
+        
+        if (lambda > 0)
+        {
+            fix16_t s = fix16_sqrt(lambda);
+            
+            for (row = m; row < rows; row++)
+            {
+                for (column = 0; column < n; column++)
+                    w->a.data[row][column] = (row - m == column) ? s : 0;
+                
+                w->b.data[row][0] = 0;
+            }
+        }
+        
+        mf16_qr_decomposition(&w->a, &w->r, &w->a, 1);
+        mf16_solve(&w->step, &w->a, &w->r, &w->b);
+        return w->step.errors | w->r.errors;
+    }
+    else
+    {
+        mf16_mul_at(&w->a, j, j);
+        for (row = 0; row < n; row++)
+            w->a.data[row][row] = fix16_add(w->a.data[row][row], lambda);
+        
+        mf16_mul_at(&w->b, j, &w->residual);
+        mf16_mul_s(&w->b, &w->b, -fix16_one);
+        
+        // L L' step = b, by forward and back substitution.
+        mf16_tri_cholesky(&w->l, &w->a);
+        mf16_trsolve(&w->step, &w->l, &w->b);
+        w->l.upper = true;
+        mf16_trsolve(&w->step, &w->l, &w->step);
+        return w->step.errors | w->l.errors;
+    }
+}
+
+void nls16_solve(nls16_result *result, mf16 *params,
+                 nls16_function function, void *context,
+                 const nls16_options *options, nls16_workspace *workspace)
+{
+    nls16_workspace *w = workspace;
+    fix16_t lambda, cost;
+    uint8_t iteration, errors;
+    
+    result->iterations = 0;
+    
+    function(&w->residual, &w->jacobian, params, context);
+    result->errors = w->residual.errors | w->jacobian.errors;
+    result->cost = cost = column_norm(&w->residual);
+    
+    // The cost must be comparable to find the lowest residual.
+    if (cost == fix16_overflow)
+        result->errors |= FIXMATRIX_OVERFLOW;
+    
+    if (result->errors)
+    {
+        result->status = NLS16_ERROR;
+        return;
+    }
+    
+    lambda = fix16_mul(options->damping, max_diagonal(&w->jacobian));
+    
+    for (iteration = 0; iteration < options->max_iterations; iteration++)
+    {
+        if (cost == 0)
+        {
+            result->status = NLS16_CONVERGED;
+            return;
+        }
+        
+        if (options->time_exceeded && options->time_exceeded(context))
+        {
+            result->status = NLS16_TIMEOUT;
+            return;
+        }
+        
+        result->iterations = iteration + 1;
+        errors = solve_step(w, lambda, options->method);
+        
+        if (errors & ~STEP_ERRORS)
+        {
+            result->errors = errors;
+            result->status = NLS16_ERROR;
+            return;
+        }
+        
+        fix16_t step_norm = fix16_maximum;
+        fix16_t trial_cost = cost;
+        
+        if (!errors)
+        {
+            step_norm = column_norm(&w->step);
+            mf16_add(&w->trial, params, &w->step);
+            
+            // The Jacobian is computed already for the trial point,
+            // because most steps are accepted.
+            function(&w->trial_residual, &w->trial_jacobian, &w->trial, context);
+            
+            if (!(w->trial.errors | w->trial_residual.errors))
+            {
+                // A norm that overflows rejects the step like an error.
+                fix16_t norm = column_norm(&w->trial_residual);
+                
+                if (norm != fix16_overflow)
+                    trial_cost = norm;
+            }
+        }
+        
+        if (trial_cost < cost)
+        {
+            *params = w->trial;
+            w->residual = w->trial_residual;
+            w->jacobian = w->trial_jacobian;
+            result->cost = cost = trial_cost;
+            result->errors = w->jacobian.errors;
+            
+            if (result->errors)
+            {
+                result->status = NLS16_ERROR;
+                return;
+            }
+            
+            lambda /= 4;
+            
+            if (step_norm <= options->tolerance)
+            {
+                result->status = NLS16_CONVERGED;
+                return;
+            }
+        }
+        else if (!errors && step_norm <= options->tolerance)
+        {
+            // No smaller residual within the resolution of the parameters.
+            result->status = NLS16_CONVERGED;
+            return;
+        }
+        else if (!increase_damping(&lambda, &w->jacobian))
+        {
+            result->status = NLS16_NO_PROGRESS;
+            return;
+        }
+    }
+    
+    result->status = NLS16_MAX_ITERATIONS;
+}
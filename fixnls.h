@@ -0,0 +1,98 @@
+/* Nonlinear least squares: finds the parameters x that minimize the
+ * norm of a residual vector r(x), using the Levenberg-Marquardt method.
+ *
+ * Each iteration solves the damped Gauss-Newton step
+ *   (J'J + lambda I) dx = -J' r
+ * where J is the Jacobian of r. The step is accepted if it reduces the
+ * norm of the residual, and the damping lambda is then decreased, and
+ * otherwise increased. With lambda = 0 this is the Gauss-Newton method.
+ *
+ * The step is computed by QR decomposition of J augmented with the
+ * rows sqrt(lambda) I, which avoids squaring the condition number of J.
+ * If that does not fit in an mf16, J'J is formed and solved by Cholesky
+ * decomposition instead.
+ *
+ * All temporary matrices are kept in a caller-provided workspace, so
+ * nothing is allocated on the stack per iteration, and the iteration
+ * count and time can be limited for real-time use.
+ */
+
+#ifndef _FIXNLS_H_
+#define _FIXNLS_H_
+
+#include <stdbool.h>
+#include <fix16.h>
+#include "fixmatrix.h"
+
+// Computes the m x 1 residual and the m x n Jacobian for the n x 1
+// parameters. The function sets the dimensions of the results. Error
+// flags in the Jacobian stop the solver, and in the residual cause the
+// step to be rejected, or stop the solver at the starting point.
+typedef void (*nls16_function)(mf16 *residual, mf16 *jacobian,
+                               const mf16 *params, void *context);
+
+// Methods for computing the step.
+#define NLS16_AUTO   0 // QR if the augmented system fits, otherwise normal equations
+#define NLS16_QR     1 // Always QR, FIXMATRIX_DIMERR if rows + columns > FIXMATRIX_MAX_SIZE
+#define NLS16_NORMAL 2 // Always normal equations, faster for tall well-conditioned J
+
+typedef struct {
+    uint8_t max_iterations;
+    uint8_t method;
+    
+    // Initial damping relative to the largest diagonal entry of J'J.
+    // 0 starts with Gauss-Newton steps and adds damping only if a step
+    // fails to reduce the residual.
+    fix16_t damping;
+    
+    // The solver stops when the norm of the step is at most this.
+    fix16_t tolerance;
+    
+    // Optional, called before each iteration with the function context.
+    // Returning true stops the solver with NLS16_TIMEOUT.
+    bool (*time_exceeded)(void *context);
+} nls16_options;
+
+// Temporary storage for the solver. Can be reused between calls.
+typedef struct {
+    mf16 residual;
+    mf16 jacobian;
+    mf16 trial;
+    mf16 trial_residual;
+    mf16 trial_jacobian;
+    mf16 step;
+    mf16 a; // Augmented J or J'J, and Q of its QR decomposition
+    mf16 r;
+    mf16 b;
+    mf16_tri l;
+} nls16_workspace;
+
+// Result status
+#define NLS16_CONVERGED      0 // Step below tolerance or zero residual
+#define NLS16_MAX_ITERATIONS 1 // Iteration limit reached
+#define NLS16_TIMEOUT        2 // time_exceeded() returned true
+#define NLS16_NO_PROGRESS    3 // Damping grew too large without reducing the residual
+#define NLS16_ERROR          4 // Error flags from the function or the step computation
+
+typedef struct {
+    uint8_t status;
+    uint8_t iterations;
+    uint8_t errors;  // Matrix error flags, for NLS16_ERROR
+    fix16_t cost;    // Norm of the residual at the returned parameters
+} nls16_result;
+
+// Default options: 20 iterations, NLS16_AUTO, damping 0.001 and
+// tolerance 0.0001.
+void nls16_default_options(nls16_options *options);
+
+// Minimizes the norm of the residual, starting from and updating params,
+// an n x 1 matrix. The returned params always have the lowest residual
+// found so far, also when the solver stops before convergence. Steps to
+// a residual whose norm overflows are rejected, and if the norm of the
+// initial residual overflows, the result is NLS16_ERROR with
+// FIXMATRIX_OVERFLOW.
+void nls16_solve(nls16_result *result, mf16 *params,
+                 nls16_function function, void *context,
+                 const nls16_options *options, nls16_workspace *workspace);
+
+#endif
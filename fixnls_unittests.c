@@ -0,0 +1,188 @@
+#include <stdio.h>
+#include "unittests.h"
+#include "fixnls.h"
+
+// Circle through points (x, y): residual d_i - radius, where d_i is the
+// distance of point i from the center (cx, cy).
+typedef struct {
+    int count;
+    fix16_t x[8];
+    fix16_t y[8];
+} circle_data;
+
+static void circle_function(mf16 *residual, mf16 *jacobian, const mf16 *params, void *context)
+{
+    const circle_data *data = context;
+    fix16_t cx = params->data[0][0], cy = params->data[1][0], radius = params->data[2][0];
+    int i;
+    
+    residual->rows = data->count;
+    residual->columns = 1;
+    residual->errors = params->errors;
+    
+    jacobian->rows = data->count;
+    jacobian->columns = 3;
+    jacobian->errors = params->errors;
+    
+    for (i = 0; i < data->count; i++)
+    {
+        fix16_t dx = data->x[i] - cx, dy = data->y[i] - cy;
+        fix16_t d = fix16_sqrt(fix16_sq(dx) + fix16_sq(dy));
+        residual->data[i][0] = d - radius;
+        jacobian->data[i][0] = -fix16_div(dx, d);
+        jacobian->data[i][1] = -fix16_div(dy, d);
+        jacobian->data[i][2] = -fix16_one;
+    }
+}
+
+// Rosenbrock function as least squares: r = [10 (y - x^2), 1 - x]
+static void rosenbrock_function(mf16 *residual, mf16 *jacobian, const mf16 *params, void *context)
+{
+    fix16_t x = params->data[0][0], y = params->data[1][0];
+    (void)context;
+    
+    residual->rows = 2;
+    residual->columns = 1;
+    residual->errors = 0;
+    residual->data[0][0] = 10 * (y - fix16_sq(x));
+    residual->data[1][0] = fix16_one - x;
+    
+    jacobian->rows = jacobian->columns = 2;
+    jacobian->errors = 0;
+    jacobian->data[0][0] = -20 * x;
+    jacobian->data[0][1] = fix16_from_int(10);
+    jacobian->data[1][0] = -fix16_one;
+    jacobian->data[1][1] = 0;
+}
+
+// r = [x^2 - 1, x^2 - 1], whose norm overflows already for x > 152
+// while the elements still fit.
+static void square_function(mf16 *residual, mf16 *jacobian, const mf16 *params, void *context)
+{
+    fix16_t x = params->data[0][0];
+    (void)context;
+    
+    residual->rows = 2;
+    residual->columns = 1;
+    residual->errors = 0;
+    residual->data[0][0] = residual->data[1][0] = fix16_sq(x) - fix16_one;
+    
+    jacobian->rows = 2;
+    jacobian->columns = 1;
+    jacobian->errors = 0;
+    jacobian->data[0][0] = jacobian->data[1][0] = 2 * x;
+}
+
+static bool always_exceeded(void *context)
+{
+    (void)context;
+    return true;
+}
+
+int main()
+{
+    int status = 0;
+    
+    {
+        // Points on the circle centered at (2, -1) with radius 3, with
+        // small deviations.
+        circle_data data = {6,
+            {F16(5.01), F16(2), F16(-1), F16(2), F16(4.12), F16(-0.1)},
+            {F16(-1), F16(2.02), F16(-1.01), F16(-4), F16(1.12), F16(-3.12)}};
+        mf16 params = {3, 1, 0, {{F16(1)}, {F16(0)}, {F16(1)}}};
+        mf16 start = params;
+        nls16_options options;
+        nls16_workspace workspace;
+        nls16_result result;
+        
+        COMMENT("Test nls16_solve circle fit with the default options");
+        nls16_default_options(&options);
+        nls16_solve(&result, &params, circle_function, &data, &options, &workspace);
+        TEST(result.status == NLS16_CONVERGED);
+        TEST(result.iterations < 10);
+        TEST(fix16_abs(params.data[0][0] - F16(2)) < F16(0.02));
+        TEST(fix16_abs(params.data[1][0] - F16(-1)) < F16(0.02));
+        TEST(fix16_abs(params.data[2][0] - F16(3)) < F16(0.02));
+        TEST(result.cost < F16(0.03));
+        
+        COMMENT("Test nls16_solve circle fit with Gauss-Newton and QR");
+        mf16 gauss_newton = start;
+        nls16_result gn_result;
+        options.damping = 0;
+        options.method = NLS16_QR;
+        nls16_solve(&gn_result, &gauss_newton, circle_function, &data, &options, &workspace);
+        TEST(gn_result.status == NLS16_CONVERGED);
+        TEST(fix16_abs(gauss_newton.data[0][0] - params.data[0][0]) < F16(0.001));
+        TEST(fix16_abs(gauss_newton.data[2][0] - params.data[2][0]) < F16(0.001));
+        
+        COMMENT("Test NLS16_QR with a damped system that does not fit");
+        options.damping = F16(0.001);
+        params = start;
+        nls16_solve(&result, &params, circle_function, &data, &options, &workspace);
+        TEST(result.status == NLS16_ERROR && (result.errors & FIXMATRIX_DIMERR));
+        
+        COMMENT("Test iteration and time budgets");
+        nls16_default_options(&options);
+        options.max_iterations = 1;
+        params = start;
+        nls16_solve(&result, &params, circle_function, &data, &options, &workspace);
+        TEST(result.status == NLS16_MAX_ITERATIONS && result.iterations == 1);
+        TEST(params.data[2][0] != start.data[2][0]);
+        
+        options.max_iterations = 20;
+        options.time_exceeded = always_exceeded;
+        params = start;
+        nls16_solve(&result, &params, circle_function, &data, &options, &workspace);
+        TEST(result.status == NLS16_TIMEOUT && result.iterations == 0);
+        TEST(params.data[2][0] == start.data[2][0]);
+    }
+    
+    {
+        mf16 params = {2, 1, 0, {{F16(-1.2)}, {F16(1)}}};
+        mf16 start = params;
+        nls16_options options;
+        nls16_workspace workspace;
+        nls16_result result;
+        
+        COMMENT("Test nls16_solve Rosenbrock with QR and with normal equations");
+        nls16_default_options(&options);
+        options.max_iterations = 50;
+        nls16_solve(&result, &params, rosenbrock_function, NULL, &options, &workspace);
+        TEST(result.status == NLS16_CONVERGED);
+        TEST(fix16_abs(params.data[0][0] - F16(1)) < F16(0.001));
+        TEST(fix16_abs(params.data[1][0] - F16(1)) < F16(0.001));
+        
+        options.method = NLS16_NORMAL;
+        params = start;
+        nls16_solve(&result, &params, rosenbrock_function, NULL, &options, &workspace);
+        TEST(result.status == NLS16_CONVERGED);
+        TEST(fix16_abs(params.data[0][0] - F16(1)) < F16(0.001));
+        TEST(fix16_abs(params.data[1][0] - F16(1)) < F16(0.001));
+    }
+    
+    {
+        mf16 params = {1, 1, 0, {{F16(0.003125)}}};
+        nls16_options options;
+        nls16_workspace workspace;
+        nls16_result result;
+        
+        COMMENT("Test nls16_solve rejects a step to a residual norm that overflows");
+        nls16_default_options(&options);
+        options.damping = 0;
+        nls16_solve(&result, &params, square_function, NULL, &options, &workspace);
+        TEST(result.errors == 0);
+        TEST(result.cost >= 0 && result.cost < F16(1.5));
+        TEST(params.data[0][0] < F16(152));
+        
+        COMMENT("Test nls16_solve with an initial residual norm that overflows");
+        params.data[0][0] = F16(170);
+        nls16_solve(&result, &params, square_function, NULL, &options, &workspace);
+        TEST(result.status == NLS16_ERROR && (result.errors & FIXMATRIX_OVERFLOW));
+        TEST(params.data[0][0] == F16(170));
+    }
+    
+    if (status != 0)
+        fprintf(stdout, "\n\nSome tests FAILED!\n");
+    
+    return status;
+}
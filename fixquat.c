@@ -42,10 +42,13 @@ void qf16_mul_s(qf16 *dest, const qf16 *q, fix16_t s)
 // Divide quaternion by scalar
 void qf16_div_s(qf16 *dest, const qf16 *q, fix16_t s)
 {
-    dest->a = fix16_div(q->a, s);
-    dest->b = fix16_div(q->b, s);
-    dest->c = fix16_div(q->c, s);
-    dest->d = fix16_div(q->d, s);
+    fa16_divisor divisor;
+    fa16_divisor_init(&divisor, s);
+    
+    dest->a = fa16_divide(q->a, &divisor);
+    dest->b = fa16_divide(q->b, &divisor);
+    dest->c = fa16_divide(q->c, &divisor);
+    dest->d = fa16_divide(q->d, &divisor);
 }
 
 fix16_t qf16_dot(const qf16 *q, const qf16 *r)
@@ -62,23 +65,30 @@ fix16_t qf16_norm(const qf16 *q)
 // Normalize quaternion
 void qf16_normalize(qf16 *dest, const qf16 *q)
 {
-    qf16_div_s(dest, q, qf16_norm(q));
+    *dest = *q;
+    fa16_normalize_inplace(&dest->a, &dest->b - &dest->a, 4);
 }
 
 // Quaternion power
 void qf16_pow(qf16 *dest, const qf16 *q, fix16_t power)
 {
-    fix16_t old_half_angle = fix16_acos(q->a);
+    // For a unit quaternion, the norm of the vector part is the sine
+    // of the half angle, so only the new angle needs sin and cos.
+    fix16_t v[3] = {q->b, q->c, q->d};
+    fix16_t old_sin = fa16_norm(v, 1, 3);
+    fix16_t old_half_angle = fix16_atan2(old_sin, q->a);
     fix16_t new_half_angle = fix16_mul(old_half_angle, power);
+    fix16_t new_sin, new_cos;
     fix16_t multiplier = 0;
     
+    fa16_sincos(new_half_angle, &new_sin, &new_cos);
+    
     if (old_half_angle > 10) // Guard against almost-zero divider
     {
-        multiplier = fix16_div(fix16_sin(new_half_angle),
-                               fix16_sin(old_half_angle));
+        multiplier = fix16_div(new_sin, old_sin);
     }
     
-    dest->a = fix16_cos(new_half_angle);
+    dest->a = new_cos;
     dest->b = fix16_mul(q->b, multiplier);
     dest->c = fix16_mul(q->c, multiplier);
     dest->d = fix16_mul(q->d, multiplier);
@@ -109,17 +119,389 @@ void qf16_avg(qf16 *dest, const qf16 *q1, const qf16 *q2, fix16_t weight)
     qf16_normalize(dest, dest);
 }
 
+void qf16_nlerp(qf16 *dest, const qf16 *q1, const qf16 *q2, fix16_t t)
+{
+    // q1 and -q1 represent the same rotation, pick the closer one.
+    fix16_t w2 = t;
+    if (qf16_dot(q1, q2) < 0)
+        w2 = -t;
+    
+    qf16 tmp1, tmp2;
+    qf16_mul_s(&tmp1, q1, fix16_one - t);
+    qf16_mul_s(&tmp2, q2, w2);
+    qf16_add(dest, &tmp1, &tmp2);
+    qf16_normalize(dest, dest);
+}
+
+void qf16_slerp_init(qf16_slerp_state *state, const qf16 *q1, const qf16 *q2)
+{
+    qf16 target = *q2;
+    fix16_t dot = qf16_dot(q1, q2);
+    
+    if (dot < 0)
+    {
+        qf16_mul_s(&target, &target, -fix16_one);
+        dot = -dot;
+    }
+    
+    // perp = q2 - dot * q1, normalized. The angle is computed with
+    // atan2 from both components, which is accurate also for nearly
+    // equal q1 and q2, unlike acos(dot).
+    qf16 projection;
+    qf16_mul_s(&projection, q1, dot);
+    state->q1 = *q1;
+    state->perp.a = target.a - projection.a;
+    state->perp.b = target.b - projection.b;
+    state->perp.c = target.c - projection.c;
+    state->perp.d = target.d - projection.d;
+    
+    fix16_t norm = fa16_normalize_inplace(&state->perp.a, &state->perp.b - &state->perp.a, 4);
+    state->angle = fix16_atan2(norm, dot);
+}
+
+void qf16_slerp_eval(qf16 *dest, const qf16_slerp_state *state, fix16_t t)
+{
+    fix16_t c, s;
+    fa16_sincos(fix16_mul(t, state->angle), &s, &c);
+    
+    dest->a = fix16_mul(c, state->q1.a) + fix16_mul(s, state->perp.a);
+    dest->b = fix16_mul(c, state->q1.b) + fix16_mul(s, state->perp.b);
+    dest->c = fix16_mul(c, state->q1.c) + fix16_mul(s, state->perp.c);
+    dest->d = fix16_mul(c, state->q1.d) + fix16_mul(s, state->perp.d);
+}
+
+#ifndef FIXMATH_NO_64BIT
+
+void qf16_slerp_batch(qf16 *dest, const qf16_slerp_state *state,
+                      fix16_t t0, fix16_t step, unsigned count)
+{
+    // The angle advances by a constant delta between the points, so
+    // (cos, sin) can be rotated by it instead of evaluating them again.
+    // This is done in 2.30 format, and restarted every 16 points from
+    // fa16_sincos() to avoid accumulating the rounding errors.
+    const int64_t one = (int64_t)1 << 30;
+    int64_t delta = ((int64_t)step * state->angle) >> 2;
+    unsigned i;
+    
+    if (delta > one / 4 || delta < -one / 4)
+    {
+        // Too large step for the Taylor series below.
+        for (i = 0; i < count; i++)
+            qf16_slerp_eval(dest++, state, t0 + (fix16_t)i * step);
+        return;
+    }
+    
+    // cos(delta) = 1 - d^2/2 + d^4/24, sin(delta) = d - d^3/6 + d^5/120
+    int64_t d2 = (delta * delta) >> 30;
+    int64_t d4 = (d2 * d2) >> 30;
+    int64_t cos_delta = one - d2 / 2 + d4 / 24;
+    int64_t sin_delta = (delta * (one - d2 / 6 + d4 / 120)) >> 30;
+    
+    const qf16 *q1 = &state->q1;
+    const qf16 *perp = &state->perp;
+    const int64_t round = one >> 1;
+    int64_t c = 0, s = 0;
+    
+    for (i = 0; i < count; i++)
+    {
+        if ((i & 15) == 0)
+        {
+            fix16_t sine, cosine;
+            fa16_sincos(fix16_mul(t0 + (fix16_t)i * step, state->angle), &sine, &cosine);
+            c = (int64_t)cosine << 14;
+            s = (int64_t)sine << 14;
+        }
+        else
+        {
+            int64_t next_c = (c * cos_delta - s * sin_delta) >> 30;
+            s = (s * cos_delta + c * sin_delta) >> 30;
+            c = next_c;
+        }
+        
+        dest->a = (fix16_t)((c * q1->a + s * perp->a + round) >> 30);
+        dest->b = (fix16_t)((c * q1->b + s * perp->b + round) >> 30);
+        dest->c = (fix16_t)((c * q1->c + s * perp->c + round) >> 30);
+        dest->d = (fix16_t)((c * q1->d + s * perp->d + round) >> 30);
+        dest++;
+    }
+}
+
+#else
+
+void qf16_slerp_batch(qf16 *dest, const qf16_slerp_state *state,
+                      fix16_t t0, fix16_t step, unsigned count)
+{
+    unsigned i;
+    for (i = 0; i < count; i++)
+        qf16_slerp_eval(dest++, state, t0 + (fix16_t)i * step);
+}
+
+#endif
+
+void qf16_slerp(qf16 *dest, const qf16 *q1, const qf16 *q2, fix16_t t)
+{
+    qf16_slerp_state state;
+    qf16_slerp_init(&state, q1, q2);
+    qf16_slerp_eval(dest, &state, t);
+}
+
 void qf16_from_axis_angle(qf16 *dest, const v3d *axis, fix16_t angle)
 {
-    angle /= 2;
-    fix16_t scale = fix16_sin(angle);
+    fix16_t scale;
+    fa16_sincos(angle / 2, &scale, &dest->a);
     
-    dest->a = fix16_cos(angle);
     dest->b = fix16_mul(axis->x, scale);
     dest->c = fix16_mul(axis->y, scale);
     dest->d = fix16_mul(axis->z, scale);
 }
 
+// The conversions are written for scalar components, so that the same
+// code serves both the qf16 and the structure of arrays interfaces.
+static inline void to_axis_angle(fix16_t *x, fix16_t *y, fix16_t *z, fix16_t *angle,
+                                 fix16_t a, fix16_t b, fix16_t c, fix16_t d)
+{
+    // q and -q are the same rotation, pick the one with angle <= pi.
+    if (a < 0)
+    {
+        a = -a; b = -b; c = -c; d = -d;
+    }
+    
+    // atan2 is accurate for both small and large angles, unlike acos(a).
+    fix16_t v[3] = {b, c, d};
+    fix16_t norm = fa16_normalize_inplace(v, 1, 3);
+    
+    if (norm == 0)
+    {
+        *x = fix16_one;
+        *y = *z = *angle = 0;
+        return;
+    }
+    
+    *x = v[0];
+    *y = v[1];
+    *z = v[2];
+    *angle = 2 * fix16_atan2(norm, a);
+}
+
+static inline void from_euler(fix16_t *a, fix16_t *b, fix16_t *c, fix16_t *d,
+                              fix16_t roll, fix16_t pitch, fix16_t yaw)
+{
+    fix16_t cr, sr, cp, sp, cy, sy;
+    fa16_sincos(roll / 2, &sr, &cr);
+    fa16_sincos(pitch / 2, &sp, &cp);
+    fa16_sincos(yaw / 2, &sy, &cy);
+    
+    fix16_t cpcy = fix16_mul(cp, cy), spsy = fix16_mul(sp, sy);
+    fix16_t cpsy = fix16_mul(cp, sy), spcy = fix16_mul(sp, cy);
+    
+    *a = fix16_mul(cr, cpcy) + fix16_mul(sr, spsy);
+    *b = fix16_mul(sr, cpcy) - fix16_mul(cr, spsy);
+    *c = fix16_mul(cr, spcy) + fix16_mul(sr, cpsy);
+    *d = fix16_mul(cr, cpsy) - fix16_mul(sr, spcy);
+}
+
+static inline void to_euler(fix16_t *roll, fix16_t *pitch, fix16_t *yaw,
+                            fix16_t a, fix16_t b, fix16_t c, fix16_t d)
+{
+    fix16_t sin_pitch = 2 * (fix16_mul(a, c) - fix16_mul(d, b));
+    
+    // Rounding can take the value slightly outside the range of asin.
+    if (sin_pitch > fix16_one)
+        sin_pitch = fix16_one;
+    else if (sin_pitch < -fix16_one)
+        sin_pitch = -fix16_one;
+    
+    *pitch = fix16_asin(sin_pitch);
+    
+    // At pitch of +-pi/2 only yaw -+ roll is defined, and the atan2
+    // arguments below are just rounding noise. Then roll is set to 0
+    // and yaw is computed from a and d, which are cos(pitch / 2) times
+    // the cos and sin of half of it.
+    if (fix16_abs(sin_pitch) > fix16_one - 4)
+    {
+        fix16_t angle = 2 * fix16_atan2(d, a);
+        if (angle > fix16_pi)
+            angle -= 2 * fix16_pi;
+        else if (angle < -fix16_pi)
+            angle += 2 * fix16_pi;
+        
+        *roll = 0;
+        *yaw = angle;
+        return;
+    }
+    
+    *roll = fix16_atan2(2 * (fix16_mul(a, b) + fix16_mul(c, d)),
+                        fix16_one - 2 * (fix16_sq(b) + fix16_sq(c)));
+    *yaw = fix16_atan2(2 * (fix16_mul(a, d) + fix16_mul(b, c)),
+                       fix16_one - 2 * (fix16_sq(c) + fix16_sq(d)));
+}
+
+void qf16_to_axis_angle(v3d *axis, fix16_t *angle, const qf16 *q)
+{
+    to_axis_angle(&axis->x, &axis->y, &axis->z, angle, q->a, q->b, q->c, q->d);
+}
+
+void qf16_from_euler(qf16 *dest, const v3d *angles)
+{
+    from_euler(&dest->a, &dest->b, &dest->c, &dest->d, angles->x, angles->y, angles->z);
+}
+
+void qf16_to_euler(v3d *angles, const qf16 *q)
+{
+    to_euler(&angles->x, &angles->y, &angles->z, q->a, q->b, q->c, q->d);
+}
+
+void qf16_to_axis_angle_batch(const v3d_soa *axis, fix16_t *angle,
+                              const qf16_soa *q, unsigned count)
+{
+    unsigned i;
+    for (i = 0; i < count; i++)
+    {
+        to_axis_angle(&axis->x[i], &axis->y[i], &axis->z[i], &angle[i],
+                      q->a[i], q->b[i], q->c[i], q->d[i]);
+    }
+}
+
+void qf16_from_euler_batch(const qf16_soa *dest, const v3d_soa *angles, unsigned count)
+{
+    unsigned i;
+    for (i = 0; i < count; i++)
+    {
+        from_euler(&dest->a[i], &dest->b[i], &dest->c[i], &dest->d[i],
+                   angles->x[i], angles->y[i], angles->z[i]);
+    }
+}
+
+void qf16_to_euler_batch(const v3d_soa *angles, const qf16_soa *q, unsigned count)
+{
+    unsigned i;
+    for (i = 0; i < count; i++)
+    {
+        to_euler(&angles->x[i], &angles->y[i], &angles->z[i],
+                 q->a[i], q->b[i], q->c[i], q->d[i]);
+    }
+}
+
+// Integrates a rotation outside the range of the polynomial expansion,
+// using trigonometric functions and a full normalization. The rotation
+// vector saturates at the limits of fix16_t.
+static void integrate_large(qf16 *dest, const qf16 *q, const v3d *rate, fix16_t dt)
+{
+    fix16_t half[3] = {fix16_smul(rate->x, dt) / 2,
+                       fix16_smul(rate->y, dt) / 2,
+                       fix16_smul(rate->z, dt) / 2};
+    fix16_t angle = fa16_norm(half, 1, 3);
+    fix16_t sine, cosine;
+    qf16 dq;
+    
+    fa16_sincos(angle, &sine, &cosine);
+    dq.a = cosine;
+    dq.b = fix16_mul(fix16_div(half[0], angle), sine);
+    dq.c = fix16_mul(fix16_div(half[1], angle), sine);
+    dq.d = fix16_mul(fix16_div(half[2], angle), sine);
+    
+    qf16_mul(dest, q, &dq);
+    qf16_normalize(dest, dest);
+}
+
+#ifndef FIXMATH_NO_64BIT
+
+void qf16_integrate(qf16 *dest, const qf16 *q, const v3d *rate, fix16_t dt)
+{
+    // Half of the rotation vector during the step, in 4.28 format.
+    // At high sample rates the angles are only a few hundred LSB in
+    // 16.16 format, so the extra precision matters.
+    int64_t x = ((int64_t)rate->x * dt) >> 5;
+    int64_t y = ((int64_t)rate->y * dt) >> 5;
+    int64_t z = ((int64_t)rate->z * dt) >> 5;
+    const int64_t one = (int64_t)1 << 28;
+    const int64_t limit = one / 4;
+    
+    if (x > limit || x < -limit || y > limit || y < -limit || z > limit || z < -limit)
+    {
+        integrate_large(dest, q, rate, dt);
+        return;
+    }
+    
+    // Taylor series up to 4th order for the half angle t:
+    // cos(t) = 1 - t^2/2 + t^4/24
+    // sin(t) / t = 1 - t^2/6 + t^4/120
+    int64_t t2 = (x * x + y * y + z * z) >> 28;
+    int64_t t4 = (t2 * t2) >> 28;
+    int64_t scale = one - t2 / 6 + t4 / 120;
+    int64_t w = one - t2 / 2 + t4 / 24;
+    x = (x * scale) >> 28;
+    y = (y * scale) >> 28;
+    z = (z * scale) >> 28;
+    
+    // q * (w, x, y, z) in 16.44 format, converted to 2.30 format.
+    int64_t a = (q->a * w - q->b * x - q->c * y - q->d * z) >> 14;
+    int64_t b = (q->a * x + q->b * w + q->c * z - q->d * y) >> 14;
+    int64_t c = (q->a * y - q->b * z + q->c * w + q->d * x) >> 14;
+    int64_t d = (q->a * z + q->b * y - q->c * x + q->d * w) >> 14;
+    
+    // Renormalize without a square root or division:
+    // 1/sqrt(n) is approximately (3 - n) / 2 for n close to 1.
+    int64_t norm_sq = (a * a + b * b + c * c + d * d) >> 30;
+    int64_t factor = (((int64_t)3 << 30) - norm_sq) >> 1;
+    const int64_t round = (int64_t)1 << 43;
+    
+    dest->a = (fix16_t)((a * factor + round) >> 44);
+    dest->b = (fix16_t)((b * factor + round) >> 44);
+    dest->c = (fix16_t)((c * factor + round) >> 44);
+    dest->d = (fix16_t)((d * factor + round) >> 44);
+}
+
+#else
+
+void qf16_integrate(qf16 *dest, const qf16 *q, const v3d *rate, fix16_t dt)
+{
+    // Half of the rotation vector during the step
+    fix16_t x = fix16_mul(rate->x, dt) / 2;
+    fix16_t y = fix16_mul(rate->y, dt) / 2;
+    fix16_t z = fix16_mul(rate->z, dt) / 2;
+    const fix16_t limit = fix16_one / 4;
+    
+    // This also catches fix16_overflow from the multiplications.
+    if (fix16_abs(x) > limit || fix16_abs(y) > limit || fix16_abs(z) > limit)
+    {
+        integrate_large(dest, q, rate, dt);
+        return;
+    }
+    
+    // Taylor series up to 4th order for the half angle t:
+    // cos(t) = 1 - t^2/2 + t^4/24
+    // sin(t) / t = 1 - t^2/6 + t^4/120
+    fix16_t t2 = fix16_sq(x) + fix16_sq(y) + fix16_sq(z);
+    fix16_t t4 = fix16_sq(t2);
+    fix16_t scale = fix16_one - t2 / 6 + t4 / 120;
+    
+    qf16 dq;
+    dq.a = fix16_one - t2 / 2 + t4 / 24;
+    dq.b = fix16_mul(x, scale);
+    dq.c = fix16_mul(y, scale);
+    dq.d = fix16_mul(z, scale);
+    
+    qf16_mul(dest, q, &dq);
+    
+    // Renormalize without a square root or division:
+    // 1/sqrt(n) is approximately (3 - n) / 2 for n close to 1.
+    fix16_t norm_sq = qf16_dot(dest, dest);
+    qf16_mul_s(dest, dest, (3 * fix16_one - norm_sq) / 2);
+}
+
+#endif
+
+void qf16_integrate_batch(qf16 *q, const v3d *rate, fix16_t dt, unsigned count)
+{
+    while (count--)
+    {
+        qf16_integrate(q, q, rate, dt);
+        q++;
+        rate++;
+    }
+}
+
 // Unit quaternion to rotation matrix
 void qf16_to_matrix(mf16 *dest, const qf16 *q)
 {
@@ -139,6 +521,84 @@ void qf16_to_matrix(mf16 *dest, const qf16 *q)
     dest->data[1][2] = 2 * (fix16_mul(q->c, q->d) - fix16_mul(q->a, q->b));
 }
 
+// Shepperd's method: the component with the largest magnitude is
+// computed from the diagonal, and the others from the off-diagonal
+// sums and differences divided by it. This keeps the division well
+// conditioned for all rotations. t below is 4 times the square of the
+// largest component, and r = 1 / (2 sqrt(t)), so that the largest
+// component is t * r and the others are the off-diagonal terms times r.
+static inline void from_matrix(fix16_t *a, fix16_t *b, fix16_t *c, fix16_t *d,
+                               fix16_t m00, fix16_t m01, fix16_t m02,
+                               fix16_t m10, fix16_t m11, fix16_t m12,
+                               fix16_t m20, fix16_t m21, fix16_t m22)
+{
+    fix16_t trace = m00 + m11 + m22;
+    fix16_t t, r;
+    
+    if (trace >= m00 && trace >= m11 && trace >= m22)
+    {
+        t = fix16_one + trace;
+        r = fa16_rsqrt(4 * t);
+        *a = fix16_mul(t, r);
+        *b = fix16_mul(m21 - m12, r);
+        *c = fix16_mul(m02 - m20, r);
+        *d = fix16_mul(m10 - m01, r);
+    }
+    else if (m00 >= m11 && m00 >= m22)
+    {
+        t = fix16_one + m00 - m11 - m22;
+        r = fa16_rsqrt(4 * t);
+        *a = fix16_mul(m21 - m12, r);
+        *b = fix16_mul(t, r);
+        *c = fix16_mul(m01 + m10, r);
+        *d = fix16_mul(m02 + m20, r);
+    }
+    else if (m11 >= m22)
+    {
+        t = fix16_one - m00 + m11 - m22;
+        r = fa16_rsqrt(4 * t);
+        *a = fix16_mul(m02 - m20, r);
+        *b = fix16_mul(m01 + m10, r);
+        *c = fix16_mul(t, r);
+        *d = fix16_mul(m12 + m21, r);
+    }
+    else
+    {
+        t = fix16_one - m00 - m11 + m22;
+        r = fa16_rsqrt(4 * t);
+        *a = fix16_mul(m10 - m01, r);
+        *b = fix16_mul(m02 + m20, r);
+        *c = fix16_mul(m12 + m21, r);
+        *d = fix16_mul(t, r);
+    }
+    
+    if (*a < 0)
+    {
+        *a = -*a; *b = -*b; *c = -*c; *d = -*d;
+    }
+}
+
+void qf16_from_matrix(qf16 *dest, const mf16 *matrix)
+{
+    const fix16_t (*m)[FIXMATRIX_MAX_SIZE] = matrix->data;
+    from_matrix(&dest->a, &dest->b, &dest->c, &dest->d,
+                m[0][0], m[0][1], m[0][2],
+                m[1][0], m[1][1], m[1][2],
+                m[2][0], m[2][1], m[2][2]);
+}
+
+void qf16_from_matrix_batch(const qf16_soa *dest, const fix16_t *const m[9], unsigned count)
+{
+    unsigned i;
+    for (i = 0; i < count; i++)
+    {
+        from_matrix(&dest->a[i], &dest->b[i], &dest->c[i], &dest->d[i],
+                    m[0][i], m[1][i], m[2][i],
+                    m[3][i], m[4][i], m[5][i],
+                    m[6][i], m[7][i], m[8][i]);
+    }
+}
+
 void qf16_rotate(v3d *dest, const qf16 *q, const v3d *v)
 {
     qf16 vector, q_conj;
@@ -14,6 +14,15 @@ typedef struct {
     fix16_t d; // k
 } qf16;
 
+// Structure of arrays, for batch functions that process the components
+// of many quaternions stored in separate arrays.
+typedef struct {
+    fix16_t *a;
+    fix16_t *b;
+    fix16_t *c;
+    fix16_t *d;
+} qf16_soa;
+
 // Conjugate of quaternion
 void qf16_conj(qf16 *dest, const qf16 *q);
 
@@ -45,13 +54,80 @@ void qf16_pow(qf16 *dest, const qf16 *q, fix16_t power);
 // Think of it as q = w * q1 + (1 - w) * q2, but the internal algorithm considers attitudes.
 void qf16_avg(qf16 *dest, const qf16 *q1, const qf16 *q2, fix16_t weight);
 
+// Normalized linear interpolation between unit quaternions q1 (t = 0)
+// and q2 (t = 1), along the shorter path. Faster than slerp, but the
+// rotation speed is not constant over t.
+void qf16_nlerp(qf16 *dest, const qf16 *q1, const qf16 *q2, fix16_t t);
+
+// Precomputed state for spherical linear interpolation from q1 to q2.
+// The interpolated value is q1 * cos(t * angle) + perp * sin(t * angle).
+typedef struct {
+    qf16 q1;
+    qf16 perp;      // Unit quaternion orthogonal to q1, towards q2
+    fix16_t angle;  // Angle between q1 and q2 in 4D, i.e. half of the rotation angle
+} qf16_slerp_state;
+
+// Spherical linear interpolation between unit quaternions q1 (t = 0)
+// and q2 (t = 1), along the shorter path.
+// qf16_slerp_init() computes the angle once for the pair, after which
+// qf16_slerp_eval() needs only a sine and cosine per point.
+// qf16_slerp_batch() evaluates count points at t0, t0 + step, ... and
+// avoids the trigonometric functions for most of them.
+void qf16_slerp_init(qf16_slerp_state *state, const qf16 *q1, const qf16 *q2);
+void qf16_slerp_eval(qf16 *dest, const qf16_slerp_state *state, fix16_t t);
+void qf16_slerp_batch(qf16 *dest, const qf16_slerp_state *state,
+                      fix16_t t0, fix16_t step, unsigned count);
+void qf16_slerp(qf16 *dest, const qf16 *q1, const qf16 *q2, fix16_t t);
+
 // Unit quaternion from axis and angle.
 // Axis should have unit length and angle in radians.
 void qf16_from_axis_angle(qf16 *dest, const v3d *axis, fix16_t angle);
 
+// Rotation axis and angle of a unit quaternion. The angle is in the
+// range 0 to pi and the axis has unit length. For (almost) zero
+// rotations the axis is [1 0 0].
+void qf16_to_axis_angle(v3d *axis, fix16_t *angle, const qf16 *q);
+
+// Conversions between unit quaternions and Euler angles in the
+// aerospace (Z-Y-X) convention: angles->z is yaw, angles->y pitch and
+// angles->x roll, all in radians. The quaternion rotates from the body
+// frame to the reference frame. Near pitch of +-pi/2 the roll and yaw
+// are not unique and qf16_to_euler() returns some valid combination.
+void qf16_from_euler(qf16 *dest, const v3d *angles);
+void qf16_to_euler(v3d *angles, const qf16 *q);
+
+// Batch forms of the conversions above, for count elements stored as
+// structure of arrays.
+void qf16_to_axis_angle_batch(const v3d_soa *axis, fix16_t *angle,
+                              const qf16_soa *q, unsigned count);
+void qf16_from_euler_batch(const qf16_soa *dest, const v3d_soa *angles, unsigned count);
+void qf16_to_euler_batch(const v3d_soa *angles, const qf16_soa *q, unsigned count);
+
+// Integrate angular rate over a time step, dest = q * dq.
+// Rate is in radians per unit of dt, in the body frame of q.
+// Uses a polynomial expansion of sin and cos instead of trigonometric
+// functions, which is accurate for rotations up to 0.5 rad per step.
+// q should be a unit quaternion. The result is renormalized with one
+// Newton-Raphson step, which also corrects small drift in the norm of q.
+// If any component of rate * dt exceeds 0.5 rad, fa16_sincos() and a
+// full normalization are used instead, and rate * dt saturates at the
+// limits of fix16_t.
+void qf16_integrate(qf16 *dest, const qf16 *q, const v3d *rate, fix16_t dt);
+
+// Integrate many quaternions in place, q[i] = q[i] * dq(rate[i] * dt).
+void qf16_integrate_batch(qf16 *q, const v3d *rate, fix16_t dt, unsigned count);
+
 // Unit quaternion to rotation matrix
 void qf16_to_matrix(mf16 *dest, const qf16 *q);
 
+// Rotation matrix to unit quaternion, using Shepperd's method. Only
+// the top-left 3x3 part of the matrix is used, and it should be
+// orthonormal. The result has a non-negative real part.
+void qf16_from_matrix(qf16 *dest, const mf16 *matrix);
+
+// Batch form for count matrices given as the nine arrays m[row * 3 + column].
+void qf16_from_matrix_batch(const qf16_soa *dest, const fix16_t *const m[9], unsigned count);
+
 // Rotate vector using quaternion
 void qf16_rotate(v3d *dest, const qf16 *q, const v3d *v);
 
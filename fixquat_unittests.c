@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include "unittests.h"
 #include "fixquat.h"
+#include "fixarray.h"
 #include "fixstring.h"
 
 fix16_t max_delta(const qf16 *a, const qf16 *b)
@@ -23,6 +24,42 @@ int main()
 {
     int status = 0;
     
+    {
+        COMMENT("Test fa16_sincos");
+        // Angles and correctly rounded sin and cos of them, in 16.16 format.
+        const fix16_t cases[12][3] = {
+            {0, 0, 65536}, {32768, 31420, 57513}, {-32768, -31420, 57513},
+            {65536, 55147, 35409}, {51472, 46341, 46341}, {102944, 65536, 0},
+            {196608, 9248, -64880}, {-196608, -9248, -64880},
+            {262144, -49598, -42837}, {6553600, -33185, 56513},
+            {-65536000, -54190, 36856}, {1966080000, -52603, -39088}
+        };
+        fix16_t s, c, max = 0;
+        int i;
+        
+        for (i = 0; i < 12; i++)
+        {
+            fa16_sincos(cases[i][0], &s, &c);
+            max = fix16_max(max, fix16_abs(s - cases[i][1]));
+            max = fix16_max(max, fix16_abs(c - cases[i][2]));
+        }
+        TEST(max <= 1);
+        
+        // Over the range of qf16 half angles, sin^2 + cos^2 = 1
+        // and the results agree with fix16_sin and fix16_cos.
+        fix16_t max_norm = 0, max_diff = 0;
+        for (i = -1000; i <= 1000; i++)
+        {
+            fix16_t angle = i * 211;
+            fa16_sincos(angle, &s, &c);
+            max_norm = fix16_max(max_norm, fix16_abs(fix16_sq(s) + fix16_sq(c) - fix16_one));
+            max_diff = fix16_max(max_diff, fix16_abs(s - fix16_sin(angle)));
+            max_diff = fix16_max(max_diff, fix16_abs(c - fix16_cos(angle)));
+        }
+        TEST(max_norm <= 3);
+        TEST(max_diff <= 4);
+    }
+    
     {
         qf16 a = {fix16_from_int(1), fix16_from_int(2), fix16_from_int(3), fix16_from_int(4)};
         qf16 b = {fix16_from_int(5), fix16_from_int(6), fix16_from_int(7), fix16_from_int(8)};
@@ -131,6 +168,120 @@ int main()
         TEST(max_delta_abs(&result, &expected) < 2);
     }
     
+    {
+        COMMENT("Test qf16_slerp and qf16_nlerp");
+        qf16 a, b, expected, result;
+        v3d axis = {F16(0.48), F16(0.6), F16(0.64)};
+        
+        qf16_from_axis_angle(&a, &axis, F16(0.5));
+        qf16_from_axis_angle(&b, &axis, F16(2.5));
+        qf16_from_axis_angle(&expected, &axis, F16(1.0));
+        
+        qf16_slerp(&result, &a, &b, F16(0.25));
+        print_qf16(stdout, &result);
+        printf(" vs. ");
+        print_qf16(stdout, &expected);
+        printf("\n");
+        TEST(max_delta(&result, &expected) < 5);
+        
+        qf16_slerp(&result, &a, &b, 0);
+        TEST(max_delta(&result, &a) < 3);
+        qf16_slerp(&result, &a, &b, F16(1));
+        TEST(max_delta(&result, &b) < 3);
+        
+        // Both go through the midpoint
+        qf16_from_axis_angle(&expected, &axis, F16(1.5));
+        qf16_nlerp(&result, &a, &b, F16(0.5));
+        TEST(max_delta(&result, &expected) < 5);
+        
+        // -b is the same rotation, and the shorter path is taken.
+        qf16 minus_b = {-b.a, -b.b, -b.c, -b.d};
+        qf16_slerp(&result, &a, &minus_b, F16(0.25));
+        qf16_from_axis_angle(&expected, &axis, F16(1.0));
+        TEST(max_delta(&result, &expected) < 5);
+        qf16_nlerp(&result, &a, &minus_b, F16(0.5));
+        qf16_from_axis_angle(&expected, &axis, F16(1.5));
+        TEST(max_delta(&result, &expected) < 5);
+        
+        COMMENT("Test qf16_slerp_batch");
+        qf16_slerp_state state;
+        qf16 batch[100];
+        fix16_t max = 0;
+        int i;
+        
+        qf16_slerp_init(&state, &a, &b);
+        qf16_slerp_batch(batch, &state, 0, F16(0.01), 100);
+        for (i = 0; i < 100; i++)
+        {
+            qf16_slerp_eval(&result, &state, F16(0.01) * i);
+            max = fix16_max(max, max_delta(&result, &batch[i]));
+        }
+        TEST(max < 5);
+        
+        COMMENT("Test qf16_slerp with equal quaternions");
+        qf16_slerp(&result, &a, &a, F16(0.5));
+        TEST(max_delta(&result, &a) < 2);
+    }
+    
+    {
+        COMMENT("Test qf16_integrate");
+        qf16 q = {F16(1), 0, 0, 0};
+        qf16 expected;
+        v3d axis = {F16(0.6), 0, F16(0.8)};
+        v3d rate = {F16(0.6 * 2.0), 0, F16(0.8 * 2.0)};
+        int i;
+        
+        // 1 second at 2 rad/s in 1024 steps
+        for (i = 0; i < 1024; i++)
+            qf16_integrate(&q, &q, &rate, F16(1.0 / 1024));
+        
+        qf16_from_axis_angle(&expected, &axis, F16(2.0));
+        print_qf16(stdout, &q);
+        printf(" vs. ");
+        print_qf16(stdout, &expected);
+        printf("\n");
+        TEST(max_delta(&q, &expected) < F16(0.001));
+        TEST(fix16_abs(qf16_norm(&q) - F16(1)) < 5);
+        
+        COMMENT("Test qf16_integrate renormalization");
+        qf16_mul_s(&q, &q, F16(1.01));
+        rate.x = rate.y = rate.z = 0;
+        qf16_integrate(&q, &q, &rate, F16(0.005));
+        qf16_integrate(&q, &q, &rate, F16(0.005));
+        TEST(fix16_abs(qf16_norm(&q) - F16(1)) < 5);
+        
+        COMMENT("Test qf16_integrate with a large rotation per step");
+        qf16 start = {F16(0.5), F16(0.5), F16(0.5), F16(0.5)};
+        qf16 dq;
+        rate.x = F16(0.6 * 3.0);
+        rate.y = 0;
+        rate.z = F16(0.8 * 3.0);
+        qf16_integrate(&q, &start, &rate, F16(1));
+        qf16_from_axis_angle(&dq, &axis, F16(3.0));
+        qf16_mul(&expected, &start, &dq);
+        TEST(max_delta(&q, &expected) < 10);
+        TEST(fix16_abs(qf16_norm(&q) - F16(1)) < 5);
+        
+        rate.x = F16(30000);
+        rate.y = F16(-20000);
+        rate.z = F16(100);
+        qf16_integrate(&q, &start, &rate, F16(2));
+        TEST(fix16_abs(qf16_norm(&q) - F16(1)) < 5);
+        
+        COMMENT("Test qf16_integrate_batch");
+        qf16 batch[3] = {{F16(1), 0, 0, 0}, {F16(0.5), F16(0.5), F16(0.5), F16(0.5)}, {0, F16(1), 0, 0}};
+        qf16 single[3];
+        v3d rates[3] = {{F16(1), F16(2), F16(3)}, {F16(-10), 0, F16(5)}, {0, 0, F16(50)}};
+        
+        for (i = 0; i < 3; i++)
+            qf16_integrate(&single[i], &batch[i], &rates[i], F16(0.001));
+        
+        qf16_integrate_batch(batch, rates, F16(0.001), 3);
+        TEST(max_delta(&batch[0], &single[0]) == 0);
+        TEST(max_delta(&batch[1], &single[1]) == 0);
+        TEST(max_delta(&batch[2], &single[2]) == 0);
+    }
+    
     {
         COMMENT("Test qf16 -> rotation matrix");
         qf16 rot = {fix16_from_float(0.7071), fix16_from_float(0.7071), 0, 0};
@@ -165,6 +316,154 @@ int main()
         TEST(output.z == F16(2));
     }
     
+    {
+        COMMENT("Test qf16_from_matrix");
+        // Rotations where each component in turn is the largest,
+        // including one by almost pi.
+        qf16 rots[5] = {
+            {F16(0.9), F16(0.1), F16(-0.3), F16(0.3)},
+            {F16(0.1), F16(0.9), F16(0.3), F16(-0.3)},
+            {F16(-0.3), F16(0.1), F16(0.9), F16(0.3)},
+            {F16(0.3), F16(-0.1), F16(0.3), F16(-0.9)},
+            {F16(0.001), F16(0.6), F16(0.8), 0}
+        };
+        qf16 result;
+        mf16 matrix;
+        fix16_t max = 0;
+        int i;
+        
+        for (i = 0; i < 5; i++)
+        {
+            qf16_normalize(&rots[i], &rots[i]);
+            qf16_to_matrix(&matrix, &rots[i]);
+            qf16_from_matrix(&result, &matrix);
+            TEST(result.a >= 0);
+            max = fix16_max(max, max_delta_abs(&result, &rots[i]));
+        }
+        TEST(max < 8);
+        
+        COMMENT("Test qf16_from_matrix_batch");
+        fix16_t m[9][5], qa[5], qb[5], qc[5], qd[5];
+        const fix16_t *columns[9];
+        qf16_soa soa = {qa, qb, qc, qd};
+        int row, column, ok = 1;
+        
+        for (i = 0; i < 9; i++)
+            columns[i] = m[i];
+        
+        for (i = 0; i < 5; i++)
+        {
+            qf16_to_matrix(&matrix, &rots[i]);
+            for (row = 0; row < 3; row++)
+                for (column = 0; column < 3; column++)
+                    m[row * 3 + column][i] = matrix.data[row][column];
+        }
+        
+        qf16_from_matrix_batch(&soa, columns, 5);
+        for (i = 0; i < 5; i++)
+        {
+            qf16_to_matrix(&matrix, &rots[i]);
+            qf16_from_matrix(&result, &matrix);
+            ok = ok && qa[i] == result.a && qb[i] == result.b
+                    && qc[i] == result.c && qd[i] == result.d;
+        }
+        TEST(ok);
+    }
+    
+    {
+        COMMENT("Test qf16_to_axis_angle");
+        v3d axis = {F16(0.48), F16(0.6), F16(-0.64)};
+        v3d result_axis;
+        fix16_t angle;
+        qf16 q;
+        
+        qf16_from_axis_angle(&q, &axis, F16(2.5));
+        qf16_to_axis_angle(&result_axis, &angle, &q);
+        TEST(fix16_abs(angle - F16(2.5)) < F16(0.0005));
+        TEST(fix16_abs(result_axis.x - axis.x) < F16(0.0005));
+        TEST(fix16_abs(result_axis.y - axis.y) < F16(0.0005));
+        TEST(fix16_abs(result_axis.z - axis.z) < F16(0.0005));
+        
+        // -q is the same rotation, but the angle is reported as <= pi.
+        qf16_mul_s(&q, &q, -fix16_one);
+        qf16_to_axis_angle(&result_axis, &angle, &q);
+        TEST(fix16_abs(angle - F16(2.5)) < F16(0.0005));
+        TEST(fix16_abs(result_axis.z - axis.z) < F16(0.0005));
+        
+        // Small angles are accurate, unlike with acos.
+        qf16_from_axis_angle(&q, &axis, F16(0.01));
+        qf16_to_axis_angle(&result_axis, &angle, &q);
+        TEST(fix16_abs(angle - F16(0.01)) < 3);
+        
+        qf16 identity = {F16(1), 0, 0, 0};
+        qf16_to_axis_angle(&result_axis, &angle, &identity);
+        TEST(angle == 0 && result_axis.x == F16(1) && result_axis.y == 0);
+    }
+    
+    {
+        COMMENT("Test qf16_from_euler and qf16_to_euler");
+        v3d angles = {F16(0.3), F16(-0.5), F16(2.0)};
+        v3d x_axis = {F16(1), 0, 0}, y_axis = {0, F16(1), 0}, z_axis = {0, 0, F16(1)};
+        v3d result_angles;
+        qf16 roll, pitch, yaw, expected, result;
+        
+        // Yaw, then pitch, then roll about the rotated axes.
+        qf16_from_axis_angle(&roll, &x_axis, angles.x);
+        qf16_from_axis_angle(&pitch, &y_axis, angles.y);
+        qf16_from_axis_angle(&yaw, &z_axis, angles.z);
+        qf16_mul(&expected, &yaw, &pitch);
+        qf16_mul(&expected, &expected, &roll);
+        
+        qf16_from_euler(&result, &angles);
+        TEST(max_delta(&result, &expected) < 5);
+        
+        qf16_to_euler(&result_angles, &result);
+        TEST(fix16_abs(result_angles.x - angles.x) < F16(0.001));
+        TEST(fix16_abs(result_angles.y - angles.y) < F16(0.001));
+        TEST(fix16_abs(result_angles.z - angles.z) < F16(0.001));
+        
+        // Gimbal lock, pitch of pi/2
+        angles.y = fix16_pi / 2;
+        qf16_from_euler(&result, &angles);
+        qf16_to_euler(&result_angles, &result);
+        TEST(fix16_abs(result_angles.y - angles.y) < F16(0.01));
+        qf16_from_euler(&expected, &result_angles);
+        TEST(max_delta_abs(&result, &expected) < F16(0.01));
+        
+        COMMENT("Test Euler and axis-angle batches");
+        fix16_t x[3] = {F16(0.1), F16(-2.0), F16(3.0)};
+        fix16_t y[3] = {F16(0.2), F16(1.0), F16(-1.5)};
+        fix16_t z[3] = {F16(-0.3), F16(0.5), F16(1.0)};
+        fix16_t qa[3], qb[3], qc[3], qd[3], rx[3], ry[3], rz[3], angle[3];
+        v3d_soa in = {x, y, z}, out = {rx, ry, rz};
+        qf16_soa q = {qa, qb, qc, qd};
+        v3d axis;
+        fix16_t single_angle;
+        int i, ok = 1;
+        
+        qf16_from_euler_batch(&q, &in, 3);
+        qf16_to_euler_batch(&out, &q, 3);
+        for (i = 0; i < 3; i++)
+        {
+            v3d a = {x[i], y[i], z[i]};
+            qf16_from_euler(&result, &a);
+            qf16_to_euler(&result_angles, &result);
+            ok = ok && qa[i] == result.a && qb[i] == result.b && qc[i] == result.c && qd[i] == result.d;
+            ok = ok && rx[i] == result_angles.x && ry[i] == result_angles.y && rz[i] == result_angles.z;
+            ok = ok && fix16_abs(rx[i] - x[i]) < F16(0.001) && fix16_abs(rz[i] - z[i]) < F16(0.001);
+        }
+        TEST(ok);
+        
+        qf16_to_axis_angle_batch(&out, angle, &q, 3);
+        for (i = 0; i < 3; i++)
+        {
+            qf16 single = {qa[i], qb[i], qc[i], qd[i]};
+            qf16_to_axis_angle(&axis, &single_angle, &single);
+            ok = ok && angle[i] == single_angle && rx[i] == axis.x && ry[i] == axis.y && rz[i] == axis.z;
+        }
+        TEST(ok);
+    }
+    
     if (status != 0)
         fprintf(stdout, "\n\nSome tests FAILED!\n");
     
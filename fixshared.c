@@ -0,0 +1,111 @@
+#include "fixshared.h"
+
+// The values are accessed with relaxed atomic operations, which compile
+// to plain loads and stores, and ordered by the fences around them.
+// See Boehm, "Can seqlocks get along with programming language memory
+// models?", 2012.
+
+static unsigned pack_header(const mf16 *matrix)
+{
+    return matrix->rows | (matrix->columns << 8) | (matrix->errors << 16);
+}
+
+static void unpack_header(mf16 *dest, unsigned header)
+{
+    dest->rows = (uint8_t)header;
+    dest->columns = (uint8_t)(header >> 8);
+    dest->errors = (uint8_t)(header >> 16);
+}
+
+void mf16_shared_init(mf16_shared *shared)
+{
+    atomic_init(&shared->sequence, 0);
+    atomic_init(&shared->count, 0);
+}
+
+void mf16_shared_write(mf16_shared *shared, const mf16 *const matrices[], uint_fast8_t count)
+{
+    unsigned sequence = atomic_load_explicit(&shared->sequence, memory_order_relaxed);
+    _Atomic fix16_t *dest = shared->data;
+    uint_fast8_t i, row, column;
+    
+    if (count > FIXSHARED_MAX_COUNT)
+        count = FIXSHARED_MAX_COUNT;
+    
+    atomic_store_explicit(&shared->sequence, sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    
+    atomic_store_explicit(&shared->count, count, memory_order_relaxed);
+    
+    for (i = 0; i < count; i++)
+    {
+        const mf16 *matrix = matrices[i];
+        atomic_store_explicit(&shared->headers[i], pack_header(matrix), memory_order_relaxed);
+        
+        for (row = 0; row < matrix->rows; row++)
+        {
+            for (column = 0; column < matrix->columns; column++)
+            {
+                atomic_store_explicit(dest++, matrix->data[row][column], memory_order_relaxed);
+            }
+        }
+    }
+    
+    atomic_store_explicit(&shared->sequence, sequence + 2, memory_order_release);
+}
+
+// Copies the data without checking the sequence. The dimensions come
+// from a possibly torn read, so they are limited to the buffer size.
+static void copy_matrices(mf16 *const dest[], const mf16_shared *shared, uint_fast8_t count)
+{
+    unsigned published = atomic_load_explicit(&shared->count, memory_order_relaxed);
+    const _Atomic fix16_t *src = shared->data;
+    uint_fast8_t i, row, column;
+    
+    for (i = 0; i < count; i++)
+    {
+        mf16 *matrix = dest[i];
+        
+        if (i >= published || i >= FIXSHARED_MAX_COUNT)
+        {
+            matrix->rows = matrix->columns = 0;
+            matrix->errors = FIXMATRIX_USEERR;
+            continue;
+        }
+        
+        unpack_header(matrix, atomic_load_explicit(&shared->headers[i], memory_order_relaxed));
+        
+        if (matrix->rows > FIXMATRIX_MAX_SIZE || matrix->columns > FIXMATRIX_MAX_SIZE)
+        {
+            matrix->rows = matrix->columns = 0;
+            continue;
+        }
+        
+        for (row = 0; row < matrix->rows; row++)
+        {
+            for (column = 0; column < matrix->columns; column++)
+            {
+                matrix->data[row][column] = atomic_load_explicit(src++, memory_order_relaxed);
+            }
+        }
+    }
+}
+
+bool mf16_shared_try_read(mf16 *const dest[], const mf16_shared *shared, uint_fast8_t count)
+{
+    unsigned before = atomic_load_explicit(&shared->sequence, memory_order_acquire);
+    
+    if (before & 1)
+        return false;
+    
+    copy_matrices(dest, shared, count);
+    
+    atomic_thread_fence(memory_order_acquire);
+    unsigned after = atomic_load_explicit(&shared->sequence, memory_order_relaxed);
+    return before == after;
+}
+
+void mf16_shared_read(mf16 *const dest[], const mf16_shared *shared, uint_fast8_t count)
+{
+    while (!mf16_shared_try_read(dest, shared, count));
+}
@@ -0,0 +1,59 @@
+/* Matrices shared between a writer thread and reader threads.
+ *
+ * The writer publishes a group of matrices, e.g. the state and the
+ * covariance of a filter, and readers get a consistent snapshot of the
+ * whole group. This is a sequence lock: the writer never waits, and a
+ * reader retries if a write happened during its copy.
+ *
+ * Only the rows * columns values of each matrix are stored and copied,
+ * packed one after another, instead of the full FIXMATRIX_MAX_SIZE
+ * buffer of mf16.
+ *
+ * There must be only one writer at a time. Requires C11 atomics.
+ */
+
+#ifndef _FIXSHARED_H_
+#define _FIXSHARED_H_
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <fix16.h>
+#include "fixmatrix.h"
+
+// Maximum number of matrices published together.
+#ifndef FIXSHARED_MAX_COUNT
+#define FIXSHARED_MAX_COUNT 2
+#endif
+
+typedef struct {
+    // Incremented before and after each write, so it is odd while
+    // a write is in progress.
+    atomic_uint sequence;
+    
+    // Number of matrices, and rows, columns and errors of each packed
+    // into one value.
+    atomic_uint count;
+    atomic_uint headers[FIXSHARED_MAX_COUNT];
+    
+    _Atomic fix16_t data[FIXSHARED_MAX_COUNT * FIXMATRIX_MAX_SIZE * FIXMATRIX_MAX_SIZE];
+} mf16_shared;
+
+// Initializes an empty container, with no matrices published.
+void mf16_shared_init(mf16_shared *shared);
+
+// Publishes count matrices, replacing the previous ones. Matrices
+// beyond FIXSHARED_MAX_COUNT are ignored.
+void mf16_shared_write(mf16_shared *shared, const mf16 *const matrices[], uint_fast8_t count);
+
+// Copies the published matrices to dest. Matrices that have not been
+// published get FIXMATRIX_USEERR and 0x0 dimensions.
+// mf16_shared_read() retries until it gets a consistent copy, while
+// mf16_shared_try_read() makes one attempt and returns false if it
+// was interrupted by a write, leaving dest with partial data.
+// A reader that can preempt the writer, e.g. an interrupt handler or
+// a higher priority task on a single core, must use the latter, as
+// the write cannot complete while it is retrying.
+void mf16_shared_read(mf16 *const dest[], const mf16_shared *shared, uint_fast8_t count);
+bool mf16_shared_try_read(mf16 *const dest[], const mf16_shared *shared, uint_fast8_t count);
+
+#endif
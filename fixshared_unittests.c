@@ -0,0 +1,132 @@
+#include <stdio.h>
+#include <pthread.h>
+#include "unittests.h"
+#include "fixshared.h"
+
+static mf16_shared stress;
+static atomic_int stress_done;
+
+// Writes matrices where all values are equal to the write number, so
+// that a torn copy can be detected from any two values.
+static void *stress_writer(void *arg)
+{
+    mf16 state = {6, 1, 0, {{0}}}, covariance = {6, 6, 0, {{0}}};
+    const mf16 *matrices[2] = {&state, &covariance};
+    int i, row, column;
+    (void)arg;
+    
+    for (i = 1; i <= 20000; i++)
+    {
+        for (row = 0; row < 6; row++)
+        {
+            state.data[row][0] = i;
+            for (column = 0; column < 6; column++)
+                covariance.data[row][column] = i;
+        }
+        
+        mf16_shared_write(&stress, matrices, 2);
+    }
+    
+    atomic_store(&stress_done, 1);
+    return NULL;
+}
+
+static void *stress_reader(void *arg)
+{
+    mf16 state, covariance;
+    mf16 *const dest[2] = {&state, &covariance};
+    int *torn = arg;
+    int row, column;
+    
+    while (!atomic_load(&stress_done))
+    {
+        mf16_shared_read(dest, &stress, 2);
+        
+        if (state.rows == 0)
+            continue;
+        
+        for (row = 0; row < 6; row++)
+        {
+            if (state.data[row][0] != state.data[0][0])
+                (*torn)++;
+            
+            for (column = 0; column < 6; column++)
+            {
+                if (covariance.data[row][column] != state.data[0][0])
+                    (*torn)++;
+            }
+        }
+    }
+    
+    return NULL;
+}
+
+int main()
+{
+    int status = 0;
+    
+    {
+        mf16_shared shared;
+        mf16 a = {2, 3, 0, {{1, 2, 3}, {4, 5, 6}}};
+        mf16 b = {1, 1, FIXMATRIX_OVERFLOW, {{-7}}};
+        const mf16 *matrices[2] = {&a, &b};
+        mf16 ra, rb;
+        mf16 *const dest[2] = {&ra, &rb};
+        
+        COMMENT("Test reading an empty mf16_shared");
+        mf16_shared_init(&shared);
+        mf16_shared_read(dest, &shared, 1);
+        TEST(ra.rows == 0 && ra.columns == 0 && ra.errors == FIXMATRIX_USEERR);
+        
+        COMMENT("Test writing and reading two matrices");
+        mf16_shared_write(&shared, matrices, 2);
+        mf16_shared_read(dest, &shared, 2);
+        TEST(ra.rows == 2 && ra.columns == 3 && ra.errors == 0);
+        TEST(ra.data[0][0] == 1 && ra.data[0][2] == 3 && ra.data[1][0] == 4 && ra.data[1][2] == 6);
+        TEST(rb.rows == 1 && rb.columns == 1 && rb.errors == FIXMATRIX_OVERFLOW);
+        TEST(rb.data[0][0] == -7);
+        
+        COMMENT("Test that the live region is packed");
+        TEST(atomic_load(&shared.data[6]) == -7);
+        
+        COMMENT("Test replacing with a single matrix");
+        matrices[0] = &b;
+        mf16_shared_write(&shared, matrices, 1);
+        TEST(mf16_shared_try_read(dest, &shared, 2));
+        TEST(ra.rows == 1 && ra.data[0][0] == -7);
+        TEST(rb.errors == FIXMATRIX_USEERR);
+        
+        COMMENT("Test mf16_shared_try_read during a write");
+        atomic_fetch_add(&shared.sequence, 1);
+        TEST(!mf16_shared_try_read(dest, &shared, 1));
+        atomic_fetch_add(&shared.sequence, 1);
+        TEST(mf16_shared_try_read(dest, &shared, 1));
+    }
+    
+    {
+        pthread_t writer, readers[4];
+        int torn[4] = {0}, total = 0, i;
+        
+        COMMENT("Test consistency with concurrent readers");
+        mf16_shared_init(&stress);
+        atomic_init(&stress_done, 0);
+        
+        for (i = 0; i < 4; i++)
+            pthread_create(&readers[i], NULL, stress_reader, &torn[i]);
+        pthread_create(&writer, NULL, stress_writer, NULL);
+        
+        pthread_join(writer, NULL);
+        for (i = 0; i < 4; i++)
+        {
+            pthread_join(readers[i], NULL);
+            total += torn[i];
+        }
+        
+        TEST(total == 0);
+    }
+    
+    if (status != 0)
+        fprintf(stdout, "\n\nSome tests FAILED!\n");
+    
+    return status;
+}
@@ -1,70 +1,435 @@
 #include "fixstring.h"
 #include <string.h>
 
-void print_fix16_t(FILE *stream, fix16_t value, uint_fast8_t width, uint_fast8_t decimals)
+static const uint32_t scales[8] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000
+};
+
+/*********************
+ * Number formatting *
+ *********************/
+
+// Writes exactly count digits of value, zero-padded.
+static char *format_digits(char *buf, uint32_t value, uint_fast8_t count)
+{
+    char *p = buf + count;
+    while (p > buf)
+    {
+        *--p = '0' + (value % 10);
+        value /= 10;
+    }
+    return buf + count;
+}
+
+static uint_fast8_t count_digits(uint32_t value)
+{
+    uint_fast8_t count = 1;
+    while (value >= 10)
+    {
+        value /= 10;
+        count++;
+    }
+    return count;
+}
+
+// Same as fix16_mul(fracpart, scale), without the 64-bit multiply when
+// the product fits in 32 bits.
+static uint32_t scale_fraction(uint32_t fracpart, uint32_t scale)
+{
+    if (scale > 10000)
+        return fix16_mul(fracpart, scale);
+    
+#ifndef FIXMATH_NO_ROUNDING
+    return (fracpart * scale + 0x8000) >> 16;
+#else
+    return (fracpart * scale) >> 16;
+#endif
+}
+
+size_t format_fix16_t(char *buf, fix16_t value, uint_fast8_t width, uint_fast8_t decimals)
+{
+    uint32_t uvalue = (value >= 0) ? (uint32_t)value : -(uint32_t)value;
+    
+    decimals &= 7;
+    uint32_t intpart = uvalue >> 16;
+    uint32_t scale = scales[decimals];
+    uint32_t fracpart = scale_fraction(uvalue & 0xFFFF, scale);
+    
+    if (fracpart >= scale)
+    {
+        intpart++;
+        fracpart -= scale;
+    }
+    
+    // Compute the length first, so that digits can be written in place.
+    uint_fast8_t intdigits = count_digits(intpart);
+    uint_fast8_t len = (value < 0) + intdigits + (decimals ? decimals + 1 : 0);
+    char *p = buf;
+    
+    while (width > len)
+    {
+        *p++ = ' ';
+        width--;
+    }
+    
+    if (value < 0)
+        *p++ = '-';
+    
+    p = format_digits(p, intpart, intdigits);
+    
+    if (decimals)
+    {
+        *p++ = '.';
+        p = format_digits(p, fracpart, decimals);
+    }
+    
+    return p - buf;
+}
+
+size_t format_mf16_row(char *buf, size_t size, const mf16 *matrix, uint8_t row)
 {
-    char buf[13];
-    fix16_to_str(value, buf, decimals);
+    char *p = buf;
+    char *end = buf + size;
+    int column;
     
-    uint_fast8_t len = strlen(buf);
-    if (len < width)
+    for (column = 0; column < matrix->columns; column++)
     {
-        width -= len;
-        while (width-- > 0)
-            fputc(' ', stream);
+        fix16_t value = matrix->data[row][column];
+        
+        if (end - p >= 13)
+        {
+            p += format_fix16_t(p, value, 9, 4);
+        }
+        else
+        {
+            // Near the end of buffer, check the actual length.
+            char tmp[12];
+            size_t len = format_fix16_t(tmp, value, 9, 4);
+            if ((size_t)(end - p) < len + 1)
+                return 0;
+            memcpy(p, tmp, len);
+            p += len;
+        }
+        
+        *p++ = ' ';
     }
+    
+    if (end - p < 2)
+        return 0;
+    
+    *p++ = '\n';
+    *p = '\0';
+    return p - buf;
+}
 
-    fputs(buf, stream);
+size_t format_mf16(char *buf, size_t size, const mf16 *matrix)
+{
+    static const char error_text[] = "MATRIX ERRORS: ";
+    char *p = buf;
+    char *end = buf + size;
+    int row;
+    
+    if (size == 0)
+        return 0;
+    
+    if (matrix->errors)
+    {
+        if ((size_t)(end - p) < sizeof(error_text) + 4)
+            return 0;
+        
+        memcpy(p, error_text, sizeof(error_text) - 1);
+        p += sizeof(error_text) - 1;
+        p = format_digits(p, matrix->errors, count_digits(matrix->errors));
+        *p++ = '\n';
+    }
+    
+    *p = '\0';
+    for (row = 0; row < matrix->rows; row++)
+    {
+        size_t len = format_mf16_row(p, end - p, matrix, row);
+        if (!len)
+            return 0;
+        p += len;
+    }
+    
+    return p - buf;
+}
+
+/**********************
+ * Formatted printing *
+ **********************/
+
+void print_fix16_t(FILE *stream, fix16_t value, uint_fast8_t width, uint_fast8_t decimals)
+{
+    char buf[24];
+    size_t len;
+    
+    if (width <= sizeof(buf))
+    {
+        len = format_fix16_t(buf, value, width, decimals);
+    }
+    else
+    {
+        len = format_fix16_t(buf, value, 0, decimals);
+        fprintf(stream, "%*s", (int)(width - len), "");
+    }
+    
+    fwrite(buf, 1, len, stream);
 }
 
 void print_mf16(FILE *stream, const mf16 *matrix)
 {
+    char buf[FIXSTRING_ROW_MAXLEN];
+    
     if (matrix->errors)
     {
         fprintf(stream, "MATRIX ERRORS: %d\n", matrix->errors);
     }
     
-    int row, column;
+    int row;
     for (row = 0; row < matrix->rows; row++)
     {
-        for (column = 0; column < matrix->columns; column++)
-        {
-            fix16_t value = matrix->data[row][column];
-            print_fix16_t(stream, value, 9, 4);
-            fprintf(stream, " ");
-        }
-        fprintf(stream, "\n");
+        size_t len = format_mf16_row(buf, sizeof(buf), matrix, row);
+        fwrite(buf, 1, len, stream);
     }
 }
 
 void print_qf16(FILE *stream, const qf16 *quat)
 {
-    print_fix16_t(stream, quat->a, 9, 4);
-    fprintf(stream, " ");
-    print_fix16_t(stream, quat->b, 9, 4);
-    fprintf(stream, "i ");
-    print_fix16_t(stream, quat->c, 9, 4);
-    fprintf(stream, "j ");
-    print_fix16_t(stream, quat->d, 9, 4);
-    fprintf(stream, "k");
+    char buf[4 * 14];
+    char *p = buf;
+    p += format_fix16_t(p, quat->a, 9, 4);
+    *p++ = ' ';
+    p += format_fix16_t(p, quat->b, 9, 4);
+    *p++ = 'i'; *p++ = ' ';
+    p += format_fix16_t(p, quat->c, 9, 4);
+    *p++ = 'j'; *p++ = ' ';
+    p += format_fix16_t(p, quat->d, 9, 4);
+    *p++ = 'k';
+    fwrite(buf, 1, p - buf, stream);
 }
 
 void print_v3d(FILE *stream, const v3d *vector)
 {
-    fprintf(stream, "(");
-    print_fix16_t(stream, vector->x, 9, 4);
-    fprintf(stream, ", ");
-    print_fix16_t(stream, vector->y, 9, 4);
-    fprintf(stream, ", ");
-    print_fix16_t(stream, vector->z, 9, 4);
-    fprintf(stream, ")");
+    char buf[3 * 14 + 2];
+    char *p = buf;
+    *p++ = '(';
+    p += format_fix16_t(p, vector->x, 9, 4);
+    *p++ = ','; *p++ = ' ';
+    p += format_fix16_t(p, vector->y, 9, 4);
+    *p++ = ','; *p++ = ' ';
+    p += format_fix16_t(p, vector->z, 9, 4);
+    *p++ = ')';
+    fwrite(buf, 1, p - buf, stream);
 }
 
 void print_v2d(FILE *stream, const v2d *vector)
 {
-    fprintf(stream, "(");
-    print_fix16_t(stream, vector->x, 9, 4);
-    fprintf(stream, ", ");
-    print_fix16_t(stream, vector->y, 9, 4);
-    fprintf(stream, ")");
+    char buf[2 * 14 + 2];
+    char *p = buf;
+    *p++ = '(';
+    p += format_fix16_t(p, vector->x, 9, 4);
+    *p++ = ','; *p++ = ' ';
+    p += format_fix16_t(p, vector->y, 9, 4);
+    *p++ = ')';
+    fwrite(buf, 1, p - buf, stream);
+}
+
+/***********
+ * Parsing *
+ ***********/
+
+// Powers of 5, for converting decimals to binary fraction.
+static const uint32_t fives[6] = {1, 5, 25, 125, 625, 3125};
+
+static bool is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+// Skips spaces and tabs, but not newlines.
+static const char *skip_blank(const char *str)
+{
+    while (*str == ' ' || *str == '\t' || *str == '\r')
+        str++;
+    return str;
+}
+
+// Skips blanks and at most one comma.
+static const char *skip_separator(const char *str)
+{
+    str = skip_blank(str);
+    if (*str == ',')
+        str = skip_blank(str + 1);
+    return str;
+}
+
+const char *parse_fix16_t(const char *str, fix16_t *value)
+{
+    str = skip_blank(str);
+    
+    bool negative = (*str == '-');
+    if (*str == '+' || *str == '-')
+        str++;
+    
+    // Leading zeros don't count toward the 5 digits that can fit.
+    bool leading_zeros = (*str == '0');
+    while (*str == '0')
+        str++;
+    
+    uint32_t intpart = 0;
+    int count = 0;
+    while (is_digit(*str) && count <= 5)
+    {
+        intpart = intpart * 10 + (*str++ - '0');
+        count++;
+    }
+    
+    // Binary fraction is fracpart * 2^16 / 10^k = fracpart * 2^(16-k) / 5^k,
+    // which fits in 32 bits for k <= 5.
+    uint32_t fracpart = 0;
+    int decimals = 0;
+    if (*str == '.')
+    {
+        str++;
+        while (is_digit(*str))
+        {
+            if (decimals < 5)
+            {
+                fracpart = fracpart * 10 + (*str - '0');
+                decimals++;
+            }
+            str++;
+        }
+        
+        if (count == 0 && !leading_zeros && decimals == 0)
+            return NULL;
+        
+        fracpart <<= 16 - decimals;
+#ifndef FIXMATH_NO_ROUNDING
+        fracpart += fives[decimals] / 2;
+#endif
+        fracpart /= fives[decimals];
+    }
+    else if (count == 0 && !leading_zeros)
+    {
+        return NULL;
+    }
+    
+    if (is_digit(*str) || count > 5 || intpart > 32768 ||
+        (intpart == 32768 && (!negative || fracpart)))
+    {
+        while (is_digit(*str) || *str == '.')
+            str++;
+        *value = fix16_overflow;
+        return str;
+    }
+    
+    uint32_t result = (intpart << 16) + fracpart;
+    *value = negative ? -result : result;
+    return str;
+}
+
+const char *parse_mf16(mf16 *dest, const char *str)
+{
+    static const char error_text[] = "MATRIX ERRORS:";
+    mf16 result = {0, 0, 0, {{0}}};
+    
+    // Skip empty lines before the matrix
+    for (;;)
+    {
+        const char *line = skip_blank(str);
+        if (*line != '\n')
+            break;
+        str = line + 1;
+    }
+    
+    str = skip_blank(str);
+    if (strncmp(str, error_text, sizeof(error_text) - 1) == 0)
+    {
+        str = skip_blank(str + sizeof(error_text) - 1);
+        if (!is_digit(*str))
+            return NULL;
+        
+        uint32_t errors = 0;
+        while (is_digit(*str))
+            errors = errors * 10 + (*str++ - '0');
+        result.errors = (uint8_t)errors;
+        
+        str = skip_blank(str);
+        if (*str == '\n')
+            str++;
+    }
+    
+    for (;;)
+    {
+        str = skip_blank(str);
+        if (*str == '\n' || *str == '\0')
+            break;
+        
+        if (result.rows == FIXMATRIX_MAX_SIZE)
+            return NULL;
+        
+        uint8_t column = 0;
+        while (*str != '\n' && *str != '\0')
+        {
+            fix16_t value;
+            
+            if (column == FIXMATRIX_MAX_SIZE)
+                return NULL;
+            
+            str = parse_fix16_t(str, &value);
+            if (!str)
+                return NULL;
+            
+            if (value == fix16_overflow)
+                result.errors |= FIXMATRIX_OVERFLOW;
+            
+            result.data[result.rows][column++] = value;
+            str = skip_separator(str);
+        }
+        
+        if (result.rows == 0)
+            result.columns = column;
+        else if (column != result.columns)
+            return NULL;
+        
+        result.rows++;
+        
+        if (*str == '\n')
+            str++;
+    }
+    
+    if (result.rows == 0)
+        return NULL;
+    
+    *dest = result;
+    return str;
+}
+
+const char *parse_qf16(qf16 *dest, const char *str)
+{
+    static const char suffixes[4] = {0, 'i', 'j', 'k'};
+    fix16_t values[4];
+    int i;
+    
+    // Allow newlines before and between the components
+    for (i = 0; i < 4; i++)
+    {
+        while (*str == ' ' || *str == '\t' || *str == '\r' || *str == '\n' || *str == ',')
+            str++;
+        
+        str = parse_fix16_t(str, &values[i]);
+        if (!str)
+            return NULL;
+        
+        if (suffixes[i] && *str == suffixes[i])
+            str++;
+    }
+    
+    dest->a = values[0];
+    dest->b = values[1];
+    dest->c = values[2];
+    dest->d = values[3];
+    return str;
 }
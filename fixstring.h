@@ -1,4 +1,4 @@
-/* Utilities for printing fix16_t datatypes. */
+/* Utilities for printing and parsing fix16_t datatypes. */
 
 #ifndef _FIXSTRING_H_
 #define _FIXSTRING_H_
@@ -18,4 +18,45 @@ void print_qf16(FILE *stream, const qf16 *quat);
 void print_v3d(FILE *stream, const v3d *vector);
 void print_v2d(FILE *stream, const v2d *vector);
 
-#endif
\ No newline at end of file
+/* The format_*() functions write to a caller-supplied buffer and return
+ * the number of characters written. The output is identical to the
+ * corresponding print_*() function.
+ */
+
+// Format a value right-aligned to width, with the same digits as
+// fix16_to_str(). The result is not null-terminated. The buffer must
+// have room for max(width, 14) characters.
+size_t format_fix16_t(char *buf, fix16_t value, uint_fast8_t width, uint_fast8_t decimals);
+
+// Buffer size that is always enough for format_mf16_row() or format_mf16().
+#define FIXSTRING_ROW_MAXLEN (FIXMATRIX_MAX_SIZE * 13 + 2)
+#define FIXSTRING_MF16_MAXLEN (20 + FIXMATRIX_MAX_SIZE * (FIXSTRING_ROW_MAXLEN - 1) + 1)
+
+// Format one row of a matrix, or the whole matrix, as print_mf16()
+// would. The result is null-terminated. Returns 0 if the buffer is too
+// small.
+size_t format_mf16_row(char *buf, size_t size, const mf16 *matrix, uint8_t row);
+size_t format_mf16(char *buf, size_t size, const mf16 *matrix);
+
+/* The parse_*() functions return a pointer to the first character after
+ * the parsed text, or NULL if the text could not be parsed.
+ */
+
+// Parse a number as fix16_from_str() does, except that only '.' is
+// accepted as the decimal point and digits beyond the fifth decimal are
+// ignored. Values out of range are stored as fix16_overflow.
+const char *parse_fix16_t(const char *str, fix16_t *value);
+
+// Parse a matrix written one row per line, with values separated by
+// whitespace and/or commas. The matrix ends at an empty line or at the
+// end of the string. The "MATRIX ERRORS" line of print_mf16() output is
+// also accepted. Values out of range set FIXMATRIX_OVERFLOW.
+// Rows of different length or more than FIXMATRIX_MAX_SIZE rows or
+// columns are a parse error. Dest is not modified on error.
+const char *parse_mf16(mf16 *dest, const char *str);
+
+// Parse four quaternion components separated by whitespace and/or
+// commas. The i, j and k suffixes written by print_qf16() are optional.
+const char *parse_qf16(qf16 *dest, const char *str);
+
+#endif
@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include <string.h>
+#include "unittests.h"
+#include "fixstring.h"
+
+int main()
+{
+    int status = 0;
+    
+    {
+        COMMENT("Test format_fix16_t against fix16_to_str");
+        uint32_t i;
+        int decimals;
+        int mismatches = 0;
+        
+        for (decimals = 0; decimals < 8; decimals++)
+        {
+            for (i = 0; i < 0x10000; i++)
+            {
+                fix16_t value = (fix16_t)(i * 0x9E3779B9u);
+                char expected[16], result[16];
+                
+                fix16_to_str(value, expected, decimals);
+                result[format_fix16_t(result, value, 0, decimals)] = '\0';
+                if (strcmp(expected, result) != 0)
+                    mismatches++;
+            }
+        }
+        
+        TEST(mismatches == 0);
+        
+        char buf[16];
+        TEST(format_fix16_t(buf, F16(-1.5), 9, 4) == 9);
+        TEST(memcmp(buf, "  -1.5000", 9) == 0);
+        TEST(format_fix16_t(buf, fix16_minimum, 9, 7) == 14);
+        TEST(memcmp(buf, "-32768.0000000", 14) == 0);
+    }
+    
+    {
+        COMMENT("Test format_mf16");
+        mf16 a = {2, 3, FIXMATRIX_SINGULAR, {
+            {F16(1), F16(-2.25), F16(3)},
+            {fix16_maximum, F16(0), fix16_minimum}
+        }};
+        char buf[FIXSTRING_MF16_MAXLEN];
+        const char *expected =
+            "MATRIX ERRORS: 8\n"
+            "   1.0000   -2.2500    3.0000 \n"
+            "32768.0000    0.0000 -32768.0000 \n";
+        
+        TEST(format_mf16(buf, sizeof(buf), &a) == strlen(expected));
+        TEST(strcmp(buf, expected) == 0);
+        TEST(format_mf16(buf, strlen(expected), &a) == 0);
+        TEST(format_mf16(buf, strlen(expected) + 1, &a) == strlen(expected));
+    }
+    
+    {
+        COMMENT("Test parse_fix16_t");
+        fix16_t value;
+        
+        TEST(parse_fix16_t("  12.5abc", &value) != NULL && value == F16(12.5));
+        TEST(parse_fix16_t("-0.00001", &value) != NULL && value == -fix16_div(1, 100000));
+        TEST(parse_fix16_t("3.14159", &value) != NULL && value == fix16_from_str("3.14159"));
+        TEST(parse_fix16_t("0.1234567", &value) != NULL && value == fix16_from_str("0.12345"));
+        TEST(parse_fix16_t("-32768", &value) != NULL && value == fix16_minimum);
+        TEST(parse_fix16_t("32768", &value) != NULL && value == fix16_overflow);
+        TEST(parse_fix16_t("1000000", &value) != NULL && value == fix16_overflow);
+        TEST(parse_fix16_t("000001", &value) != NULL && value == fix16_one);
+        TEST(parse_fix16_t("-0000032768.5", &value) != NULL && value == fix16_overflow);
+        TEST(parse_fix16_t("00.5", &value) != NULL && value == F16(0.5));
+        TEST(parse_fix16_t("0", &value) != NULL && value == 0);
+        TEST(parse_fix16_t("-", &value) == NULL);
+        TEST(parse_fix16_t(".", &value) == NULL);
+        TEST(parse_fix16_t("x", &value) == NULL);
+        
+        uint32_t i;
+        int mismatches = 0;
+        for (i = 0; i < 0x10000; i++)
+        {
+            char buf[16];
+            fix16_t value = (fix16_t)(i * 0x9E3779B9u);
+            fix16_to_str(value, buf, 5);
+            if (!parse_fix16_t(buf, &value) || value != fix16_from_str(buf))
+                mismatches++;
+        }
+        TEST(mismatches == 0);
+    }
+    
+    {
+        COMMENT("Test parse_mf16");
+        mf16 a = {3, 2, 0, {{F16(1), F16(-2)}, {F16(0.5), F16(100)}, {F16(-0.25), F16(7)}}};
+        mf16 b;
+        char buf[FIXSTRING_MF16_MAXLEN];
+        const char *end;
+        
+        format_mf16(buf, sizeof(buf), &a);
+        TEST((end = parse_mf16(&b, buf)) != NULL && *end == '\0');
+        TEST(b.rows == 3 && b.columns == 2 && b.errors == 0);
+        TEST(memcmp(a.data, b.data, 3 * sizeof(a.data[0])) == 0);
+        
+        a.errors = FIXMATRIX_NEGATIVE;
+        format_mf16(buf, sizeof(buf), &a);
+        TEST(parse_mf16(&b, buf) != NULL && b.errors == FIXMATRIX_NEGATIVE);
+        
+        const char *csv = "\n1,2,3\r\n4, 5, 6\n\n7,8\n";
+        TEST((end = parse_mf16(&b, csv)) != NULL);
+        TEST(b.rows == 2 && b.columns == 3 && b.data[1][2] == F16(6));
+        TEST((end = parse_mf16(&b, end)) != NULL && *end == '\0');
+        TEST(b.rows == 1 && b.columns == 2 && b.data[0][1] == F16(8));
+        
+        TEST(parse_mf16(&b, "1 2 40000\n") != NULL && b.errors == FIXMATRIX_OVERFLOW);
+        
+        b.rows = 5;
+        TEST(parse_mf16(&b, "1 2\n3\n") == NULL);
+        TEST(parse_mf16(&b, "1 2\n3 x\n") == NULL);
+        TEST(parse_mf16(&b, "1 2 3 4 5 6 7 8 9\n") == NULL);
+        TEST(parse_mf16(&b, "\n\n") == NULL);
+        TEST(b.rows == 5);
+    }
+    
+    {
+        COMMENT("Test parse_qf16");
+        qf16 q = {F16(0.5), F16(-0.5), F16(0.25), F16(-0.75)}, q2;
+        char buf[64];
+        FILE *f = fmemopen(buf, sizeof(buf), "w");
+        print_qf16(f, &q);
+        fclose(f);
+        
+        TEST(parse_qf16(&q2, buf) != NULL);
+        TEST(q2.a == q.a && q2.b == q.b && q2.c == q.c && q2.d == q.d);
+        TEST(parse_qf16(&q2, "1, 0, 0,\n 0") != NULL && q2.a == F16(1) && q2.d == 0);
+        TEST(parse_qf16(&q2, "1 2 3") == NULL);
+    }
+    
+    if (status != 0)
+        fprintf(stdout, "\n\nSome tests FAILED!\n");
+    
+    return status;
+}
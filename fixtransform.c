@@ -0,0 +1,174 @@
+#include "fixtransform.h"
+#include "fixarray.h"
+
+// Dot product of a row with [x y z w], i.e. one row of the homogeneous
+// matrix times a homogeneous vector. This is the same computation as
+// fa16_dot(), but written out for the fixed size so that the compiler
+// can keep everything in registers.
+#ifndef FIXMATH_NO_64BIT
+static inline fix16_t dot4(const fix16_t *row, fix16_t x, fix16_t y, fix16_t z, fix16_t w)
+{
+    fa16_acc sum = {0, 0};
+    
+    fa16_acc_add(&sum, (int64_t)row[0] * x);
+    fa16_acc_add(&sum, (int64_t)row[1] * y);
+    fa16_acc_add(&sum, (int64_t)row[2] * z);
+    fa16_acc_add(&sum, (int64_t)row[3] * w);
+    return fa16_acc_round(&sum);
+}
+#else
+static inline fix16_t dot4(const fix16_t *row, fix16_t x, fix16_t y, fix16_t z, fix16_t w)
+{
+    fix16_t v[4] = {x, y, z, w};
+    return fa16_dot(row, 1, v, 1, 4);
+}
+#endif
+
+void tf16_identity(tf16 *dest)
+{
+    int row, column;
+    
+    for (row = 0; row < 3; row++)
+    {
+        for (column = 0; column < 4; column++)
+        {
+            dest->data[row][column] = (row == column) ? fix16_one : 0;
+        }
+    }
+}
+
+void tf16_from_qf16(tf16 *dest, const qf16 *rotation, const v3d *translation)
+{
+    mf16 matrix;
+    int row, column;
+    
+    qf16_to_matrix(&matrix, rotation);
+    
+    for (row = 0; row < 3; row++)
+    {
+        for (column = 0; column < 3; column++)
+        {
+            dest->data[row][column] = matrix.data[row][column];
+        }
+    }
+    
+    dest->data[0][3] = translation->x;
+    dest->data[1][3] = translation->y;
+    dest->data[2][3] = translation->z;
+}
+
+bool tf16_from_mf16(tf16 *dest, const mf16 *matrix)
+{
+    int row, column;
+    
+    if (matrix->rows < 3 || matrix->rows > 4 || matrix->columns != 4 || matrix->errors)
+        return false;
+    
+    for (row = 0; row < 3; row++)
+    {
+        for (column = 0; column < 4; column++)
+        {
+            dest->data[row][column] = matrix->data[row][column];
+        }
+    }
+    
+    return true;
+}
+
+void tf16_to_mf16(mf16 *dest, const tf16 *transform)
+{
+    int row, column;
+    
+    dest->rows = dest->columns = 4;
+    dest->errors = 0;
+    
+    for (row = 0; row < 3; row++)
+    {
+        for (column = 0; column < 4; column++)
+        {
+            dest->data[row][column] = transform->data[row][column];
+        }
+    }
+    
+    dest->data[3][0] = dest->data[3][1] = dest->data[3][2] = 0;
+    dest->data[3][3] = fix16_one;
+}
+
+void tf16_compose(tf16 *dest, const tf16 *a, const tf16 *b)
+{
+    int row, column;
+    
+    tf16 tmp;
+    fa16_unalias(dest, (void**)&a, (void**)&b, &tmp, sizeof(tmp));
+    
+    // Because the last row of b is [0 0 0 1], the rotation is Ra Rb
+    // and the translation Ra tb + ta.
+    for (row = 0; row < 3; row++)
+    {
+        for (column = 0; column < 4; column++)
+        {
+            dest->data[row][column] = dot4(a->data[row],
+                b->data[0][column], b->data[1][column], b->data[2][column],
+                (column == 3) ? fix16_one : 0);
+        }
+    }
+}
+
+void tf16_invert(tf16 *dest, const tf16 *transform)
+{
+    int row, column;
+    
+    tf16 tmp;
+    fa16_unalias(dest, (void**)&transform, (void**)&transform, &tmp, sizeof(tmp));
+    
+    fix16_t tx = transform->data[0][3];
+    fix16_t ty = transform->data[1][3];
+    fix16_t tz = transform->data[2][3];
+    
+    for (row = 0; row < 3; row++)
+    {
+        for (column = 0; column < 3; column++)
+        {
+            dest->data[row][column] = transform->data[column][row];
+        }
+        
+        // Translation is -R' t, using the row of R' just stored.
+        dest->data[row][3] = 0;
+        dest->data[row][3] = fix16_sub(0, dot4(dest->data[row], tx, ty, tz, 0));
+    }
+}
+
+void tf16_transform_point(v3d *dest, const tf16 *transform, const v3d *point)
+{
+    // Homogeneous point [x y z 1], so that the translation is part of
+    // the dot product.
+    fix16_t x = point->x, y = point->y, z = point->z;
+    
+    dest->x = dot4(transform->data[0], x, y, z, fix16_one);
+    dest->y = dot4(transform->data[1], x, y, z, fix16_one);
+    dest->z = dot4(transform->data[2], x, y, z, fix16_one);
+}
+
+void tf16_rotate_vector(v3d *dest, const tf16 *transform, const v3d *vector)
+{
+    fix16_t x = vector->x, y = vector->y, z = vector->z;
+    
+    dest->x = dot4(transform->data[0], x, y, z, 0);
+    dest->y = dot4(transform->data[1], x, y, z, 0);
+    dest->z = dot4(transform->data[2], x, y, z, 0);
+}
+
+void tf16_transform_points(v3d *dest, const tf16 *transform,
+                           const v3d *points, unsigned count)
+{
+    // Local copy lets the compiler keep the matrix in registers,
+    // as it cannot alias with dest.
+    tf16 t = *transform;
+    
+    while (count--)
+    {
+        tf16_transform_point(dest, &t, points);
+        dest++;
+        points++;
+    }
+}
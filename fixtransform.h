@@ -0,0 +1,58 @@
+/* Rigid body transforms, i.e. a rotation followed by a translation.
+ *
+ * A transform maps point p to R p + t, where R is a 3x3 rotation
+ * matrix and t the translation. It is stored as the top three rows of
+ * the corresponding homogeneous 4x4 matrix; the last row is always
+ * [0 0 0 1]. This avoids the dimension checks and the full size buffer
+ * of mf16, and allows the translation to be added in the same 64-bit
+ * accumulation as the rotation.
+ *
+ * The functions assume that R is orthonormal, so that the inverse can
+ * be computed by transposing it. Dest can alias with the operands in
+ * all functions.
+ */
+
+#ifndef _FIXTRANSFORM_H_
+#define _FIXTRANSFORM_H_
+
+#include <stdbool.h>
+#include <fix16.h>
+#include "fixmatrix.h"
+#include "fixvector3d.h"
+#include "fixquat.h"
+
+typedef struct {
+    // Entry (row, column) of the homogeneous matrix: columns 0..2 are
+    // the rotation R and column 3 is the translation t.
+    fix16_t data[3][4];
+} tf16;
+
+// Transform that maps every point to itself.
+void tf16_identity(tf16 *dest);
+
+// Transform from a unit quaternion rotation and a translation.
+void tf16_from_qf16(tf16 *dest, const qf16 *rotation, const v3d *translation);
+
+// Conversions from and to homogeneous matrices. tf16_from_mf16() accepts
+// 3x4 and 4x4 matrices, ignoring the last row, and returns false if the
+// matrix has other dimensions or error flags set.
+bool tf16_from_mf16(tf16 *dest, const mf16 *matrix);
+void tf16_to_mf16(mf16 *dest, const tf16 *transform);
+
+// Composition dest = a * b, i.e. first b and then a is applied.
+void tf16_compose(tf16 *dest, const tf16 *a, const tf16 *b);
+
+// Inverse transform, R' p - R' t.
+void tf16_invert(tf16 *dest, const tf16 *transform);
+
+// Apply the transform to a point, R p + t.
+void tf16_transform_point(v3d *dest, const tf16 *transform, const v3d *point);
+
+// Apply only the rotation, for directions and velocities.
+void tf16_rotate_vector(v3d *dest, const tf16 *transform, const v3d *vector);
+
+// Transform count points, dest[i] = R points[i] + t.
+void tf16_transform_points(v3d *dest, const tf16 *transform,
+                           const v3d *points, unsigned count);
+
+#endif
@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include "unittests.h"
+#include "fixtransform.h"
+
+fix16_t max_delta(const v3d *a, const v3d *b)
+{
+    fix16_t max = 0;
+    max = fix16_max(max, fix16_abs(a->x - b->x));
+    max = fix16_max(max, fix16_abs(a->y - b->y));
+    max = fix16_max(max, fix16_abs(a->z - b->z));
+    return max;
+}
+
+fix16_t max_delta_tf(const tf16 *a, const tf16 *b)
+{
+    fix16_t max = 0;
+    int row, column;
+    for (row = 0; row < 3; row++)
+        for (column = 0; column < 4; column++)
+            max = fix16_max(max, fix16_abs(a->data[row][column] - b->data[row][column]));
+    return max;
+}
+
+int main()
+{
+    int status = 0;
+    
+    {
+        // 90 degrees around z, then translation
+        qf16 q = {F16(0.70710678), 0, 0, F16(0.70710678)};
+        v3d t = {F16(1), F16(2), F16(3)};
+        v3d p = {F16(1), 0, F16(0.5)};
+        v3d expected = {F16(1), F16(3), F16(3.5)};
+        v3d result, rotated;
+        tf16 a, identity;
+        
+        COMMENT("Test tf16_from_qf16 and tf16_transform_point");
+        tf16_from_qf16(&a, &q, &t);
+        tf16_transform_point(&result, &a, &p);
+        TEST(max_delta(&result, &expected) < 3);
+        
+        qf16_rotate(&rotated, &q, &p);
+        v3d_add(&rotated, &rotated, &t);
+        TEST(max_delta(&result, &rotated) < 3);
+        
+        tf16_rotate_vector(&result, &a, &p);
+        v3d_sub(&expected, &expected, &t);
+        TEST(max_delta(&result, &expected) < 3);
+        
+        COMMENT("Test tf16_transform_point with aliasing");
+        result = p;
+        tf16_transform_point(&result, &a, &result);
+        v3d_add(&expected, &expected, &t);
+        TEST(max_delta(&result, &expected) < 3);
+        
+        COMMENT("Test tf16_identity");
+        tf16_identity(&identity);
+        tf16_transform_point(&result, &identity, &p);
+        TEST(max_delta(&result, &p) == 0);
+    }
+    
+    {
+        qf16 qa = {F16(0.9238795), F16(0.3826834), 0, 0};
+        qf16 qb = {F16(0.8660254), 0, F16(0.5), 0};
+        v3d ta = {F16(-1), F16(0.5), F16(10)};
+        v3d tb = {F16(3), F16(-2), F16(0.25)};
+        v3d p = {F16(0.5), F16(-4), F16(2)};
+        v3d r1, r2;
+        tf16 a, b, ab, inverse, identity, tmp;
+        mf16 ma, mb, mab;
+        
+        tf16_from_qf16(&a, &qa, &ta);
+        tf16_from_qf16(&b, &qb, &tb);
+        tf16_identity(&identity);
+        
+        COMMENT("Test tf16_compose against applying the transforms in turn");
+        tf16_compose(&ab, &a, &b);
+        tf16_transform_point(&r1, &ab, &p);
+        tf16_transform_point(&r2, &b, &p);
+        tf16_transform_point(&r2, &a, &r2);
+        TEST(max_delta(&r1, &r2) < 4);
+        
+        COMMENT("Test tf16_compose against mf16_mul of 4x4 matrices");
+        tf16_to_mf16(&ma, &a);
+        tf16_to_mf16(&mb, &b);
+        mf16_mul(&mab, &ma, &mb);
+        TEST(mab.data[3][3] == fix16_one && mab.data[3][0] == 0);
+        TEST(tf16_from_mf16(&tmp, &mab));
+        TEST(max_delta_tf(&tmp, &ab) < 2);
+        
+        COMMENT("Test tf16_compose with aliasing");
+        tmp = a;
+        tf16_compose(&tmp, &tmp, &b);
+        TEST(max_delta_tf(&tmp, &ab) == 0);
+        tmp = b;
+        tf16_compose(&tmp, &a, &tmp);
+        TEST(max_delta_tf(&tmp, &ab) == 0);
+        
+        COMMENT("Test tf16_invert");
+        tf16_invert(&inverse, &ab);
+        tf16_compose(&tmp, &inverse, &ab);
+        TEST(max_delta_tf(&tmp, &identity) < 5);
+        tf16_transform_point(&r2, &inverse, &r1);
+        TEST(max_delta(&r2, &p) < 5);
+        
+        tmp = ab;
+        tf16_invert(&tmp, &tmp);
+        TEST(max_delta_tf(&tmp, &inverse) == 0);
+        
+        COMMENT("Test tf16_from_mf16 dimension checking");
+        mab.columns = 3;
+        TEST(!tf16_from_mf16(&tmp, &mab));
+        mab.columns = 4;
+        mab.errors = FIXMATRIX_OVERFLOW;
+        TEST(!tf16_from_mf16(&tmp, &mab));
+    }
+    
+    {
+        qf16 q = {F16(0.5), F16(0.5), F16(0.5), F16(0.5)};
+        v3d t = {F16(100), F16(-50), F16(0)};
+        v3d points[5], result[5], expected;
+        tf16 a;
+        int i, ok = 1;
+        
+        COMMENT("Test tf16_transform_points");
+        tf16_from_qf16(&a, &q, &t);
+        for (i = 0; i < 5; i++)
+        {
+            points[i].x = fix16_from_int(i);
+            points[i].y = fix16_from_int(2 * i - 3);
+            points[i].z = F16(0.25) * i;
+        }
+        
+        tf16_transform_points(result, &a, points, 5);
+        for (i = 0; i < 5; i++)
+        {
+            tf16_transform_point(&expected, &a, &points[i]);
+            ok = ok && max_delta(&result[i], &expected) == 0;
+        }
+        TEST(ok);
+        
+        tf16_transform_points(points, &a, points, 5);
+        TEST(max_delta(&points[4], &result[4]) == 0);
+    }
+    
+    if (status != 0)
+        fprintf(stdout, "\n\nSome tests FAILED!\n");
+    
+    return status;
+}
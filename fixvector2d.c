@@ -1,53 +1,52 @@
 #include "fixvector2d.h"
+#include "fixvectornd.h"
 #include "fixarray.h"
 
+// The members of v2d are consecutive, so &a->x can be used as an array.
+
 // Basic arithmetic
 void v2d_add(v2d *dest, const v2d *a, const v2d *b)
 {
-    dest->x = fix16_add(a->x, b->x);
-    dest->y = fix16_add(a->y, b->y);
+    vnd_add(&dest->x, &a->x, &b->x, 2);
 }
 
 void v2d_sub(v2d *dest, const v2d *a, const v2d *b)
 {
-    dest->x = fix16_sub(a->x, b->x);
-    dest->y = fix16_sub(a->y, b->y);
+    vnd_sub(&dest->x, &a->x, &b->x, 2);
 }
 
 void v2d_mul_s(v2d *dest, const v2d *a, fix16_t b)
 {
-    dest->x = fix16_mul(a->x, b);
-    dest->y = fix16_mul(a->y, b);
+    vnd_mul_s(&dest->x, &a->x, b, 2);
 }
 
 void v2d_div_s(v2d *dest, const v2d *a, fix16_t b)
 {
-    dest->x = fix16_div(a->x, b);
-    dest->y = fix16_div(a->y, b);
+    vnd_div_s(&dest->x, &a->x, b, 2);
 }
 
 // Norm
 fix16_t v2d_norm(const v2d *a)
 {
-    return fa16_norm(&a->x, &a->y - &a->x, 2);
+    return vnd_norm(&a->x, 2);
 }
 
 void v2d_normalize(v2d *dest, const v2d *a)
 {
-    v2d_div_s(dest, a, v2d_norm(a));
+    vnd_normalize(&dest->x, &a->x, 2);
 }
 
 // Dot product
 fix16_t v2d_dot(const v2d *a, const v2d *b)
 {
-    return fix16_add(fix16_mul(a->x, b->x), fix16_mul(a->y, b->y));
+    return vnd_dot(&a->x, &b->x, 2);
 }
 
 // Rotation (positive direction = counter-clockwise, angle in radians)
 void v2d_rotate(v2d *dest, const v2d *a, fix16_t angle)
 {
-    fix16_t c = fix16_cos(angle);
-    fix16_t s = fix16_sin(angle);
+    fix16_t c, s;
+    fa16_sincos(angle, &s, &c);
     
     dest->x = fix16_add(fix16_mul(c, a->x), fix16_mul(-s, a->y));
     dest->y = fix16_add(fix16_mul(s, a->x), fix16_mul(c, a->y));
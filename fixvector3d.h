@@ -11,6 +11,14 @@ typedef struct {
 	fix16_t z;
 } v3d;
 
+// Structure of arrays, for batch functions that process the components
+// of many vectors stored in separate arrays.
+typedef struct {
+	fix16_t *x;
+	fix16_t *y;
+	fix16_t *z;
+} v3d_soa;
+
 // Basic arithmetic
 void v3d_add(v3d *dest, const v3d *a, const v3d *b);
 void v3d_sub(v3d *dest, const v3d *a, const v3d *b);
@@ -48,7 +48,7 @@ int main()
         COMMENT("Test v3d_norm");
         TEST(fix16_abs(v3d_norm(&medium) - fix16_from_float(3.741657f)) < 2);
         TEST(fix16_abs(v3d_norm(&small) - fix16_from_float(0.0005709f)) < 2);
-        TEST(fix16_abs(v3d_norm(&large) - fix16_from_float(26925.824f)) < 2);
+        TEST(fix16_abs(v3d_norm(&large) - F16(26925.824036)) < 2);
     }
     
     {
@@ -0,0 +1,126 @@
+#include "fixvectornd.h"
+#include "fixarray.h"
+#include <string.h> /* For memmove() */
+
+// The operations are written as inline functions of the size, and
+// called through SPECIALIZE with a constant size for the common small
+// vectors, so that the compiler can fully unroll the loops.
+#define SPECIALIZE(n, function, ...) \
+    switch (n) \
+    { \
+        case 2: function(__VA_ARGS__, 2); break; \
+        case 3: function(__VA_ARGS__, 3); break; \
+        case 4: function(__VA_ARGS__, 4); break; \
+        default: function(__VA_ARGS__, n); break; \
+    }
+
+/********************
+ * Basic arithmetic *
+ ********************/
+
+static inline void add_n(fix16_t *dest, const fix16_t *a, const fix16_t *b, uint_fast8_t n)
+{
+    uint_fast8_t i;
+    for (i = 0; i < n; i++)
+        dest[i] = fix16_add(a[i], b[i]);
+}
+
+static inline void sub_n(fix16_t *dest, const fix16_t *a, const fix16_t *b, uint_fast8_t n)
+{
+    uint_fast8_t i;
+    for (i = 0; i < n; i++)
+        dest[i] = fix16_sub(a[i], b[i]);
+}
+
+static inline void mul_s_n(fix16_t *dest, const fix16_t *a, fix16_t b, uint_fast8_t n)
+{
+    uint_fast8_t i;
+    for (i = 0; i < n; i++)
+        dest[i] = fix16_mul(a[i], b);
+}
+
+static inline void div_s_n(fix16_t *dest, const fix16_t *a, const fa16_divisor *b, uint_fast8_t n)
+{
+    uint_fast8_t i;
+    for (i = 0; i < n; i++)
+        dest[i] = fa16_divide(a[i], b);
+}
+
+static inline void axpy_n(fix16_t *dest, fix16_t alpha, const fix16_t *x, uint_fast8_t n)
+{
+    uint_fast8_t i;
+    for (i = 0; i < n; i++)
+        dest[i] = fix16_add(dest[i], fix16_mul(alpha, x[i]));
+}
+
+void vnd_add(fix16_t *dest, const fix16_t *a, const fix16_t *b, uint_fast8_t n)
+{
+    SPECIALIZE(n, add_n, dest, a, b);
+}
+
+void vnd_sub(fix16_t *dest, const fix16_t *a, const fix16_t *b, uint_fast8_t n)
+{
+    SPECIALIZE(n, sub_n, dest, a, b);
+}
+
+void vnd_mul_s(fix16_t *dest, const fix16_t *a, fix16_t b, uint_fast8_t n)
+{
+    SPECIALIZE(n, mul_s_n, dest, a, b);
+}
+
+void vnd_div_s(fix16_t *dest, const fix16_t *a, fix16_t b, uint_fast8_t n)
+{
+    fa16_divisor divisor;
+    fa16_divisor_init(&divisor, b);
+    SPECIALIZE(n, div_s_n, dest, a, &divisor);
+}
+
+void vnd_axpy(fix16_t *dest, fix16_t alpha, const fix16_t *x, uint_fast8_t n)
+{
+    SPECIALIZE(n, axpy_n, dest, alpha, x);
+}
+
+// The size is dispatched once for the whole batch.
+static inline void axpy_batch_n(fix16_t *dest, const fix16_t *alpha, const fix16_t *x,
+                                size_t count, uint_fast8_t n)
+{
+    size_t i;
+    for (i = 0; i < count; i++)
+    {
+        axpy_n(dest, alpha[i], x, n);
+        dest += n;
+        x += n;
+    }
+}
+
+void vnd_axpy_batch(fix16_t *dest, const fix16_t *alpha, const fix16_t *x,
+                    uint_fast8_t n, size_t count)
+{
+    SPECIALIZE(n, axpy_batch_n, dest, alpha, x, count);
+}
+
+/********
+ * Norm *
+ ********/
+
+fix16_t vnd_norm(const fix16_t *a, uint_fast8_t n)
+{
+    return fa16_norm(a, 1, n);
+}
+
+void vnd_normalize(fix16_t *dest, const fix16_t *a, uint_fast8_t n)
+{
+    if (dest != a)
+        memmove(dest, a, n * sizeof(fix16_t));
+
+    fa16_normalize_inplace(dest, 1, n);
+}
+
+/***************
+ * Dot product *
+ ***************/
+
+fix16_t vnd_dot(const fix16_t *a, const fix16_t *b, uint_fast8_t n)
+{
+    return fa16_dot(a, 1, b, 1, n);
+}
@@ -0,0 +1,42 @@
+/* N-dimensional vector operations
+ *
+ * The vectors are plain arrays of n contiguous fix16_t values, e.g.
+ * the state of a filter or a row of an mf16. The fixed size v2d and
+ * v3d types are implemented on top of these.
+ *
+ * The element-wise operations have unrolled code paths for n = 2, 3
+ * and 4. Dot products and norms use the fa16 functions, so they
+ * accumulate in 64 bits when available.
+ *
+ * Dest can alias with the operands in all functions.
+ */
+
+#ifndef _fixvectornd_h_
+#define _fixvectornd_h_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <fix16.h>
+
+// Basic arithmetic
+void vnd_add(fix16_t *dest, const fix16_t *a, const fix16_t *b, uint_fast8_t n);
+void vnd_sub(fix16_t *dest, const fix16_t *a, const fix16_t *b, uint_fast8_t n);
+void vnd_mul_s(fix16_t *dest, const fix16_t *a, fix16_t b, uint_fast8_t n);
+void vnd_div_s(fix16_t *dest, const fix16_t *a, fix16_t b, uint_fast8_t n);
+
+// dest = dest + alpha * x
+void vnd_axpy(fix16_t *dest, fix16_t alpha, const fix16_t *x, uint_fast8_t n);
+
+// Axpy for count vectors stored one after another: the vector at
+// dest + i * n gets alpha[i] times the vector at x + i * n added to it.
+void vnd_axpy_batch(fix16_t *dest, const fix16_t *alpha, const fix16_t *x,
+                    uint_fast8_t n, size_t count);
+
+// Norm
+fix16_t vnd_norm(const fix16_t *a, uint_fast8_t n);
+void vnd_normalize(fix16_t *dest, const fix16_t *a, uint_fast8_t n);
+
+// Dot product, returns fix16_overflow on overflow.
+fix16_t vnd_dot(const fix16_t *a, const fix16_t *b, uint_fast8_t n);
+
+#endif
@@ -0,0 +1,132 @@
+#include <stdio.h>
+#include "unittests.h"
+#include "fixvectornd.h"
+#include "fixvector2d.h"
+#include "fixvector3d.h"
+
+fix16_t max_delta(const fix16_t *a, const fix16_t *b, int n)
+{
+    fix16_t max = 0;
+    int i;
+    for (i = 0; i < n; i++)
+        max = fix16_max(max, fix16_abs(a[i] - b[i]));
+    return max;
+}
+
+int main()
+{
+    int status = 0;
+    
+    {
+        fix16_t a[9], b[9], c[9], expected[9];
+        int sizes[] = {2, 3, 4, 6, 9};
+        int s, i, n;
+        
+        for (i = 0; i < 9; i++)
+        {
+            a[i] = fix16_from_int(i + 1);
+            b[i] = fix16_from_int(2 * i - 5);
+        }
+        
+        COMMENT("Test basic arithmetic for sizes 2, 3, 4, 6 and 9");
+        for (s = 0; s < 5; s++)
+        {
+            n = sizes[s];
+            
+            for (i = 0; i < n; i++)
+                expected[i] = fix16_from_int(3 * i - 4);
+            vnd_add(c, a, b, n);
+            TEST(max_delta(c, expected, n) == 0);
+            
+            for (i = 0; i < n; i++)
+                expected[i] = fix16_from_int(6 - i);
+            vnd_sub(c, a, b, n);
+            TEST(max_delta(c, expected, n) == 0);
+            
+            for (i = 0; i < n; i++)
+                expected[i] = fix16_from_int(3 * i + 3);
+            vnd_mul_s(c, a, fix16_from_int(3), n);
+            TEST(max_delta(c, expected, n) == 0);
+            
+            vnd_div_s(c, c, fix16_from_int(3), n);
+            TEST(max_delta(c, a, n) == 0);
+            
+            for (i = 0; i < n; i++)
+                expected[i] = a[i] + b[i] / 2;
+            for (i = 0; i < n; i++)
+                c[i] = a[i];
+            vnd_axpy(c, F16(0.5), b, n);
+            TEST(max_delta(c, expected, n) == 0);
+        }
+        
+        COMMENT("Test element beyond the vector is not modified");
+        c[4] = 12345;
+        vnd_add(c, a, b, 4);
+        TEST(c[4] == 12345);
+    }
+    
+    {
+        fix16_t a[6] = {F16(100), F16(200), F16(-300), F16(1), F16(2), F16(3)};
+        fix16_t b[6] = {F16(100), F16(50), F16(100), F16(-1), F16(0.5), F16(0)};
+        fix16_t large[4] = {F16(200), F16(200), F16(200), F16(200)};
+        fix16_t unit[4];
+        
+        COMMENT("Test vnd_dot and vnd_norm");
+        TEST(vnd_dot(a, b, 6) == F16(-10000));
+        TEST(vnd_dot(large, large, 4) == fix16_overflow);
+        TEST(vnd_norm(large, 4) == F16(400));
+        TEST(fix16_abs(vnd_norm(a, 6) - F16(374.1844465)) < 2);
+        
+        COMMENT("Test vnd_normalize");
+        vnd_normalize(unit, large, 4);
+        TEST(unit[0] == F16(0.5) && unit[3] == F16(0.5));
+        vnd_normalize(large, large, 4);
+        TEST(max_delta(unit, large, 4) == 0);
+    }
+    
+    {
+        fix16_t y[4 * 6], x[4 * 6], alpha[4], expected[4 * 6];
+        int n, i;
+        
+        COMMENT("Test vnd_axpy_batch against vnd_axpy");
+        for (n = 3; n <= 6; n += 3)
+        {
+            for (i = 0; i < 4 * n; i++)
+            {
+                y[i] = expected[i] = fix16_from_int(i);
+                x[i] = F16(0.25) * (i - 7);
+            }
+            for (i = 0; i < 4; i++)
+            {
+                alpha[i] = F16(1.5) - i * F16(0.5);
+                vnd_axpy(expected + i * n, alpha[i], x + i * n, n);
+            }
+            
+            vnd_axpy_batch(y, alpha, x, n, 4);
+            TEST(max_delta(y, expected, 4 * n) == 0);
+        }
+    }
+    
+    {
+        v2d b = {F16(200), F16(-199)};
+        v3d c = {F16(1), F16(2), F16(2)};
+        v3d d;
+        
+        COMMENT("Test v2d and v3d through vnd");
+#ifndef FIXMATH_NO_64BIT
+        // Products overflow, but the sum fits with 64-bit accumulation
+        v2d a = {F16(200), F16(200)};
+        TEST(v2d_dot(&a, &b) == F16(200));
+#endif
+        TEST(fix16_abs(v2d_norm(&b) - F16(282.136492)) < 2);
+        v3d_normalize(&d, &c);
+        TEST(fix16_abs(d.x - F16(1.0 / 3)) < 2 && fix16_abs(d.z - F16(2.0 / 3)) < 2);
+        v3d_add(&d, &c, &c);
+        TEST(d.x == F16(2) && d.y == F16(4) && d.z == F16(4));
+    }
+    
+    if (status != 0)
+        fprintf(stdout, "\n\nSome tests FAILED!\n");
+    
+    return status;
+}
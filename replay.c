@@ -0,0 +1,514 @@
+/* Replays a log of measurement vectors through a Kalman filter built on
+ * libfixmatrix, and reports the throughput and a checksum of the filter
+ * outputs. The checksum allows comparing results between library
+ * versions; the throughput comparing speed.
+ *
+ * Usage: replay [-n states] [-t dt] [-r rounds] [-u] [-w output] logfile
+ *
+ * The log is either a binary array file of mf16 records (see fixbinary.h),
+ * which is memory-mapped and read in place, or text with one measurement
+ * vector per line, values separated by commas or whitespace.
+ *
+ * The filter is a constant-velocity model: the state has the measured
+ * quantities followed by their derivatives, so states must be between
+ * the measurement length and twice of it. Each sample runs:
+ *   predict: x = F x,  P = F P F' + Q
+ *   update:  S = H P H' + R,  K' = S \ (H P) using QR decomposition,
+ *            x = x + K (z - H x),  P = P - K H P
+ *
+ * With -u, P is kept in UD factorized form instead, and the update is
+ * done with Bierman's algorithm one measurement at a time (see
+ * mf16_ud_update() in fixmatrix.h).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "fixmatrix.h"
+#include "fixbinary.h"
+#include "fixstring.h"
+
+typedef struct {
+    const fix16_t *data; // First value of the first sample
+    size_t stride;       // Distance between samples, in values
+    size_t count;        // Number of samples
+    uint8_t length;      // Values per sample
+    fix16_t *storage;    // Allocated memory, if not mapped
+} samples_t;
+
+typedef struct {
+    mf16 x, P;       // State and covariance
+    mf16 F, Q;       // State transition and process noise
+    mf16 H, R;       // Measurement model and measurement noise
+    mf16 UD, q;      // Factorized P and diagonal of Q, with -u
+    bool ud;
+    uint32_t checksum;
+} filter_t;
+
+static double now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*****************
+ * Reading input *
+ *****************/
+
+static bool load_binary(samples_t *samples, const uint8_t *buf, size_t size)
+{
+    fb_array array;
+    mf16_view view;
+    mf16 record;
+    size_t i;
+    
+    if (!unpack_array_header(&array, buf, size) || array.type != FIXBINARY_MF16)
+        return false;
+    
+    samples->count = array.count;
+    samples->length = array.rows * array.columns;
+    
+    if (samples->length == 0 || samples->length > FIXMATRIX_MAX_SIZE)
+    {
+        fprintf(stderr, "Measurement length must be 1 to %d\n", FIXMATRIX_MAX_SIZE);
+        return false;
+    }
+    
+    if (array.count == 0)
+    {
+        fprintf(stderr, "File has no samples\n");
+        return false;
+    }
+    
+    if (view_mf16_record_const(&view, buf, size, 0))
+    {
+        // Zero-copy: read the values straight from the mapping.
+        samples->data = view.data;
+        samples->stride = array.record_size / sizeof(fix16_t);
+        
+        if (!view_mf16_record_const(&view, buf, size, array.count - 1))
+        {
+            fprintf(stderr, "File is truncated\n");
+            return false;
+        }
+        
+        return true;
+    }
+    
+    // Big-endian host, unpack all records.
+    samples->storage = malloc(array.count * samples->length * sizeof(fix16_t));
+    samples->data = samples->storage;
+    if (!samples->storage)
+    {
+        fprintf(stderr, "Out of memory\n");
+        return false;
+    }
+    
+    samples->stride = samples->length;
+    
+    for (i = 0; i < array.count; i++)
+    {
+        int row;
+        if (!unpack_mf16_record(&record, buf, size, i))
+        {
+            fprintf(stderr, "File is truncated\n");
+            return false;
+        }
+        
+        for (row = 0; row < record.rows; row++)
+        {
+            memcpy(samples->storage + i * samples->length + row * record.columns,
+                   record.data[row], record.columns * sizeof(fix16_t));
+        }
+    }
+    
+    return true;
+}
+
+static bool load_text(samples_t *samples, const char *text)
+{
+    size_t capacity = 1024;
+    size_t line = 1;
+    
+    samples->storage = malloc(capacity * FIXMATRIX_MAX_SIZE * sizeof(fix16_t));
+    samples->data = samples->storage;
+    samples->stride = FIXMATRIX_MAX_SIZE;
+    samples->count = 0;
+    samples->length = 0;
+    
+    if (!samples->storage)
+    {
+        fprintf(stderr, "Out of memory\n");
+        return false;
+    }
+    
+    while (*text)
+    {
+        fix16_t *sample = samples->storage + samples->count * FIXMATRIX_MAX_SIZE;
+        uint8_t length = 0;
+        
+        while (*text != '\n' && *text != '\0')
+        {
+            while (*text == ' ' || *text == '\t' || *text == '\r' || *text == ',')
+                text++;
+            
+            if (*text == '\n' || *text == '\0')
+                break;
+            
+            if (length == FIXMATRIX_MAX_SIZE || !(text = parse_fix16_t(text, &sample[length++])))
+            {
+                fprintf(stderr, "Invalid input on line %lu\n", (unsigned long)line);
+                return false;
+            }
+        }
+        
+        if (*text == '\n')
+            text++;
+        line++;
+        
+        if (length == 0)
+            continue;
+        
+        if (samples->length == 0)
+            samples->length = length;
+        
+        if (length != samples->length)
+        {
+            fprintf(stderr, "Line %lu has %d values, expected %d\n",
+                    (unsigned long)line - 1, length, samples->length);
+            return false;
+        }
+        
+        if (++samples->count == capacity)
+        {
+            // On failure the old buffer is still owned by samples.
+            fix16_t *storage = realloc(samples->storage, 2 * capacity * FIXMATRIX_MAX_SIZE * sizeof(fix16_t));
+            if (!storage)
+            {
+                fprintf(stderr, "Out of memory\n");
+                return false;
+            }
+            
+            capacity *= 2;
+            samples->storage = storage;
+            samples->data = samples->storage;
+        }
+    }
+    
+    return samples->count > 0;
+}
+
+static bool load_samples(samples_t *samples, const char *filename)
+{
+    struct stat st;
+    int fd = open(filename, O_RDONLY);
+    
+    if (fd < 0 || fstat(fd, &st) != 0)
+    {
+        perror(filename);
+        return false;
+    }
+    
+    size_t size = st.st_size;
+    uint8_t *buf = (size > 0) ? mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+    close(fd);
+    
+    if (buf == MAP_FAILED)
+    {
+        perror(filename);
+        return false;
+    }
+    
+    memset(samples, 0, sizeof(*samples));
+    bool status;
+    
+    if (size >= 4 && memcmp(buf, "FXMA", 4) == 0)
+    {
+        status = load_binary(samples, buf, size);
+        
+        // The mapping is kept only if the samples are read from it.
+        if (!status || samples->storage)
+            munmap(buf, size);
+    }
+    else
+    {
+        // Text must be null-terminated for the parser.
+        char *text = malloc(size + 1);
+        if (buf)
+        {
+            if (text)
+                memcpy(text, buf, size);
+            munmap(buf, size);
+        }
+        
+        if (!text)
+        {
+            fprintf(stderr, "Out of memory\n");
+            return false;
+        }
+        
+        text[size] = '\0';
+        status = load_text(samples, text);
+        free(text);
+    }
+    
+    if (!status)
+    {
+        free(samples->storage);
+        samples->storage = NULL;
+    }
+    
+    return status;
+}
+
+static bool save_binary(const samples_t *samples, const char *filename)
+{
+    fb_array array = {FIXBINARY_MF16, samples->length, 1, samples->count, 0};
+    size_t size = FIXBINARY_HEADER_SIZE + samples->count * fb_array_record_size(samples->length, 1);
+    uint8_t *buf = malloc(size);
+    mf16 record = {samples->length, 1, 0, {{0}}};
+    size_t i;
+    int row;
+    
+    if (!buf)
+    {
+        fprintf(stderr, "Out of memory\n");
+        return false;
+    }
+    
+    pack_array_header(buf, size, &array);
+    for (i = 0; i < samples->count; i++)
+    {
+        for (row = 0; row < samples->length; row++)
+            record.data[row][0] = samples->data[i * samples->stride + row];
+        pack_mf16_record(buf, size, i, &record);
+    }
+    
+    FILE *f = fopen(filename, "wb");
+    bool status = f && fwrite(buf, 1, size, f) == size;
+    if (f && fclose(f) != 0)
+        status = false;
+    if (!status)
+        perror(filename);
+    
+    free(buf);
+    return status;
+}
+
+/**********
+ * Filter *
+ **********/
+
+static void filter_init(filter_t *filter, uint8_t states, uint8_t length, fix16_t dt, bool ud)
+{
+    int i;
+    
+    filter->x.rows = states;
+    filter->x.columns = 1;
+    filter->x.errors = 0;
+    mf16_fill(&filter->x, 0);
+    
+    filter->P.rows = filter->P.columns = states;
+    filter->P.errors = 0;
+    mf16_fill_diagonal(&filter->P, fix16_from_int(10));
+    
+    // Position is integrated from the velocity, when it is in the state.
+    filter->F.rows = filter->F.columns = states;
+    filter->F.errors = 0;
+    mf16_fill_diagonal(&filter->F, fix16_one);
+    for (i = length; i < states; i++)
+        filter->F.data[i - length][i] = dt;
+    
+    filter->Q.rows = filter->Q.columns = states;
+    filter->Q.errors = 0;
+    mf16_fill_diagonal(&filter->Q, F16(0.01));
+    
+    filter->H.rows = length;
+    filter->H.columns = states;
+    filter->H.errors = 0;
+    mf16_fill_diagonal(&filter->H, fix16_one);
+    
+    filter->R.rows = filter->R.columns = length;
+    filter->R.errors = 0;
+    mf16_fill_diagonal(&filter->R, F16(0.5));
+    
+    filter->ud = ud;
+    mf16_ud_decomposition(&filter->UD, &filter->P);
+    filter->q.rows = states;
+    filter->q.columns = 1;
+    filter->q.errors = 0;
+    for (i = 0; i < states; i++)
+        filter->q.data[i][0] = filter->Q.data[i][i];
+    
+    filter->checksum = 2166136261u;
+}
+
+// FNV-1a over the state and error flags
+static void filter_checksum(filter_t *filter, uint8_t errors)
+{
+    int i;
+    
+    for (i = 0; i < filter->x.rows; i++)
+    {
+        uint32_t value = (uint32_t)filter->x.data[i][0];
+        int byte;
+        for (byte = 0; byte < 4; byte++)
+        {
+            filter->checksum = (filter->checksum ^ (value & 0xFF)) * 16777619u;
+            value >>= 8;
+        }
+    }
+    filter->checksum = (filter->checksum ^ (filter->x.errors | errors)) * 16777619u;
+}
+
+static void filter_step_ud(filter_t *filter, const fix16_t *z)
+{
+    mf16 h = {1, filter->H.columns, 0, {{0}}};
+    int i;
+    
+    // Predict
+    mf16_mul(&filter->x, &filter->F, &filter->x);
+    mf16_ud_predict(&filter->UD, &filter->UD, &filter->F, &filter->q);
+    
+    // R is diagonal, so the measurements can be processed one by one.
+    for (i = 0; i < filter->H.rows; i++)
+    {
+        memcpy(h.data[0], filter->H.data[i], filter->H.columns * sizeof(fix16_t));
+        mf16_ud_update(&filter->UD, &filter->x, &h, z[i], filter->R.data[i][i]);
+    }
+    
+    filter_checksum(filter, filter->UD.errors);
+}
+
+static void filter_step(filter_t *filter, const fix16_t *z)
+{
+    mf16 tmp, HP, S, q, r, K;
+    int i;
+    
+    if (filter->ud)
+    {
+        filter_step_ud(filter, z);
+        return;
+    }
+    
+    // Predict
+    mf16_mul(&filter->x, &filter->F, &filter->x);
+    mf16_mul(&tmp, &filter->F, &filter->P);
+    mf16_mul_bt(&filter->P, &tmp, &filter->F);
+    mf16_add(&filter->P, &filter->P, &filter->Q);
+    
+    // Innovation covariance S = H P H' + R
+    mf16_mul(&HP, &filter->H, &filter->P);
+    mf16_mul_bt(&S, &HP, &filter->H);
+    mf16_add(&S, &S, &filter->R);
+    
+    // Gain K = P H' inv(S), computed as K' = S \ (H P) because S is symmetric.
+    mf16_qr_decomposition(&q, &r, &S, 0);
+    mf16_solve(&tmp, &q, &r, &HP);
+    mf16_transpose(&K, &tmp);
+    
+    // Innovation y = z - H x
+    mf16 y = {filter->H.rows, 1, 0, {{0}}};
+    mf16_mul(&tmp, &filter->H, &filter->x);
+    for (i = 0; i < y.rows; i++)
+        y.data[i][0] = fix16_sub(z[i], tmp.data[i][0]);
+    
+    mf16_mul(&tmp, &K, &y);
+    mf16_add(&filter->x, &filter->x, &tmp);
+    mf16_mul(&tmp, &K, &HP);
+    mf16_sub(&filter->P, &filter->P, &tmp);
+    
+    filter_checksum(filter, filter->P.errors);
+}
+
+/********
+ * Main *
+ ********/
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [-n states] [-t dt] [-r rounds] [-u] [-w output] logfile\n"
+                    "  -n states  Filter states, from measurement length to twice of it\n"
+                    "             (default: twice the measurement length, at most %d)\n"
+                    "  -t dt      Time step in seconds (default: 0.01)\n"
+                    "  -r rounds  Number of times to replay the log (default: 1)\n"
+                    "  -u         Use the UD factorized filter with Bierman updates\n"
+                    "  -w output  Write the log as a binary array file\n",
+            name, FIXMATRIX_MAX_SIZE);
+}
+
+int main(int argc, char **argv)
+{
+    int states = 0, rounds = 1, opt;
+    fix16_t dt = F16(0.01);
+    const char *output = NULL;
+    bool ud = false;
+    samples_t samples;
+    filter_t filter;
+    
+    while ((opt = getopt(argc, argv, "n:t:r:uw:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'n': states = atoi(optarg); break;
+            case 't': dt = fix16_from_str(optarg); break;
+            case 'r': rounds = atoi(optarg); break;
+            case 'u': ud = true; break;
+            case 'w': output = optarg; break;
+            default: usage(argv[0]); return 2;
+        }
+    }
+    
+    if (optind != argc - 1 || rounds < 1 || dt == fix16_overflow)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+    
+    double start = now();
+    if (!load_samples(&samples, argv[optind]))
+        return 1;
+    double load_time = now() - start;
+    
+    if (output && !save_binary(&samples, output))
+        return 1;
+    
+    if (states == 0)
+        states = (2 * samples.length <= FIXMATRIX_MAX_SIZE) ? 2 * samples.length : samples.length;
+    
+    if (states < samples.length || states > 2 * samples.length || states > FIXMATRIX_MAX_SIZE)
+    {
+        fprintf(stderr, "States must be between %d and %d\n", samples.length,
+                (2 * samples.length < FIXMATRIX_MAX_SIZE) ? 2 * samples.length : FIXMATRIX_MAX_SIZE);
+        return 2;
+    }
+    
+    int round;
+    size_t i;
+    start = now();
+    for (round = 0; round < rounds; round++)
+    {
+        filter_init(&filter, states, samples.length, dt, ud);
+        for (i = 0; i < samples.count; i++)
+            filter_step(&filter, samples.data + i * samples.stride);
+    }
+    double run_time = now() - start;
+    
+    double total = (double)samples.count * rounds;
+    printf("Samples:     %lu x %d values, %d states\n",
+           (unsigned long)samples.count, samples.length, states);
+    printf("Load time:   %.3f s\n", load_time);
+    printf("Run time:    %.3f s, %.0f samples/s\n", run_time, total / run_time);
+    printf("Checksum:    %08lx\n", (unsigned long)filter.checksum);
+    printf("Final state:\n");
+    print_mf16(stdout, &filter.x);
+    
+    free(samples.storage);
+    return 0;
+}